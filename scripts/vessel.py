@@ -30,23 +30,9 @@ ST4SSTH0="42"
 ST4SAP="0.592"
 
 def simpleSegmentation(inp, outp, model, st2maxit, st2nw, st2dyn, st4wa, st4sth0, st4ap):
-    command= "vessel --vessel.stage0 %s roi-s1.bmp extended.bmp support.bmp roi.bmp" % inp
-    print("command to execute: %s" % command)
-    os.system(command)
-    
-    command= "vessel --vessel.stage1 %s/trained-features.fdf extended.bmp roi-s1.bmp support.bmp stage1.bmp" % model
-    print("command to execute: %s" % command)
-    os.system(command)
-    
-    command= "vessel --vessel.stage2 --vessel.stage2.ws 1 --vessel.stage2.shift 1 --vessel.stage2.maxit %s --vessel.stage2.nw %s --vessel.stage2.dynth %s --vessel.stage2.relint %s extended.bmp stage1.bmp roi-s1.bmp stage2.bmp" % (st2maxit, st2nw, st2dyn, model)
-    print("command to execute: %s" % command)
-    os.system(command)
-    
-    command= "vessel --vessel.stage4 %s/trained-features.fdf --vessel.stage4.wa %s --vessel.stage4.sizeth0 %s --vessel.stage4.ap %s extended.bmp stage2.bmp roi-s1.bmp support.bmp stage4.bmp" % (model, st4wa, st4sth0, st4ap)
+    command= "vessel --vessel.pipeline --vessel.stage2.ws 1 --vessel.stage2.shift 1 --vessel.stage2.maxit %s --vessel.stage2.nw %s --vessel.stage2.dynth %s --vessel.stage2.relint %s --vessel.stage4.wa %s --vessel.stage4.sizeth0 %s --vessel.stage4.ap %s %s/trained-features.fdf %s %s" % (st2maxit, st2nw, st2dyn, model, st4wa, st4sth0, st4ap, model, inp, outp)
     print("command to execute: %s" % command)
     os.system(command)
-    
-    shutil.copyfile("stage4.bmp", outp)
 
 def driveFunction(inp, outp):
     simpleSegmentation(inp, outp, DRIVEMODEL, ST2DMAXIT, ST2DNW, ST2DDYN, ST4DWA, ST4DSTH0, ST4DAP)
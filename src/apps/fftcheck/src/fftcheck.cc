@@ -0,0 +1,167 @@
+#include <openipLL/imageIO.h>
+#include <openipDS/Image.h>
+#include <openipDS/OptionTable.h>
+#include <openipDS/GaborFilter2.h>
+#include <openipDS/PowerGaborFilter2.h>
+
+#include <math.h>
+
+using namespace openip;
+
+// maximum absolute difference of two responses in the roi, where all the taps of the filter are inside the image;
+// the positions where the reference is not finite are skipped, over is the number of positions over the tolerance
+template<typename T>
+double maximumDifference(Image<T>& reference, Image<float>& response, Image<unsigned char>& roi, int min, int max, int& n, float tolerance, int& over)
+{
+  double maxDiff= 0;
+  n= 0;
+  over= 0;
+  for ( int i= -min; i < int(reference.n) - max; ++i )
+    if ( roi(i) && isfinite(reference(i)) )
+    {
+      double d= fabs(reference(i) - response(i));
+      if ( d > maxDiff || d != d )
+        maxDiff= d;
+      if ( !(d <= tolerance) )
+        ++over;
+      ++n;
+    }
+  return maxDiff;
+}
+
+// the tap by tap evaluation of the normalized cross-correlation in double precision, the reference of the
+// comparisons: the float evaluation of the filter loses precision in flat regions and for thousands of taps
+void directCorrelation(CCorrelationPowerGaborFilterR2<float, float>& f, Image<float>& input, Image<unsigned char>& roi, Image<double>& output)
+{
+  output.resizeImage(input);
+  output= 0;
+
+  #pragma omp parallel for
+  for ( int i= -f.getMin(); i < int(input.n) - f.getMax(); ++i )
+  {
+    if ( !roi(i) )
+      continue;
+
+    double sum= 0, sum2= 0, numerator= 0, sumG= 0;
+    for ( unsigned int k= 0; k < f.size(); ++k )
+    {
+      double x= input(i + f[k].first);
+      sum+= x;
+      sum2+= x*x;
+      numerator+= x*(f[k].second - f.meanF);
+      sumG+= f[k].second - f.meanF;
+    }
+
+    double meanI= sum/f.size();
+    double variance= sum2/f.size() - meanI*meanI;
+    double devI= variance > 0 ? sqrt(variance*f.size()) : 0;
+
+    output(i)= fabs(devI) > FLT_EPSILON ? (numerator - meanI*sumG)/devI/f.devF : 0;
+  }
+}
+
+// compares the FFT evaluation of the normalized cross-correlation filters with the tap by tap evaluation: single
+// filters in the size range of the vessel models against the double precision reference, then the orientations
+// of a filter bank sharing one plan against the float evaluation of the bank
+int fftcheckFunction(char* inputFile, char* roiFile, float tolerance)
+{
+  Image<float> input;
+  Image<unsigned char> roi;
+
+  readImage(inputFile, input);
+  if ( roiFile )
+    readImage(roiFile, roi);
+  else
+  {
+    roi.resizeImage(input);
+    roi= 255;
+  }
+
+  float sigmas[]= {3.0f, 4.5f, 7.0f, 10.0f, 14.0f};
+  float thetas[]= {0.0f, 0.3f, 0.8f};
+
+  FastFourierPlan plan;
+  int failed= 0, checked= 0;
+
+  for ( int s= 0; s < 5; ++s )
+    for ( int t= 0; t < 3; ++t )
+    {
+      CCorrelationPowerGaborFilterR2<float, float> f(sigmas[s], thetas[t], 8*sigmas[s], 0, 0.5, 1.0);
+      f.updateStride(input.columns);
+      f.computeMinMax();
+
+      Image<float> spatial(input), fourier(input);
+      Image<double> reference;
+      spatial= 0;
+      fourier= 0;
+
+      f.backend= CCORRELATION_BACKEND_SPATIAL;
+      f.apply(input, spatial, &roi);
+      f.applyFourier(input, fourier, &roi, &plan);
+      directCorrelation(f, input, roi, reference);
+
+      int n, over, overSpatial;
+      double maxDiff= maximumDifference(reference, fourier, roi, f.getMin(), f.getMax(), n, tolerance, over);
+      double maxDiffSpatial= maximumDifference(reference, spatial, roi, f.getMin(), f.getMax(), n, tolerance, overSpatial);
+      int ok= maxDiff <= tolerance;
+      failed+= !ok;
+      ++checked;
+
+      printf("filter, sigma: %f, theta: %f, taps: %d, positions: %d, max difference of fourier: %g, of spatial: %g %s\n", sigmas[s], thetas[t], int(f.size()), n, maxDiff, maxDiffSpatial, ok ? "OK" : "FAILED");
+    }
+
+  for ( int s= 2; s < 4; ++s )
+  {
+    MaxFilterSet2<float, float, float> spatialSet, fourierSet;
+    for ( int k= 0; k < 12; ++k )
+    {
+      CCorrelationPowerGaborFilterR2<float, float>* a= new CCorrelationPowerGaborFilterR2<float, float>(sigmas[s], k*M_PI/12, 8*sigmas[s], 0, 0.5, 1.0);
+      CCorrelationPowerGaborFilterR2<float, float>* b= new CCorrelationPowerGaborFilterR2<float, float>(sigmas[s], k*M_PI/12, 8*sigmas[s], 0, 0.5, 1.0);
+      a->backend= CCORRELATION_BACKEND_SPATIAL;
+      b->backend= CCORRELATION_BACKEND_FOURIER;
+      spatialSet.push_back(a);
+      fourierSet.push_back(b);
+    }
+
+    Image<float> spatial(input), fourier(input);
+    spatial= 0;
+    fourier= 0;
+
+    spatialSet.apply(input, spatial, &roi);
+    fourierSet.apply(input, fourier, &roi);
+
+    // where two even orientations are within rounding of each other, the two evaluations may search the odd
+    // orientations around different ones; a few such positions are allowed
+    int n, over;
+    double maxDiff= maximumDifference(spatial, fourier, roi, spatialSet.getMin(), spatialSet.getMax(), n, tolerance, over);
+    int ok= over <= n*0.0001;
+    failed+= !ok;
+    ++checked;
+
+    printf("filter bank, sigma: %f, orientations: %d, positions: %d, max difference: %g, over the tolerance: %d %s\n", sigmas[s], int(spatialSet.size()), n, maxDiff, over, ok ? "OK" : "FAILED");
+  }
+
+  printf("%d/%d checks over the tolerance %g\n", failed, checked, tolerance);
+
+  return failed ? 1 : 0;
+}
+
+int main(int argc, char** argv)
+{
+    float tolerance= 1e-3;
+
+    OptionTable ot;
+
+    ot.addOption(string("--tolerance"), OPTION_FLOAT, (char*)&tolerance, 1, string("maximum absolute difference of the responses"));
+
+    if ( ot.processArgs(&argc, argv) )
+        return 1;
+
+    if ( argc < 2 )
+    {
+        printf("usage: fftcheck [--tolerance t] input [roi]\n");
+        return 1;
+    }
+
+    return fftcheckFunction(argv[1], argc > 2 ? argv[2] : NULL, tolerance);
+}
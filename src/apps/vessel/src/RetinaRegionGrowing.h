@@ -1,10 +1,14 @@
 #ifndef RETINA_REGION_GROWING_H
 #define RETINA_REGION_GROWING_H
 
+#include <map>
+#include <string>
+
 #include <openipDS/PixelSet1.h>
 #include <openipDS/StructuringElement2s.h>
 #include <openipDS/MatchedGaborFilter2.h>
 #include <openipDS/PowerGaborFilter2.h>
+#include <openipDS/Profiler.h>
 
 #include <openipLL/RegionGrowing.h>
 #include <openipLL/ComponentLabeling.h>
@@ -15,6 +19,61 @@
 
 namespace openip
 {
+    /**
+     * reads the relative intensity tables relative-intensities-1.txt, ..., relative-intensities-69.txt of a model,
+     * the files of a directory are parsed only once, later calls are served from memory
+     * @param directory directory of the tables
+     * @param inner inner relative intensities of the tables
+     * @param outer outer relative intensities of the tables
+     */
+    inline void readRelativeIntensityTables(char* directory, Vector<Vector<float> >& inner, Vector<Vector<float> >& outer)
+    {
+        static std::map<std::string, Vector<Vector<float> > > cacheInner;
+        static std::map<std::string, Vector<Vector<float> > > cacheOuter;
+
+        #pragma omp critical (relativeIntensityTables)
+        {
+            std::string key(directory);
+            if ( cacheInner.find(key) == cacheInner.end() )
+            {
+                Vector<Vector<float> >& tablesInner= cacheInner[key];
+                Vector<Vector<float> >& tablesOuter= cacheOuter[key];
+
+                for ( int i= 1; i < 70; ++i )
+                {
+                    char filename[1000];
+                    sprintf(filename, "%s/relative-intensities-%d.txt", directory, i);
+                    tprintf("reading: %s\n", filename);
+                    ifstream input;
+                    input.open(filename);
+                    int n;
+                    float tmp;
+                    input >> n;
+                    Vector<float> in;
+
+                    for ( int j= 0; j < n; ++j )
+                    {
+                        input >> tmp;
+                        in.push_back(tmp);
+                    }
+                    input >> n;
+                    Vector<float> out;
+                    for ( int j= 0; j < n; ++j )
+                    {
+                        input >> tmp;
+                        out.push_back(tmp);
+                    }
+
+                    tablesInner.push_back(in);
+                    tablesOuter.push_back(out);
+                }
+            }
+
+            inner= cacheInner[key];
+            outer= cacheOuter[key];
+        }
+    }
+
     template<typename INPUT>
     class CorrectionOfEdgeBorders: public RegionGrowing<INPUT>
     {
@@ -41,6 +100,8 @@ namespace openip
 	
 	void fillCaches(Image<unsigned char>& labels, Image<INPUT>& input);
 	
+	void updateLabelDistances(Image<unsigned char>& labels);
+	
 	void getDesiredSlopes(float width, float dyn, float& inner, float& outer);
 	
 	float getError(Image<INPUT>& input, Image<unsigned char>& image, Image<unsigned char>* roi, int flag= 0);
@@ -76,6 +137,14 @@ namespace openip
 	Image<float> riCache;
 	Image<float> dynCache;
 	
+	// state of the incremental refresh of the caches
+	Image<float> rawWidths;
+	Image<unsigned char> reaches;
+	Image<unsigned char> cacheLabels;
+	Image<unsigned char> labelDistances;
+	Image<unsigned char> smoothDirty;
+	int cacheInitialized;
+	
 	Vector<float> expectedDyn;
 	Vector<float> dynstd;
 	
@@ -118,6 +187,7 @@ namespace openip
 	this->dynth= dynth;
 	this->errorMode= errorMode;
 	this->useCache= 1;
+	this->cacheInitialized= 0;
         
 	tprintf("instantiating equal slope at boundaries object\n");
 	esab= new EqualSlopeAtBoundaries<float>(3, 87, 0.4, 1);
@@ -238,33 +308,12 @@ namespace openip
 	relativeInner.push_back(tmp);
 	relativeOuter.push_back(tmp);
 	
-	for ( int i= 1; i < 70; ++i )
+	Vector<Vector<float> > tablesInner, tablesOuter;
+	readRelativeIntensityTables(relativeIntensities, tablesInner, tablesOuter);
+	for ( unsigned int i= 0; i < tablesInner.size(); ++i )
 	{
-	  char filename[1000];
-	  sprintf(filename, "%s/relative-intensities-%d.txt", relativeIntensities, i);
-          tprintf("reading: %s\n", filename);
-	  ifstream input;
-	  input.open(filename);
-	  int n;
-	  float tmp;
-	  input >> n;
-	  Vector<float> inner;
-	  
-	  for ( int i= 0; i < n; ++i )
-	  {
-	    input >> tmp;
-	    inner.push_back(tmp);
-	  }
-	  input >> n;
-	  Vector<float> outer;
-	  for ( int i= 0; i < n; ++i )
-	  {
-	    input >> tmp;
-	    outer.push_back(tmp);
-	  }
-	  
-	  relativeInner.push_back(inner);
-	  relativeOuter.push_back(outer);
+	  relativeInner.push_back(tablesInner(i));
+	  relativeOuter.push_back(tablesOuter(i));
 	}
 	relativeInner(0)= relativeInner(1);
 	relativeOuter(0)= relativeOuter(1);
@@ -350,6 +399,7 @@ namespace openip
 	esab= new EqualSlopeAtBoundaries<float>(3, 47, 0.4, 1);
 	subimage.resizeImage(3,3);
 	this->useCache= nrg.useCache;
+	this->cacheInitialized= 0;
     }
 
     template<typename INPUT>
@@ -659,6 +709,7 @@ namespace openip
     template<typename INPUT>
     int CorrectionOfEdgeBorders<INPUT>::optimize(Image<INPUT>& input, Image<unsigned char>& labels, Image<unsigned char>* roi, int /*iteration*/)
     {
+      ProfilerScope span("step", "optimize");
       meanWidth= 0;
       nWidth= 0;
       Vector<int> pixels;
@@ -728,6 +779,7 @@ namespace openip
       }
       
       //printf("%d ", changed); fflush(stdout);
+      span.arg("changed", changed);
       return changed;
     }
     
@@ -925,44 +977,143 @@ namespace openip
       return fabs(err);
     }
     
+    template<typename INPUT>
+    void CorrectionOfEdgeBorders<INPUT>::updateLabelDistances(Image<unsigned char>& labels)
+    {
+      // chessboard distance from the nearest label changed since the previous refresh, saturated at 255
+      int rows= labels.rows, columns= labels.columns;
+      
+      for ( unsigned int i= 0; i < labels.n; ++i )
+	labelDistances(i)= labels(i) != cacheLabels(i) ? 0 : 255;
+      
+      for ( int r= 0; r < rows; ++r )
+	for ( int c= 0; c < columns; ++c )
+	{
+	  int i= r*columns + c;
+	  int d= labelDistances(i);
+	  if ( c > 0 && labelDistances(i - 1) + 1 < d )
+	    d= labelDistances(i - 1) + 1;
+	  if ( r > 0 )
+	  {
+	    if ( labelDistances(i - columns) + 1 < d )
+	      d= labelDistances(i - columns) + 1;
+	    if ( c > 0 && labelDistances(i - columns - 1) + 1 < d )
+	      d= labelDistances(i - columns - 1) + 1;
+	    if ( c < columns - 1 && labelDistances(i - columns + 1) + 1 < d )
+	      d= labelDistances(i - columns + 1) + 1;
+	  }
+	  labelDistances(i)= d;
+	}
+      
+      for ( int r= rows - 1; r >= 0; --r )
+	for ( int c= columns - 1; c >= 0; --c )
+	{
+	  int i= r*columns + c;
+	  int d= labelDistances(i);
+	  if ( c < columns - 1 && labelDistances(i + 1) + 1 < d )
+	    d= labelDistances(i + 1) + 1;
+	  if ( r < rows - 1 )
+	  {
+	    if ( labelDistances(i + columns) + 1 < d )
+	      d= labelDistances(i + columns) + 1;
+	    if ( c < columns - 1 && labelDistances(i + columns + 1) + 1 < d )
+	      d= labelDistances(i + columns + 1) + 1;
+	    if ( c > 0 && labelDistances(i + columns - 1) + 1 < d )
+	      d= labelDistances(i + columns - 1) + 1;
+	  }
+	  labelDistances(i)= d;
+	}
+    }
+    
     template<typename INPUT>
     void CorrectionOfEdgeBorders<INPUT>::fillCaches(Image<unsigned char>& labels, Image<INPUT>& input)
     {
       //tprintf("filling caches...");
-      widthCache= -1;
-      riCache= 0;
-      dynCache= 0;
+      ProfilerScope span("step", "fill caches");
+      
+      // after the first call only the descriptors depending on changed labels are recomputed: the descriptors of
+      // a pixel depend on the labels of a square of radius reaches(i), the smoothed widths on a 7x7 square
+      int full= !cacheInitialized || cacheLabels.n != labels.n;
+      
+      if ( full )
+      {
+	widthCache= -1;
+	riCache= 0;
+	dynCache= 0;
+	
+	rawWidths.resizeImage(input);
+	rawWidths= -1;
+	reaches.resizeImage(input);
+	reaches= 0;
+	meanWidths.resizeImage(input);
+	meanWidths= -1;
+	labelDistances.resizeImage(input);
+	smoothDirty.resizeImage(input);
+	cacheLabels.resizeImage(labels);
+      }
+      else
+	updateLabelDistances(labels);
       
-      float ri, width, dyn;
+      smoothDirty= 0;
       
-      meanWidths.resizeImage(input);
-      meanWidths= -1;
+      Vector<int> refreshed;
+      Vector<int> pixels;
+      int slopePixels= 0;
       
       for ( unsigned int i= -ses3.getMin(); i < labels.n - ses3.getMax(); ++i )
       {
 	if ( slopeMask(i) )
 	{
-	  esab->computeDescriptors(labels, i, input, width, dyn, ri);
-	  widthCache(i)= width;
-	  riCache(i)=  ri;
-	  dynCache(i)= dyn;
+	  ++slopePixels;
+	  if ( full || reaches(i) == 0 || labelDistances(i) <= reaches(i) )
+	    pixels.push_back(i);
+	}
+	else if ( reaches(i) )
+	{
+	  rawWidths(i)= -1;
+	  riCache(i)= 0;
+	  dynCache(i)= 0;
+	  reaches(i)= 0;
+	  refreshed.push_back(i);
 	}
       }
       
+      Vector<float> widths, dyns, ris;
+      Vector<int> pixelReaches;
+      esab->computeDescriptors(labels, pixels, input, widths, dyns, ris, &pixelReaches);
+      
+      for ( unsigned int k= 0; k < pixels.size(); ++k )
+      {
+	rawWidths(pixels(k))= widths(k);
+	riCache(pixels(k))= ris(k);
+	dynCache(pixels(k))= dyns(k);
+	reaches(pixels(k))= pixelReaches(k);
+	refreshed.push_back(pixels(k));
+      }
+      
+      if ( !full )
+	for ( unsigned int k= 0; k < refreshed.size(); ++k )
+	  for ( unsigned int j= 0; j < ses5.size(); ++j )
+	    if ( refreshed(k) + ses5(j) >= 0 && refreshed(k) + ses5(j) < int(labels.n) )
+	      smoothDirty(refreshed(k) + ses5(j))= 1;
+      
       float tmp= 0;
       int n= 0;
       for ( unsigned int i= -ses5.getMin(); i < input.n - ses5.getMax(); ++i )
       {
+	if ( !full && !smoothDirty(i) && labelDistances(i) > 3 )
+	  continue;
+	
 	tmp= 0;
 	n= 0;
 	
 	{
 	  for ( unsigned int j= 0; j < ses5.size(); ++j )
-	    if ( widthCache(i) >= 0 )
+	    if ( rawWidths(i) >= 0 )
 	    if ( esab->isInnerContour8(labels,i + ses5(j)) || esab->isOuterContour8(labels,i + ses5(j)) )
-	      if ( widthCache(i + ses5(j)) >= 0 )
+	      if ( rawWidths(i + ses5(j)) >= 0 )
 	      {
-		tmp+= widthCache(i + ses5(j));
+		tmp+= rawWidths(i + ses5(j));
 		++n;
 	      }
 	  
@@ -976,6 +1127,13 @@ namespace openip
       }
 
       widthCache= meanWidths;
+      
+      cacheLabels= labels;
+      cacheInitialized= 1;
+      
+      tprintf("descriptors recomputed: %d/%d\n", int(pixels.size()), slopePixels);
+      span.arg("recomputed", pixels.size());
+      span.arg("slope pixels", slopePixels);
     }
      
     
@@ -996,6 +1154,7 @@ namespace openip
 	widthCache.resizeImage(output);
 	riCache.resizeImage(output);
 	dynCache.resizeImage(output);
+	cacheInitialized= 0;
 	
 	thinned= seed;
 	thinned= 0;
@@ -19,6 +19,7 @@
 #include <openipML/Noises.h>
 #include <openipDS/FilterSet2.h>
 #include <openipDS/Stopper.h>
+#include <openipDS/Profiler.h>
 #include <openipML/PrincipalComponentAnalysis.h>
 #include <openipLL/LowLevelTransforms.h>
 #include <openipLL/Transform2Chain.h>
@@ -32,12 +33,16 @@
 #include <openipLL/Scaling.h>
 #include <openipLL/convexHull.h>
 #include <openipDS/Filter2s.h>
+#include <openipLL/MaxTree.h>
+#include <openipLL/FilterResponseCache.h>
+#include <openipDS/QuantizedImageCache.h>
 
 #include <RetinaRegionGrowing.h>
 #include <RetinaApplicationFunctions.h>
 #include <VesselApplicationFunctions.h>
 
 #include <algorithm>
+#include <map>
 
 using namespace openip;
 
@@ -58,6 +63,13 @@ float vstage1th2multiplier= 1.0;
 float vstage4wa= 5.5;
 float vstage4wb= 7.5;
 float vstage1roiradius= -1;
+char vesselcache[1000]= "cache/responses.cache";
+int vesselcachebudget= 2048;
+int vesselcachelzo= 1;
+int vesselwsobudget= 1024;
+int vesselwsoquantize= 1;
+int vesselsweepwave= 4;
+char vesselprofile[1000]= "";
 bool roc= 0;
 
 int roiRadiusFunction(int /*argc*/, char** argv)
@@ -123,6 +135,7 @@ int extractROI(int, char** argv)
 
 int vstage0FunctionROI(Image<unsigned char>& input, Image<unsigned char>& roi)
 {
+  ProfilerScope span("stage", "stage0 roi");
   tprintf("extract ROI\n");
   
   //Border2 oldborder= input.getBorder2();
@@ -256,6 +269,7 @@ int vstage0FunctionROI(Image<unsigned char>& input, Image<unsigned char>& roi)
 
 int vstage0FunctionExtend(Image<unsigned char>& input, Image<unsigned char>& roi, Image<unsigned char>& extended)
 {
+  ProfilerScope span("stage", "stage0 extension");
   tprintf("extend image\n");
   
   extended.resizeImage(input);
@@ -381,12 +395,33 @@ void updateThresholds(float& th1, float& th2, float minTh2, float th1mult, float
   }
 }
 
-Vector<float> maxPCC;
-int maxpccinit= 0;
-
-int checkOperator(PowerGaborRGLineSegmentTransform2<float,float>* op, int j)
+// state of stages 1 and 4 belonging to one image: the image pyramid, the cache of the correlation maps
+// and the maximum correlations of the operators on Gaussian noise
+struct VesselContext
+{
+  VesselContext()
+  : pyramidinit(0), wsocacheinit(0), maxpccinit(0), maskinit(0)
+  {
+  }
+  
+  Vector<Image<float> > pyramid;
+  Vector<Image<unsigned char> > roipyramid;
+  Vector<Image<unsigned char> > supportpyramid;
+  Vector<float> scales;
+  Vector<float> factors;
+  int pyramidinit;
+  QuantizedImageCache wsocache;
+  int wsocacheinit;
+  Vector<float> maxPCC;
+  int maxpccinit;
+  Vector<int> maskcache;
+  int maskinit;
+  Vector<std::string> pyramiddigest;
+};
+
+int checkOperator(VesselContext& ctx, PowerGaborRGLineSegmentTransform2<float,float>* op, int j)
 {
-  if ( !maxpccinit )
+  if ( !ctx.maxpccinit )
   {
     Image<float> image;
     image.resizeImage(1600,1600);
@@ -418,7 +453,7 @@ int checkOperator(PowerGaborRGLineSegmentTransform2<float,float>* op, int j)
       if ( maxScore < output2(i) )
 	maxScore= output2(i);
     } 
-    maxPCC(j)= maxScore;
+    ctx.maxPCC(j)= maxScore;
     
     tprintf("%.15f\n", n/output2.n);
     if ( n > 0 )
@@ -428,19 +463,16 @@ int checkOperator(PowerGaborRGLineSegmentTransform2<float,float>* op, int j)
   }
   else
   {
-    if ( (op->th1 + op->th2)/2 < maxPCC(j) )
+    if ( (op->th1 + op->th2)/2 < ctx.maxPCC(j) )
       return 0;
     else
       return 1;
   }
 }
 
-Vector<int> maskcache;
-int maskinit= 0;
-
-int checkOperator(PowerGaborSimpleRGLineSegmentTransform2<float,float>* op, int j)
+int checkOperator(VesselContext& ctx, PowerGaborSimpleRGLineSegmentTransform2<float,float>* op, int j)
 {
-  if ( !maxpccinit )
+  if ( !ctx.maxpccinit )
   {
     Image<float> image;
     image.resizeImage(1600,1600);
@@ -473,7 +505,7 @@ int checkOperator(PowerGaborSimpleRGLineSegmentTransform2<float,float>* op, int
 	maxScore= output2(i);
     }
     tprintf("check operator %d against Gaussian noise: %f\n", j, maxScore);
-    maxPCC(j)= maxScore;
+    ctx.maxPCC(j)= maxScore;
     
     tprintf("%.15f\n", n/output2.n);
     if ( n > 0 )
@@ -483,114 +515,180 @@ int checkOperator(PowerGaborSimpleRGLineSegmentTransform2<float,float>* op, int
   }
   else
   {
-    if ( (op->th2 + op->th1)/2 < maxPCC(j) )
+    if ( (op->th2 + op->th1)/2 < ctx.maxPCC(j) )
       return 0;
     else
       return 1;
   }
 }
 
-
-Vector<Image<float> > pyramid;
-Vector<Image<unsigned char> > roipyramid;
-Vector<Image<unsigned char> > supportpyramid;
-Vector<float> scales;
-Vector<float> factors;
-int pyramidinit= 0;
-Vector<Image<float> > wsocache;
-int wsocacheinit= 0;
-
-void applyFilter(int k, Image<float>& input, Image<unsigned char>& roi, Image<unsigned char>& support, Image<float>& res1, Image<float>& res2, Border2 b, PowerGaborRGLineSegmentTransform2<float,float>* op1= NULL, PowerGaborSimpleRGLineSegmentTransform2<float,float>* op2= NULL, int caching= 0, int usepyramid= 0)
+// builds the image pyramid of the context, the first level is the input at the scale of the operators
+void buildPyramid(VesselContext& ctx, Image<float>& input, Image<unsigned char>& roi, Image<unsigned char>& support, float scale, int usepyramid)
 {
-  #pragma omp critical
-  {
-    //printf("in critical %d\n", omp_get_thread_num()); fflush(stdout);
-    if ( pyramidinit == 0 )
-    {
-      tprintf("initializing pyramid %d\n", omp_get_thread_num()); fflush(stdout);
-      scales.clear();
-      factors.clear();
-      pyramid.clear();
-      roipyramid.clear();
-      supportpyramid.clear();
-      Border2 b= input.getBorder2();
-      
-      float scale= 1;
-      if ( op1 )
-	scale= op1->scale;
-      else if ( op2 )
-	scale= op2->scale;
-      
-      scales.push_back(scale);
-      factors.push_back(1);
-      pyramid.push_back(input);
-      roipyramid.push_back(roi);
-      supportpyramid.push_back(support);
-      
-      pyramid(0).removeBorder();
-      roipyramid(0).removeBorder();
-      supportpyramid(0).removeBorder();
-      
-      if ( usepyramid )
+  tprintf("initializing pyramid\n"); fflush(stdout);
+  ProfilerScope span("step", "pyramid");
+  ctx.scales.clear();
+  ctx.factors.clear();
+  ctx.pyramid.clear();
+  ctx.roipyramid.clear();
+  ctx.supportpyramid.clear();
+  ctx.pyramiddigest.clear();
+  Border2 b= input.getBorder2();
+  
+  ctx.scales.push_back(scale);
+  ctx.factors.push_back(1);
+  ctx.pyramid.push_back(input);
+  ctx.roipyramid.push_back(roi);
+  ctx.supportpyramid.push_back(support);
+  
+  ctx.pyramid(0).removeBorder();
+  ctx.roipyramid(0).removeBorder();
+  ctx.supportpyramid(0).removeBorder();
+  
+  if ( usepyramid )
+  {
+    tprintf("usepyramid\n"); fflush(stdout);
+    float sc= scale;
+    float fact= 1;
+    int columns= ctx.pyramid(0).columns;
+    int rows= ctx.pyramid(0).rows;
+    for ( int i= 0; i < 20; ++i )
+    {
+      tprintf("scale: %d\n", i); fflush(stdout);
+      sc*= 0.9;
+      fact*= 0.9;
+      Image<float> inp;
+      Image<unsigned char> ro, su;
+      inp.resizeImage(rows*fact, columns*fact);
+      ro.resizeImage(rows*fact, columns*fact);
+      su.resizeImage(rows*fact, columns*fact);
+      
+      gaussianScaling(ctx.pyramid(0), inp);
+      gaussianScaling(ctx.roipyramid(0), ro);
+      gaussianScaling(ctx.supportpyramid(0), su);
+      
+      for ( unsigned int i= 0; i < ro.n; ++i )
       {
-        tprintf("usepyramid %d\n", omp_get_thread_num()); fflush(stdout);
-	float sc= scale;
-	float fact= 1;
-	int columns= pyramid(0).columns;
-	int rows= pyramid(0).rows;
-	for ( int i= 0; i < 20; ++i )
-	{
-          tprintf("scale: %d\n", i); fflush(stdout);
-	  sc*= 0.9;
-	  fact*= 0.9;
-	  Image<float> inp;
-	  Image<unsigned char> ro, su;
-	  inp.resizeImage(rows*fact, columns*fact);
-	  ro.resizeImage(rows*fact, columns*fact);
-	  su.resizeImage(rows*fact, columns*fact);
-	  
-          //printf("before gaussian scaling\n"); fflush(stdout);
-	  gaussianScaling(pyramid(0), inp);
-	  gaussianScaling(roipyramid(0), ro);
-	  gaussianScaling(supportpyramid(0), su);
-          //printf("after gaussian scaling\n"); fflush(stdout);
-	  
-	  for ( unsigned int i= 0; i < ro.n; ++i )
-	  {
-	    if ( ro(i) > 128 )
-	      ro(i)= 255;
-	    else
-	      ro(i)= 0;
-	    if ( su(i) > 128 )
-	      su(i)= 255;
-	    else
-	      su(i)= 0;
-	  }
-	  
-	  char filename[100];
-	  sprintf(filename, "roi-%f.bmp", fact);
-	  writeImage(filename, ro);
-	  
-	  pyramid.push_back(inp);
-	  roipyramid.push_back(ro);
-	  supportpyramid.push_back(su);
-	  scales.push_back(sc);
-	  factors.push_back(fact);
-	  
-	  tprintf("pyramid: %f %d %d, %d %d %d %d %d\n", sc, inp.columns, pyramid(pyramid.size()-1).columns, pyramid.size(), roipyramid.size(), supportpyramid.size(), scales.size(), factors.size());
-	}
+	if ( ro(i) > 128 )
+	  ro(i)= 255;
+	else
+	  ro(i)= 0;
+	if ( su(i) > 128 )
+	  su(i)= 255;
+	else
+	  su(i)= 0;
       }
-      for ( unsigned int i= 0; i < pyramid.size(); ++i )
+      
+      char filename[100];
+      sprintf(filename, "roi-%f.bmp", fact);
+      writeImage(filename, ro);
+      
+      ctx.pyramid.push_back(inp);
+      ctx.roipyramid.push_back(ro);
+      ctx.supportpyramid.push_back(su);
+      ctx.scales.push_back(sc);
+      ctx.factors.push_back(fact);
+      
+      tprintf("pyramid: %f %d %d, %d %d %d %d %d\n", sc, inp.columns, ctx.pyramid(ctx.pyramid.size()-1).columns, ctx.pyramid.size(), ctx.roipyramid.size(), ctx.supportpyramid.size(), ctx.scales.size(), ctx.factors.size());
+    }
+  }
+  for ( unsigned int i= 0; i < ctx.pyramid.size(); ++i )
+  {
+    ctx.pyramid(i).setBorder(b);
+    ctx.roipyramid(i).setBorder(b);
+    ctx.supportpyramid(i).setBorder(b);
+    ctx.pyramiddigest.push_back(FilterResponseCache::digest(ctx.pyramid(i), &(ctx.roipyramid(i))));
+  }
+  
+  ctx.pyramidinit= 1;
+}
+
+// frees a set of operators generated from a feature file
+void deleteTransform2Set(Transform2Set<float, float>* t2set)
+{
+  for ( unsigned int i= 0; i < t2set->size(); ++i )
+    delete (*t2set)(i);
+  delete t2set;
+}
+
+// returns the scale of a PowerGabor*RGLineSegmentTransform2 operator
+float operatorScale(VectorTransform2<float, float>* t)
+{
+  if ( dynamic_cast<PowerGaborRGLineSegmentTransform2<float,float>*>(t) != NULL )
+    return dynamic_cast<PowerGaborRGLineSegmentTransform2<float,float>*>(t)->scale;
+  if ( dynamic_cast<PowerGaborSimpleRGLineSegmentTransform2<float,float>*>(t) != NULL )
+    return dynamic_cast<PowerGaborSimpleRGLineSegmentTransform2<float,float>*>(t)->scale;
+  return 1;
+}
+
+// votes of one operator or filter bank: pixels in increasing order and the values added to them, all the values are 1 if values is empty
+struct VoteList
+{
+  Vector<int> pixels;
+  Vector<float> values;
+};
+
+// adds the vote lists to the accumulators in the order of the lists, in parallel over strips of pixels;
+// the votes of each pixel are summed in the same order for any number of threads. A dense accumulator
+// per thread would not cost more memory, every iteration of the batches already holds full images, but
+// its float sums would depend on which operators the thread received, that is on the schedule
+template<typename T>
+void reduceVotes(Vector<VoteList>& votes, Image<T>& sum, Image<float>* count= NULL)
+{
+  ProfilerScope span("step", "reduce votes");
+  span.arg("lists", votes.size());
+  
+  int strips= 4*omp_get_max_threads();
+
+  #pragma omp parallel for schedule(dynamic, 1)
+  for ( int s= 0; s < strips; ++s )
+  {
+    int begin= int((long long)(sum.n)*s/strips);
+    int end= int((long long)(sum.n)*(s+1)/strips);
+
+    for ( unsigned int l= 0; l < votes.size(); ++l )
+    {
+      Vector<int>& pixels= votes(l).pixels;
+      Vector<float>& values= votes(l).values;
+      int k= std::lower_bound(pixels.begin(), pixels.end(), begin) - pixels.begin();
+      for ( ; k < int(pixels.size()) && pixels(k) < end; ++k )
       {
-	pyramid(i).setBorder(b);
-	roipyramid(i).setBorder(b);
-	supportpyramid(i).setBorder(b);
+	if ( values.size() )
+	  sum(pixels(k))+= values(k);
+	else
+	  sum(pixels(k))+= 1;
+	if ( count )
+	  (*count)(pixels(k))+= 1.0;
       }
-      
-      pyramidinit= 1;
     }
   }
+}
+
+// cache of the filter responses shared by the threads and processes working on the same images
+FilterResponseCache responseCache;
 
+// opens the response cache on the first use, returns 1 if the cache is available
+int openResponseCache()
+{
+  static int opened= 0;
+  #pragma omp critical (responseCacheOpen)
+  {
+    if ( !opened )
+    {
+      opened= 1;
+      if ( responseCache.open(vesselcache, (long long)(vesselcachebudget)*1024*1024, vesselcachelzo) )
+        tprintf("response cache %s is not available\n", vesselcache);
+    }
+  }
+  return responseCache.isOpen();
+}
+
+// computes the matched correlation response of operator k into res2 (at the scale of the input), the pyramid of the context has to be built in advance
+void applyFilterResponse(VesselContext& ctx, int k, Image<float>& /*input*/, Image<unsigned char>& /*roi*/, Image<unsigned char>& /*support*/, Image<float>& res2, Border2 /*b*/, PowerGaborRGLineSegmentTransform2<float,float>* op1= NULL, PowerGaborSimpleRGLineSegmentTransform2<float,float>* op2= NULL, int caching= 0, int /*usepyramid*/= 0)
+{
+  ProfilerScope span("operator", "filter");
+  span.arg("operator", k);
+  
   float size= 0;
   if ( op1 )
     size= op1->mgf->operator[](0)->size();
@@ -599,10 +697,10 @@ void applyFilter(int k, Image<float>& input, Image<unsigned char>& roi, Image<un
   
   int scaleIdx= 0;
   float minDist= FLT_MAX;
-  for ( unsigned int i= 0; i < scales.size(); ++i )
+  for ( unsigned int i= 0; i < ctx.scales.size(); ++i )
   {
-    float dist= fabs(size*factors(i)*factors(i) - 240);
-    if ( dist < minDist && size*factors(i)*factors(i) > 240 )
+    float dist= fabs(size*ctx.factors(i)*ctx.factors(i) - 240);
+    if ( dist < minDist && size*ctx.factors(i)*ctx.factors(i) > 240 )
     {
       scaleIdx= i;
       minDist= dist;
@@ -611,146 +709,156 @@ void applyFilter(int k, Image<float>& input, Image<unsigned char>& roi, Image<un
   
   if ( op1 )
   {
-    op1->scale= scales(scaleIdx);
+    op1->scale= ctx.scales(scaleIdx);
     op1->regenerate();
   }
   else if ( op2 )
   {
-    op2->scale= scales(scaleIdx);
+    op2->scale= ctx.scales(scaleIdx);
     op2->regenerate();
   }
   
-  Image<float> result1;
-  result1.resizeImage(pyramid(scaleIdx));
   Image<float> result2;
-  result2.resizeImage(pyramid(scaleIdx));
+  result2.resizeImage(ctx.pyramid(scaleIdx));
+  span.arg("pixels", result2.n);
   
-  File file(input.filename);
-  string filename= file.getFilename();
-  string featureName;
-  if ( op1 )
-    featureName= op1->getDescriptor('_');
-  else if ( op2 )
-    featureName= op2->getDescriptor('_');
-
-  char filename3[1000];
-  sprintf(filename3, "cache/%s-%s.float", filename.c_str(), featureName.c_str());
-  FILE* fil2= fopen(filename3, "r");
-  int exists= (fil2 != NULL);
+  // the response is addressed by the content of the pyramid level and the parameters of the filter bank
+  std::string key;
+  if ( caching && (op1 || op2) && openResponseCache() )
+  {
+    std::stringstream ss;
+    ss << ctx.pyramiddigest(scaleIdx) << " " << (op1 ? op1->mgf->descriptor : op2->mgf->descriptor) << " " << ctx.scales(scaleIdx);
+    key= ss.str();
+  }
   
-  if ( exists )
-    fclose(fil2);
-      
-  if ( exists && caching )
+  // responses over the budget of the in-memory cache are loaded from the response cache or recomputed
+  if ( caching && ctx.wsocacheinit && ctx.wsocache.get(k, result2, &(ctx.roipyramid(scaleIdx))) == 0 )
+    bilinearScaling(result2, res2);
+  else if ( key.size() && responseCache.get(key, result2) == 0 )
   {
     printf("."); fflush(stdout);
-
-    if ( !wsocacheinit || (wsocacheinit && wsocache(k).n <= 1) )
-    {
-      readImage(filename3, result2, b);
-      wsocache(k)= result2;
-    }
-    else if ( wsocacheinit )
-      result2= wsocache(k);
+    
+    if ( ctx.wsocacheinit )
+      ctx.wsocache.put(k, result2, &(ctx.roipyramid(scaleIdx)));
     
     bilinearScaling(result2, res2);
+  }
+  else
+  {
+    span.arg("computed", 1);
+    profiler.count("pixels filtered", result2.n);
     
-    float th1= 0, th2= 0;
+    // only the correlation map is needed here, thresholding is done on the rescaled response
     if ( op1 )
     {
-      th1= op1->th1;
-      th2= op1->th2;
+      op1->mgf->updateStride(ctx.pyramid(scaleIdx).columns);
+      op1->mgf->apply(ctx.pyramid(scaleIdx), result2, &(ctx.roipyramid(scaleIdx)));
     }
     else if ( op2 )
     {
-      th1= op2->th1;
-      th2= op2->th2;
+      op2->mgf->updateStride(ctx.pyramid(scaleIdx).columns);
+      op2->mgf->apply(ctx.pyramid(scaleIdx), result2, &(ctx.roipyramid(scaleIdx)));
     }
     
-    PowerGaborSimpleRGLineSegmentTransform2<float, float> rg(th1, th2, 2, 2, 2, 2, 2, 2, 2, 2);
-    result1= 0;
-    rg.applyOnlyRG(res2, res1, &(roipyramid(0)), &(supportpyramid(0)));
+    bilinearScaling(result2, res2);
+    
+    if ( caching && ctx.wsocacheinit && !ctx.wsocache.contains(k) )
+      ctx.wsocache.put(k, result2, &(ctx.roipyramid(scaleIdx)));
+    
+    if ( key.size() )
+      responseCache.put(key, result2);
   }
-  else if ( !exists || !caching )
+}
+
+// seeds and grows the regions of an operator with thresholds th1, th2 on a precomputed response
+void applyThresholdRG(VesselContext& ctx, float th1, float th2, Image<float>& res2, Image<float>& res1)
+{
+  ProfilerScope span("operator", "region growing");
+  span.arg("th1", th1);
+  span.arg("th2", th2);
+  PowerGaborSimpleRGLineSegmentTransform2<float, float> rg(th1, th2, 2, 2, 2, 2, 2, 2, 2, 2);
+  rg.applyOnlyRG(res2, res1, &(ctx.roipyramid(0)), &(ctx.supportpyramid(0)));
+}
+
+void applyFilter(VesselContext& ctx, int k, Image<float>& input, Image<unsigned char>& roi, Image<unsigned char>& support, Image<float>& res1, Image<float>& res2, Border2 b, PowerGaborRGLineSegmentTransform2<float,float>* op1= NULL, PowerGaborSimpleRGLineSegmentTransform2<float,float>* op2= NULL, int caching= 0, int usepyramid= 0)
+{
+  applyFilterResponse(ctx, k, input, roi, support, res2, b, op1, op2, caching, usepyramid);
+  
+  if ( op1 )
+    applyThresholdRG(ctx, op1->th1, op1->th2, res2, res1);
+  else if ( op2 )
+    applyThresholdRG(ctx, op2->th1, op2->th2, res2, res1);
+}
+
+// groups the active operators of t2set by their filter bank (filter type, parameters and scale);
+// the first element of each group is the operator whose response is computed
+void groupOperatorsByFilterBank(Transform2Set<float, float>& t2set, Vector<Vector<int> >& groups, Vector<int>& mask2, Vector<int>* mask= NULL)
+{
+  groups.clear();
+  std::map<std::string, int> keys;
+  
+  for ( unsigned int j= 0; j < t2set.size(); ++j )
   {
-    if ( op1 )
-      op1->applyGetFiltered(pyramid(scaleIdx), result1, result2, &(roipyramid(scaleIdx)), &(supportpyramid(scaleIdx)));
-    else if ( op2 )
-      op2->applyGetFiltered(pyramid(scaleIdx), result1, result2, &(roipyramid(scaleIdx)), &(supportpyramid(scaleIdx)));
-    
-    bilinearScaling(result2, res2);
+    if ( (mask && (*mask)(j) == 0) || !mask2(j) )
+      continue;
     
-    float th1= 0, th2= 0;
-    if ( op1 )
+    std::stringstream ss;
+    if ( dynamic_cast<PowerGaborRGLineSegmentTransform2<float,float>*>(t2set(j)) != NULL )
     {
-      th1= op1->th1;
-      th2= op1->th2;
+      PowerGaborRGLineSegmentTransform2<float,float>* tmp= dynamic_cast<PowerGaborRGLineSegmentTransform2<float,float>*>(t2set(j));
+      ss << tmp->mgf->descriptor << " " << tmp->scale;
     }
-    else if ( op2 )
+    else if ( dynamic_cast<PowerGaborSimpleRGLineSegmentTransform2<float,float>*>(t2set(j)) != NULL )
     {
-      th1= op2->th1;
-      th2= op2->th2;
+      PowerGaborSimpleRGLineSegmentTransform2<float,float>* tmp= dynamic_cast<PowerGaborSimpleRGLineSegmentTransform2<float,float>*>(t2set(j));
+      ss << tmp->mgf->descriptor << " " << tmp->scale;
     }
+    else
+      continue;
     
-    PowerGaborSimpleRGLineSegmentTransform2<float, float> rg(th1, th2, 2, 2, 2, 2, 2, 2, 2, 2);
-    result1= 0;
-    rg.applyOnlyRG(res2, res1, &(roipyramid(0)), &(supportpyramid(0)));
-    
-    if ( wsocacheinit && wsocache(k).n <= 1 )
-      wsocache(k)= result2;
-  }
-  
-  if ( !exists && caching )
-  {
-    writeImage(filename3, result2);
+    std::map<std::string, int>::iterator it= keys.find(ss.str());
+    if ( it == keys.end() )
+    {
+      keys[ss.str()]= groups.size();
+      groups.push_back(Vector<int>());
+      groups(groups.size()-1).push_back(j);
+    }
+    else
+      groups(it->second).push_back(j);
   }
 }
 
 // applies a set of gabor filters -- region growing operators and fuses the results
-int vstage1Function(char* featureFile, Image<float>& input, Image<unsigned char>& roi, Image<unsigned char>& support, Image<unsigned char>& output, int thresholdStart, float th1mult, float th2mult, float imageScale, int caching= 1, int lambdaThreshold= -1, Image<unsigned char>* imc= NULL, float* dist= NULL, Vector<int>* mask= NULL, int usepyramid= 0)
+// initializes the operators of stage 1 at the given scale: the operators failing the Gaussian noise
+// test are masked out in mask2 (unknown images only) and the thresholds are updated by the multipliers
+float initializeStage1Operators(VesselContext& ctx, Transform2Set<float, float>& t2set, float imageScale, float th1mult, float th2mult, Vector<int>& mask2)
 {
-  tprintf("vessel segmentation stage1 simple, features: %s, thresholdStart: %d, scale: %f, caching: %d, thmult1: %f, thmult2: %f, lambdaThreshold: %d, etalon: %f mode0: %d, mode1: %d caching: %d, usepyramid: %d, imc: %p\n", featureFile, thresholdStart, imageScale, caching, th1mult, th2mult, lambdaThreshold, vstage1limit, vstage1mode0, vstage1mode1, caching, usepyramid, imc);
-
-  Transform2Set<float, float>& t2set= *(generateTransform2Set<float, float>(std::string(featureFile), std::string("feature")));
-  
-  tprintf("t2set.size(): %d\n", t2set.size());
-  
-  Border2 b1(71, 71, 71, 71);
-  Border2 b2= t2set.getProposedBorder();
-  Border2 b(b1, b2);
-  b.borderMode= BORDER_MODE_ZERO;
-  tprintf("borders computed %d %d %d %d\n", b.topBorder, b.bottomBorder, b.leftBorder, b.rightBorder);
-  
-  Vector<int> mask2;
-  mask2.resize(t2set.size());
-  wsocacheinit= 1;
-  wsocache.resize(t2set.size());
-  mask2= 1;
-  if ( maskinit == 0 )
-    maskcache.resize(t2set.size());
-  
   float minTh2= FLT_MAX;
   
   char fname[100];
   sprintf(fname, "maxPCC-%f.txt", imageScale);
   FILE* fmc= NULL;
-  fmc= fopen(fname, "r");
-  if ( fmc != NULL )
+  // the file is shared by the images processed concurrently
+  #pragma omp critical (maxPCCFile)
   {
-    maxPCC.resize(t2set.size());
-    maxpccinit= 1;
-    float flag;
-    for ( unsigned int i= 0; i < maxPCC.size(); ++i )
+    fmc= fopen(fname, "r");
+    if ( fmc != NULL )
     {
-      int rv= fscanf(fmc, "%f", &flag);
-      if ( rv != 1 )
-	break;
-      maxPCC(i)= flag;
+      ctx.maxPCC.resize(t2set.size());
+      ctx.maxpccinit= 1;
+      float flag;
+      for ( unsigned int i= 0; i < ctx.maxPCC.size(); ++i )
+      {
+        int rv= fscanf(fmc, "%f", &flag);
+        if ( rv != 1 )
+	  break;
+        ctx.maxPCC(i)= flag;
+      }
+      fclose(fmc);
     }
-    fclose(fmc);
+    else
+      ctx.maxPCC.resize(t2set.size());
   }
-  else
-    maxPCC.resize(t2set.size());
   
   for ( unsigned int i= 0; i < t2set.size(); ++i )
   {
@@ -788,7 +896,7 @@ int vstage1Function(char* featureFile, Image<float>& input, Image<unsigned char>
 	if ( !roc )
 	{
 	  if ( tmp->mgf->operator[](0)->size() < 100 )
-	    mask2(i)= checkOperator(tmp, i);
+	    mask2(i)= checkOperator(ctx, tmp, i);
 	}
       }
       
@@ -811,7 +919,7 @@ int vstage1Function(char* featureFile, Image<float>& input, Image<unsigned char>
 	if ( !roc )
 	{
 	  if ( tmp->mgf->operator[](0)->size() < 100 )
-	    mask2(i)= checkOperator(tmp, i);
+	    mask2(i)= checkOperator(ctx, tmp, i);
 	}
       }
       
@@ -824,20 +932,179 @@ int vstage1Function(char* featureFile, Image<float>& input, Image<unsigned char>
   }
   
   tprintf("features generated\n");
-  maxpccinit= 1;
+  ctx.maxpccinit= 1;
   
-  fmc= fopen(fname, "r");
-  if ( fmc == NULL )
+  // the file is shared by the images processed concurrently
+  #pragma omp critical (maxPCCFile)
   {
-    fmc= fopen(fname, "w");
-    for ( unsigned int i= 0; i < maxPCC.size(); ++i )
-      fprintf(fmc, "%f\n", maxPCC(i));
-    fclose(fmc);
+    fmc= fopen(fname, "r");
+    if ( fmc == NULL )
+    {
+      fmc= fopen(fname, "w");
+      for ( unsigned int i= 0; i < ctx.maxPCC.size(); ++i )
+        fprintf(fmc, "%f\n", ctx.maxPCC(i));
+      fclose(fmc);
+    }
+    else
+    {
+      fclose(fmc);
+    }
   }
-  else
+  
+  return minTh2;
+}
+
+// collects the thresholds of the operators
+void operatorThresholds(Transform2Set<float, float>& t2set, Vector<float>& th1s, Vector<float>& th2s)
+{
+  th1s.resize(t2set.size());
+  th2s.resize(t2set.size());
+  th1s= 0;
+  th2s= 0;
+  for ( unsigned int j= 0; j < t2set.size(); ++j )
   {
-    fclose(fmc);
+    PowerGaborRGLineSegmentTransform2<float,float>* op1= dynamic_cast<PowerGaborRGLineSegmentTransform2<float,float>*>(t2set(j));
+    PowerGaborSimpleRGLineSegmentTransform2<float,float>* op2= dynamic_cast<PowerGaborSimpleRGLineSegmentTransform2<float,float>*>(t2set(j));
+    if ( op1 )
+    {
+      th1s(j)= op1->th1;
+      th2s(j)= op1->th2;
+    }
+    else if ( op2 )
+    {
+      th1s(j)= op2->th1;
+      th2s(j)= op2->th2;
+    }
   }
+}
+
+// sets the thresholds of the operators, collected earlier by operatorThresholds
+void setOperatorThresholds(Transform2Set<float, float>& t2set, Vector<float>& th1s, Vector<float>& th2s)
+{
+  for ( unsigned int j= 0; j < t2set.size(); ++j )
+  {
+    PowerGaborRGLineSegmentTransform2<float,float>* op1= dynamic_cast<PowerGaborRGLineSegmentTransform2<float,float>*>(t2set(j));
+    PowerGaborSimpleRGLineSegmentTransform2<float,float>* op2= dynamic_cast<PowerGaborSimpleRGLineSegmentTransform2<float,float>*>(t2set(j));
+    if ( op1 )
+    {
+      op1->th1= th1s(j);
+      op1->th2= th2s(j);
+    }
+    else if ( op2 )
+    {
+      op2->th1= th1s(j);
+      op2->th2= th2s(j);
+    }
+  }
+}
+
+// stage 1 votes of the operators of a filter bank group on the response of the group: the pixels of the
+// elongated regions inside the roi are appended to pixels, in increasing order
+void voteStage1Group(VesselContext& ctx, Vector<int>& group, Vector<float>& th1s, Vector<float>& th2s, Image<float>& input, Image<float>& response, Image<unsigned char>& roi, Vector<int>& pixels)
+{
+  Image<float> result(input);
+  Image<unsigned char> rtmp;
+  rtmp.resizeImage(input);
+  
+  for ( unsigned int m= 0; m < group.size(); ++m )
+  {
+    int j= group(m);
+    applyThresholdRG(ctx, th1s(j), th2s(j), response, result);
+    
+    ExtractRegions er;
+    CompactRegion2Set regions;
+    
+    rtmp= result;
+    
+    unsigned int nonzeroelements= rtmp.numberOfNonZeroElements();
+    if ( nonzeroelements == rtmp.n || nonzeroelements == 0 )
+      continue;
+    
+    {
+      ProfilerScope span("operator", "labeling");
+      er.apply(rtmp, regions);
+      span.arg("operator", j);
+      span.arg("regions", regions.size());
+    }
+    profiler.count("pixels grown", nonzeroelements);
+    profiler.count("regions found", regions.size());
+    
+    Vector<float> circularities;
+    for ( unsigned int i= 0; i < regions.size(); ++i )
+      circularities.push_back(circularity(regions.region(i), regions.regionSize(i), rtmp));
+      
+    for ( unsigned int i= 0; i < regions.size(); ++i )
+      if ( circularities(i) < 0.3 )
+        for ( int k= regions.offsets(i); k < regions.offsets(i+1); ++k )
+          if ( (roi(regions.pixels(k))) )
+            pixels.push_back(regions.pixels(k));
+  }
+  
+  std::sort(pixels.begin(), pixels.end());
+}
+
+// distance of the relative intensities along the inner and outer contours of the segmentation
+float relativeIntensityDistance(Image<unsigned char>& output, Image<float>& input, Image<unsigned char>& roi)
+{
+  Vector<int> inner, outer;
+  for ( unsigned int i= 0; i < output.n; ++i )
+  {
+      if ( roi.isRealImagePixel(i) && output(i) && Region2::isInnerContour4(output, i) )
+	inner.push_back(i);
+      
+      if ( roi.isRealImagePixel(i) && !output(i) && Region2::isOuterContour4(output, i) )
+	outer.push_back(i);
+  }
+  
+  // the descriptors of the contours are computed in batches, the engine is not shared with other threads
+  EqualSlopeAtBoundaries<float> esab(3, 87, 0.4, 1);
+  esab.updateStride(output.columns);
+  
+  Vector<float> rii, rio, widths, dyns;
+  double riw= 0, row= 0;
+  
+  esab.computeDescriptors(output, inner, input, widths, dyns, rii);
+  esab.swidthc(output, inner, widths);
+  for ( unsigned int i= 0; i < widths.size(); ++i )
+    riw+= widths(i);
+  
+  esab.computeDescriptors(output, outer, input, widths, dyns, rio);
+  esab.swidthc(output, outer, widths);
+  for ( unsigned int i= 0; i < widths.size(); ++i )
+    row+= widths(i);
+  
+  tprintf("ri: %f %f %f %f\n", rii.getMean(), rio.getMean(), (rii.getMean() + rio.getMean())/2, fabs(rii.getMean() - rio.getMean()));
+  
+  return 1 - fabs(rii.getMean() - rio.getMean());
+  //return fabs(0.5 - fabs(rii.getMean() + rio.getMean())/2);
+}
+
+int vstage1Function(VesselContext& ctx, char* featureFile, Image<float>& input, Image<unsigned char>& roi, Image<unsigned char>& support, Image<unsigned char>& output, int thresholdStart, float th1mult, float th2mult, float imageScale, int caching= 1, int lambdaThreshold= -1, Image<unsigned char>* imc= NULL, float* dist= NULL, Vector<int>* mask= NULL, int usepyramid= 0, Transform2Set<float, float>* t2setp= NULL)
+{
+  ProfilerScope span("stage", "stage1");
+  tprintf("vessel segmentation stage1 simple, features: %s, thresholdStart: %d, scale: %f, caching: %d, thmult1: %f, thmult2: %f, lambdaThreshold: %d, etalon: %f mode0: %d, mode1: %d caching: %d, usepyramid: %d, imc: %p\n", featureFile, thresholdStart, imageScale, caching, th1mult, th2mult, lambdaThreshold, vstage1limit, vstage1mode0, vstage1mode1, caching, usepyramid, imc);
+
+  // the set of an earlier stage is reused if given, otherwise it is parsed from the feature file
+  Transform2Set<float, float>& t2set= t2setp ? *t2setp : *(generateTransform2Set<float, float>(std::string(featureFile), std::string("feature")));
+  
+  tprintf("t2set.size(): %d\n", t2set.size());
+  
+  Border2 b1(71, 71, 71, 71);
+  Border2 b2= t2set.getProposedBorder();
+  Border2 b(b1, b2);
+  b.borderMode= BORDER_MODE_ZERO;
+  tprintf("borders computed %d %d %d %d\n", b.topBorder, b.bottomBorder, b.leftBorder, b.rightBorder);
+  
+  Vector<int> mask2;
+  mask2.resize(t2set.size());
+  ctx.wsocacheinit= 1;
+  ctx.wsocache.resize(t2set.size());
+  ctx.wsocache.setBudget((long long)(vesselwsobudget)*1024*1024, vesselwsoquantize);
+  mask2= 1;
+  if ( ctx.maskinit == 0 )
+    ctx.maskcache.resize(t2set.size());
+  
+  initializeStage1Operators(ctx, t2set, imageScale, th1mult, th2mult, mask2);
   
   tprintf("size of t2set after scaling: %d\n", mask2.numberOfNonZeroElements());
 
@@ -866,59 +1133,50 @@ int vstage1Function(char* featureFile, Image<float>& input, Image<unsigned char>
   reducedROI= roi;
   tprintf("roi size: %d\n", roi.numberOfNonZeroElements());
   
+  // operators differing only in th1/th2 share the same filter bank, their response is computed once
+  Vector<Vector<int> > groups;
+  groupOperatorsByFilterBank(t2set, groups, mask2, mask);
+  tprintf("distinct filter banks: %d\n", groups.size());
+  
+  Vector<float> th1s, th2s;
+  operatorThresholds(t2set, th1s, th2s);
+  
+  if ( ctx.pyramidinit == 0 && groups.size() > 0 )
+    buildPyramid(ctx, input, reducedROI, support, operatorScale(t2set(groups(0)(0))), usepyramid);
+  
   tprintf("starting applying the transforms\n");
-  int completed= 0;
+  int completed= t2set.size() - mask2.numberOfNonZeroElements();
   
-  #pragma omp parallel for schedule(dynamic, 2)
-  for ( unsigned int j= 0; j < t2set.size(); ++j )
+  // the filter banks are processed in batches, the votes of a batch are collected into per filter bank
+  // lists without synchronization and added to outputTmp by a parallel reduction after the batch
+  unsigned int batch= 2*omp_get_max_threads();
+  for ( unsigned int first= 0; first < groups.size(); first+= batch )
   {
-    if ( (mask && (*mask)(j) == 0) || !mask2(j) )
-    {
-      completed++;
-      continue;
-    }
+    unsigned int last= std::min(first + batch, (unsigned int)(groups.size()));
+    Vector<VoteList> votes(last - first);
     
-    int threadnum= omp_get_thread_num();
-    if ( threadnum == 0 )
+    #pragma omp parallel for schedule(dynamic, 1)
+    for ( unsigned int g= first; g < last; ++g )
     {
-      printf("tcompleted/total: %d/%zd\n", completed, t2set.size());
-      fflush(stdout);
-    }
-    
-    Image<float> result(input), result2(input);
-    Image<unsigned char> rtmp;
-    rtmp.resizeImage(input);
-    
-    //tprintf("thread %d applying %d\n", omp_get_thread_num(), j); fflush(stdout);
-    if ( dynamic_cast<PowerGaborRGLineSegmentTransform2<float, float>*>(t2set(j)) != NULL )
-      applyFilter(j, input, reducedROI, support, result, result2, b, dynamic_cast<PowerGaborRGLineSegmentTransform2<float,float>*>(t2set(j)), NULL, caching, usepyramid);
-    else if ( dynamic_cast<PowerGaborSimpleRGLineSegmentTransform2<float,float>*>(t2set(j)) != NULL )
-      applyFilter(j, input, reducedROI, support, result, result2, b, NULL, dynamic_cast<PowerGaborSimpleRGLineSegmentTransform2<float,float>*>(t2set(j)), caching, usepyramid);
-    //tprintf("thread %d applied %d\n", omp_get_thread_num(), j); fflush(stdout);
-    ExtractRegions er;
-    Region2Set regions;
-    
-    rtmp= result;
-
-    unsigned int nonzeroelements= rtmp.numberOfNonZeroElements();
-    if ( nonzeroelements == rtmp.n || nonzeroelements == 0 )
-      continue;
-    
-    er.apply(rtmp, regions);
-    
-    Vector<float> circularities;
-    for ( unsigned int i= 0; i < regions.size(); ++i )
-      circularities.push_back(circularity(regions(i), rtmp));
+      int threadnum= omp_get_thread_num();
+      if ( threadnum == 0 )
+      {
+        printf("tcompleted/total: %d/%zd\n", completed, t2set.size());
+        fflush(stdout);
+      }
       
-    #pragma omp critical
-    {
-      for ( unsigned int i= 0; i < regions.size(); ++i )
-	if ( circularities(i) < 0.3 )
-	  for ( unsigned int k= 0; k < regions(i).size(); ++k )
-	    if ( (roi(regions(i)(k))) )
-	      outputTmp(regions(i)(k))++;
-      completed++;
+      Image<float> result2(input);
+      
+      int owner= groups(g)(0);
+      applyFilterResponse(ctx, owner, input, reducedROI, support, result2, b, dynamic_cast<PowerGaborRGLineSegmentTransform2<float,float>*>(t2set(owner)), dynamic_cast<PowerGaborSimpleRGLineSegmentTransform2<float,float>*>(t2set(owner)), caching, usepyramid);
+      
+      voteStage1Group(ctx, groups(g), th1s, th2s, input, result2, roi, votes(g - first).pixels);
+      
+      #pragma omp atomic
+      completed+= groups(g).size();
     }
+    
+    reduceVotes(votes, outputTmp);
   }
   tprintf("starting adaptive thresholding, %d, %d, %d; %d, %d, %d\n", roi.columns, output.columns, input.columns, roi.leftBorder, output.leftBorder, input.leftBorder);
   
@@ -927,32 +1185,171 @@ int vstage1Function(char* featureFile, Image<float>& input, Image<unsigned char>
   
   //writeImage("output0.bmp", output);
   
-  Vector<float> rii, rio;
-  double riw= 0, row= 0;
-  for ( unsigned int i= 0; i < output.n; ++i )
+  float d= relativeIntensityDistance(output, input, roi);
+  if ( dist != NULL )
+    *dist= d;
+  
+  input.resizeBorder(originalBorder);
+  support.resizeBorder(originalBorder);
+  roi.resizeBorder(originalBorder);
+  output.resizeBorder(originalBorder);
+  
+  return 0;
+}
+
+// stage 1 for a sweep of threshold multipliers: the responses of the filter banks are computed once and
+// held, for each multiplier only the seeding, region growing and voting is done, in parallel across
+// the multipliers; the sweep stops when the relative intensity distance rises twice in a row. The output
+// is the segmentation of the multiplier with the smallest distance.
+int vstage1SweepFunction(VesselContext& ctx, char* featureFile, Image<float>& input, Image<unsigned char>& roi, Image<unsigned char>& support, Image<unsigned char>& output, Vector<float>& multipliers, float imageScale, float& bestMultiplier, Vector<int>* mask= NULL, int usepyramid= 0)
+{
+  ProfilerScope span("stage", "stage1 sweep");
+  tprintf("vessel segmentation stage1 sweep, features: %s, multipliers: %d, scale: %f, usepyramid: %d\n", featureFile, multipliers.size(), imageScale, usepyramid);
+  
+  Transform2Set<float, float>& t2set= *(generateTransform2Set<float, float>(std::string(featureFile), std::string("feature")));
+  
+  Border2 b1(71, 71, 71, 71);
+  Border2 b2= t2set.getProposedBorder();
+  Border2 b(b1, b2);
+  
+  Vector<int> mask2;
+  mask2.resize(t2set.size());
+  mask2= 1;
+  
+  // the thresholds are updated for each multiplier from the thresholds of the feature file
+  float minTh2= initializeStage1Operators(ctx, t2set, imageScale, 1, 1, mask2);
+  Vector<float> th1base, th2base;
+  operatorThresholds(t2set, th1base, th2base);
+  
+  Border2 originalBorder= input.getBorder2();
+  
+  b.borderMode= BORDER_MODE_MIRRORED;
+  input.resizeBorder(b);
+  b.borderMode= BORDER_MODE_ZERO;
+  roi.resizeBorder(b);
+  support.resizeBorder(b);
+  
+  Image<unsigned char> reducedROI;
+  reducedROI= roi;
+  
+  Vector<Vector<int> > groups;
+  groupOperatorsByFilterBank(t2set, groups, mask2, mask);
+  tprintf("distinct filter banks: %d\n", groups.size());
+  
+  if ( ctx.pyramidinit == 0 && groups.size() > 0 )
+    buildPyramid(ctx, input, reducedROI, support, operatorScale(t2set(groups(0)(0))), usepyramid);
+  
+  // the responses over the memory budget are recomputed once per wave of multipliers
+  QuantizedImageCache responses;
+  responses.resize(groups.size());
+  responses.setBudget((long long)(vesselwsobudget)*1024*1024, 0);
+  
+  #pragma omp parallel for schedule(dynamic, 1)
+  for ( unsigned int g= 0; g < groups.size(); ++g )
   {
-      if ( roi.isRealImagePixel(i) && output(i) && Region2::isInnerContour4(output, i) )
+    Image<float> result2(input);
+    int owner= groups(g)(0);
+    applyFilterResponse(ctx, owner, input, reducedROI, support, result2, b, dynamic_cast<PowerGaborRGLineSegmentTransform2<float,float>*>(t2set(owner)), dynamic_cast<PowerGaborSimpleRGLineSegmentTransform2<float,float>*>(t2set(owner)), 1, usepyramid);
+    responses.put(g, result2, &roi);
+  }
+  
+  Vector<int> spilled;
+  for ( unsigned int g= 0; g < groups.size(); ++g )
+    if ( !responses.contains(g) )
+      spilled.push_back(g);
+  tprintf("responses held: %d/%d, %lld bytes\n", groups.size() - spilled.size(), groups.size(), responses.used);
+  
+  Vector<Image<unsigned char> > outputs(multipliers.size());
+  Vector<float> distances(multipliers.size());
+  distances= FLT_MAX;
+  
+  // the multipliers past the stopping point of a wave are wasted work, the wave is capped by
+  // vesselsweepwave; with spilled responses every wave recomputes them once
+  unsigned int wave= std::max(1, std::min(omp_get_max_threads(), vesselsweepwave));
+  
+  unsigned int evaluated= 0;
+  int stop= 0;
+  while ( evaluated < multipliers.size() && !stop )
+  {
+    unsigned int last= std::min(evaluated + wave, (unsigned int)(multipliers.size()));
+    
+    Vector<Vector<float> > th1s(last - evaluated), th2s(last - evaluated);
+    Vector<Image<int> > votes(last - evaluated);
+    for ( unsigned int i= evaluated; i < last; ++i )
+    {
+      th1s(i - evaluated)= th1base;
+      th2s(i - evaluated)= th2base;
+      for ( unsigned int j= 0; j < t2set.size(); ++j )
+        updateThresholds(th1s(i - evaluated)(j), th2s(i - evaluated)(j), minTh2, multipliers(i), multipliers(i));
+      votes(i - evaluated).resizeImage(input);
+      votes(i - evaluated)= 0;
+    }
+    
+    // the held responses are decoded by each multiplier on its own
+    #pragma omp parallel for schedule(dynamic, 1)
+    for ( unsigned int i= evaluated; i < last; ++i )
+    {
+      Image<float> result2(input);
+      Vector<int> pixels;
+      for ( unsigned int g= 0; g < groups.size(); ++g )
       {
-	float ri= calculateRI(output, input, i);
-	float width= calculateWidth(output, input, i);
-	rii.push_back(ri);
-	riw+= width;
+        if ( responses.get(g, result2, &roi) )
+          continue;
+        
+        pixels.clear();
+        voteStage1Group(ctx, groups(g), th1s(i - evaluated), th2s(i - evaluated), input, result2, roi, pixels);
+        for ( unsigned int k= 0; k < pixels.size(); ++k )
+          votes(i - evaluated)(pixels(k))++;
       }
+    }
+    
+    // the spilled responses are computed once and voted on by all the multipliers of the wave
+    Image<float> spilledResponse(input);
+    for ( unsigned int s= 0; s < spilled.size(); ++s )
+    {
+      int g= spilled(s);
+      int owner= groups(g)(0);
+      applyFilterResponse(ctx, owner, input, reducedROI, support, spilledResponse, b, dynamic_cast<PowerGaborRGLineSegmentTransform2<float,float>*>(t2set(owner)), dynamic_cast<PowerGaborSimpleRGLineSegmentTransform2<float,float>*>(t2set(owner)), 1, usepyramid);
       
-      if ( roi.isRealImagePixel(i) && !output(i) && Region2::isOuterContour4(output, i) )
+      #pragma omp parallel for schedule(dynamic, 1)
+      for ( unsigned int i= evaluated; i < last; ++i )
       {
-	float ri= calculateRI(output, input, i);
-	float width= calculateWidth(output, input, i);
-	rio.push_back(ri);
-	row+= width;
+        Vector<int> pixels;
+        voteStage1Group(ctx, groups(g), th1s(i - evaluated), th2s(i - evaluated), input, spilledResponse, roi, pixels);
+        for ( unsigned int k= 0; k < pixels.size(); ++k )
+          votes(i - evaluated)(pixels(k))++;
       }
+    }
+    
+    #pragma omp parallel for schedule(dynamic, 1)
+    for ( unsigned int i= evaluated; i < last; ++i )
+    {
+      outputs(i).resizeImage(input);
+      for ( unsigned int k= 0; k < votes(i - evaluated).n; ++k )
+        outputs(i)(k)= votes(i - evaluated)(k) > 0 ? 255 : 0;
+      
+      distances(i)= fabs(relativeIntensityDistance(outputs(i), input, roi));
+    }
+    
+    // the stopping rule is checked multiplier by multiplier, the multipliers of the wave past the
+    // stopping point are dropped, as a serial sweep would not have evaluated them
+    for ( unsigned int i= evaluated; i < last && !stop; ++i )
+    {
+      tprintf("multiplier: %f, distance: %f\n", multipliers(i), distances(i));
+      evaluated= i + 1;
+      if ( i >= 2 && distances(i) > distances(i-1) && distances(i-1) > distances(i-2) )
+        stop= 1;
+    }
   }
   
-  tprintf("ri: %f %f %f %f\n", rii.getMean(), rio.getMean(), (rii.getMean() + rio.getMean())/2, fabs(rii.getMean() - rio.getMean()));
+  int best= 0;
+  for ( unsigned int i= 1; i < evaluated; ++i )
+    if ( distances(i) < distances(best) )
+      best= i;
+  tprintf("multipliers evaluated: %d/%d, best: %f\n", evaluated, multipliers.size(), multipliers(best));
   
-  if ( dist != NULL )
-    *dist= 1 - fabs(rii.getMean() - rio.getMean());
-    //*dist= fabs(0.5 - fabs(rii.getMean() + rio.getMean())/2);
+  bestMultiplier= multipliers(best);
+  output= outputs(best);
   
   input.resizeBorder(originalBorder);
   support.resizeBorder(originalBorder);
@@ -965,11 +1362,14 @@ int vstage1Function(char* featureFile, Image<float>& input, Image<unsigned char>
 Vector<int> opmask;
 int opmaskinit= 0;
 
-int vstage1unknown2Function(char* featureFile, Image<float>& input, Image<unsigned char>& roi, Image<unsigned char>& support, Image<unsigned char>& output, int thresholdStart, float th1mult, float th2mult, float imageScale, int caching= 1, float* res= NULL, float* res2= NULL, float* res3= NULL, float* res4= NULL)
+int vstage1unknown2Function(VesselContext& ctx, char* featureFile, Image<float>& input, Image<unsigned char>& roi, Image<unsigned char>& support, Image<unsigned char>& output, int thresholdStart, float th1mult, float th2mult, float imageScale, int caching= 1, float* res= NULL, float* res2= NULL, float* res3= NULL, float* res4= NULL, Transform2Set<float, float>* t2setp= NULL)
 {
+  ProfilerScope span("stage", "stage1 unknown");
+  span.arg("scale", imageScale);
   tprintf("vessel segmentation stage1, features: %s, thresholdStart: %d, scale: %f, caching: %d, thmult1: %f, thmult2: %f\n", featureFile, thresholdStart, imageScale, caching, th1mult, th2mult);
 
-  Transform2Set<float, float>& t2set= *(generateTransform2Set<float, float>(std::string(featureFile), std::string("feature")));
+  // the set of the scale search is reused if given, otherwise it is parsed from the feature file
+  Transform2Set<float, float>& t2set= t2setp ? *t2setp : *(generateTransform2Set<float, float>(std::string(featureFile), std::string("feature")));
   
   tprintf("t2set.size(): %d\n", t2set.size());
   
@@ -977,11 +1377,14 @@ int vstage1unknown2Function(char* featureFile, Image<float>& input, Image<unsign
   mask.resize(t2set.size());
   mask= 1;
 
-  if ( opmaskinit == 0 )
+  #pragma omp critical (opmask)
   {
-    opmask.resize(t2set.size());
-    opmask= 1;
-    opmaskinit= 1;
+    if ( opmaskinit == 0 )
+    {
+      opmask.resize(t2set.size());
+      opmask= 1;
+      opmaskinit= 1;
+    }
   }
   
   Vector<int> maskcached;
@@ -1012,8 +1415,8 @@ int vstage1unknown2Function(char* featureFile, Image<float>& input, Image<unsign
   
   float maxwavelength= 0;
 
-  maxpccinit= 0;
-  maxPCC.resize(t2set.size());
+  ctx.maxpccinit= 0;
+  ctx.maxPCC.resize(t2set.size());
   for ( unsigned int i= 0; i < t2set.size(); ++i )
   {
     if ( dynamic_cast<PowerGaborRGLineSegmentTransform2<float,float>*>(t2set(i)) != NULL )
@@ -1038,9 +1441,6 @@ int vstage1unknown2Function(char* featureFile, Image<float>& input, Image<unsign
     {
       PowerGaborRGLineSegmentTransform2<float,float>* tmp= dynamic_cast<PowerGaborRGLineSegmentTransform2<float,float>*>(t2set(i));
       
-      tmp->scale= 1;
-      tmp->regenerate();
-      
       if ( tmp->lambda > maxwavelength*0.8 )
       {
 	mask(i)= 1;
@@ -1057,7 +1457,7 @@ int vstage1unknown2Function(char* featureFile, Image<float>& input, Image<unsign
 	  mask(i)= maskcached(i);
 	else
 	{
-	  if ( !checkOperator(tmp, i) )
+	  if ( !checkOperator(ctx, tmp, i) )
 	  {
 	    mask(i)= 0;
 	    ++discarded;
@@ -1069,9 +1469,6 @@ int vstage1unknown2Function(char* featureFile, Image<float>& input, Image<unsign
     {
       PowerGaborSimpleRGLineSegmentTransform2<float,float>* tmp= dynamic_cast<PowerGaborSimpleRGLineSegmentTransform2<float,float>*>(t2set(i));
       
-      tmp->scale= 1;
-      tmp->regenerate();
-      
       if ( tmp->lambda > maxwavelength*0.8 )
       {
 	mask(i)= 1;
@@ -1088,7 +1485,7 @@ int vstage1unknown2Function(char* featureFile, Image<float>& input, Image<unsign
 	  mask(i)= maskcached(i);
 	else
 	{
-	  if ( !checkOperator(tmp, i) )
+	  if ( !checkOperator(ctx, tmp, i) )
 	  {
 	    mask(i)= 0;
 	    ++discarded;
@@ -1178,6 +1575,8 @@ int vstage1unknown2Function(char* featureFile, Image<float>& input, Image<unsign
       
       //lambda= tmp->lambda;
       
+      ProfilerScope span("operator", "filter and region growing");
+      span.arg("operator", j);
       tmp->applyGetFiltered(input, result, result2, &roi, &support);
     }
     else if ( dynamic_cast<PowerGaborSimpleRGLineSegmentTransform2<float,float>*>(t2set(j)) != NULL )
@@ -1186,6 +1585,8 @@ int vstage1unknown2Function(char* featureFile, Image<float>& input, Image<unsign
       
       //lambda= tmp->lambda;
       
+      ProfilerScope span("operator", "filter and region growing");
+      span.arg("operator", j);
       tmp->applyGetFiltered(input, result, result2, &roi, &support);
     }
     
@@ -1196,7 +1597,13 @@ int vstage1unknown2Function(char* featureFile, Image<float>& input, Image<unsign
       continue;
     
     rtmp= result;
-    er.apply(rtmp, regions);
+    {
+      ProfilerScope span("operator", "labeling");
+      er.apply(rtmp, regions);
+      span.arg("operator", j);
+      span.arg("regions", regions.size());
+    }
+    profiler.count("regions found", regions.size());
     
     Vector<float> circularities;
     for ( unsigned int i= 0; i < regions.size(); ++i )
@@ -1246,21 +1653,21 @@ int vstage1unknown2Function(char* featureFile, Image<float>& input, Image<unsign
   Vector<float> wis;
   Vector<float> wos;
   Vector<float> wall;
+  Vector<int> contour;
   for ( unsigned int i= 0; i < output.n; ++i )
+    if ( Region2::isInnerContour8(output, i) || Region2::isOuterContour8(output, i) )
+      contour.push_back(i);
+  
+  EqualSlopeAtBoundaries<float> esab(3, 87, 0.4, 1);
+  esab.updateStride(output.columns);
+  esab.swidthc(output, contour, wall);
+  
+  for ( unsigned int i= 0; i < contour.size(); ++i )
   {
-      if ( Region2::isInnerContour8(output, i) )
-      {
-	float wi= calculateWidth(output, input, i);
-	wis.push_back(wi);
-	wall.push_back(wi);
-      }
-      
-      if ( Region2::isOuterContour8(output, i) )
-      {
-	float wo= calculateWidth(output, input, i);
-	wos.push_back(wo);
-	wall.push_back(wo);
-      }
+      if ( output(contour(i)) )
+	wis.push_back(wall(i));
+      else
+	wos.push_back(wall(i));
   }
 
   tprintf("inner widths: %f %f %f outer widths: %f %f %f all widths: %f %f %f opwidths: %f %f %f detected: %d\n", wis.getMean(), wis.getMedian(), wis.getStandardDeviation(), wos.getMean(), wos.getMedian(), wos.getStandardDeviation(), wall.getMean(), wall.getMedian(), wall.getStandardDeviation(), opwidths.getMean(), opwidths.getMedian(), opwidths.getStandardDeviation(), lwdetected);
@@ -1272,15 +1679,59 @@ int vstage1unknown2Function(char* featureFile, Image<float>& input, Image<unsign
 
   tprintf("thresholding finished\n");
   
+  if ( t2setp == NULL )
+    deleteTransform2Set(&t2set);
+  
   return 0;
 }
 
+// operators of the feature file at an image scale of the scale search, generated once per scale
+Transform2Set<float, float>* scaledOperators(std::map<float, Transform2Set<float, float>*>& cache, char* featureFile, float imageScale)
+{
+  Transform2Set<float, float>* t2set= NULL;
+  #pragma omp critical (scaledOperators)
+  {
+    if ( cache.find(imageScale) == cache.end() )
+      cache[imageScale]= generateTransform2Set<float, float>(std::string(featureFile), std::string("feature"));
+    t2set= cache[imageScale];
+  }
+  return t2set;
+}
+
+// evaluates vstage1unknown2Function at the scales concurrently, each evaluation works on its own
+// context and copies of the images
+void evaluateScales(std::map<float, Transform2Set<float, float>*>& cache, char* featureFile, Image<float>& input, Image<unsigned char>& roi, Image<unsigned char>& support, int thresholdStart, float th1mult, float th2mult, Vector<float>& scales, Vector<float>& res2s, Vector<float>& res4s, Vector<Image<unsigned char> >* outputs= NULL)
+{
+  res2s.resize(scales.size());
+  res4s.resize(scales.size());
+  if ( outputs )
+    outputs->resize(scales.size());
+  
+  #pragma omp parallel for schedule(dynamic, 1)
+  for ( unsigned int i= 0; i < scales.size(); ++i )
+  {
+    VesselContext ctx;
+    Image<float> in(input);
+    Image<unsigned char> ro(roi), su(support), out;
+    float res, res2, res3, res4;
+    
+    vstage1unknown2Function(ctx, featureFile, in, ro, su, out, thresholdStart, th1mult, th2mult, scales(i), 0, &res, &res2, &res3, &res4, scaledOperators(cache, featureFile, scales(i)));
+    tprintf("MEANCORR: %f, DETECTED: %f, SCALE2(IS2): %f\n", res4, res2, scales(i));
+    
+    res2s(i)= res2;
+    res4s(i)= res4;
+    if ( outputs )
+      (*outputs)(i)= out;
+  }
+}
+
 int vstage1Function(int , char** argv, int thStart, float th1mult, float th2mult, float imageScale)
 {
   tprintf("fdf: %s\ninput: %s\nroi: %s\nsupport: %s\noutput:%s, th1mult: %f, th2mult: %f\n", argv[1], argv[2], argv[3], argv[4], argv[5], th1mult, th2mult);
   
   Image<float> input, inputOriginal;
   Image<unsigned char> roi, support, output, original;
+  VesselContext ctx;
   int usepyramid= 0;
   Border2 b(75, 75, 75, 75, BORDER_MODE_ZERO);
   
@@ -1309,7 +1760,7 @@ int vstage1Function(int , char** argv, int thStart, float th1mult, float th2mult
   
   if ( unknown == 0 )
   {
-    vstage1Function(argv[1], input, roi, support, output, thStart, th1mult, th2mult, imageScale, 0, -1, NULL, NULL, NULL, usepyramid);
+    vstage1Function(ctx, argv[1], input, roi, support, output, thStart, th1mult, th2mult, imageScale, 0, -1, NULL, NULL, NULL, usepyramid);
   }
   else if ( unknown == 1 )
   {
@@ -1351,61 +1802,110 @@ int vstage1Function(int , char** argv, int thStart, float th1mult, float th2mult
       support= supportscaled;
     }
     
-    float maxCorr= 0;
     float bestScale= 0;
     
-    float res, res2, res3, res4, is= start;
-    while ( 1 )
+    // the operators are generated once per scale and shared by the evaluations
+    std::map<float, Transform2Set<float, float>*> operators;
+    
+    // the smallest scale with a non-empty output, the candidates are evaluated in waves of one scale per thread
+    float is= start;
+    int found= -1;
+    while ( found < 0 )
     {
-      vstage1unknown2Function(argv[1], input, roi, support, output, thStart, th1mult, th2mult, is, 0, &res, &res2, &res3, &res4);
-      if ( output.numberOfNonZeroElements() > output.n*0.0001 )
-	break;
-      is*= 1.1;
+      Vector<float> scales, res2s, res4s;
+      Vector<Image<unsigned char> > outputs;
+      for ( int k= 0; k < omp_get_max_threads(); ++k, is*= 1.1 )
+        scales.push_back(is);
+      
+      evaluateScales(operators, argv[1], input, roi, support, thStart, th1mult, th2mult, scales, res2s, res4s, &outputs);
+      
+      for ( unsigned int k= 0; k < scales.size() && found < 0; ++k )
+        if ( outputs(k).numberOfNonZeroElements() > outputs(k).n*0.0001 )
+        {
+          found= k;
+          start= scales(k);
+          output= outputs(k);
+        }
     }
-    start= is;
     
     Image<unsigned char> mask;
     mask.resizeImage(output);
     mask= 0;
 
-    StructuringElementDisk sed(input.columns/50);
+    // the width of the bordered image
+    StructuringElementDisk sed(output.columns/50);
     sed.updateStride(mask.columns);
     grayscaleDilate(&output, &mask, sed);
     
     //writeImage("base.bmp", output);
     //writeImage("dilated.bmp", mask);
     
-    Vector<float> nums1;
-    Vector<float> nums2;
-    Vector<float> bs;
-    Image<unsigned char> fakeoutput;
-    fakeoutput.resizeImage(output);
-      
+    // coarse-to-fine search on the grid of the scales: every second scale is evaluated first, then the
+    // neighbors of the best one
+    Vector<float> grid;
     for ( float is2= start; is2 <= end; is2*= step )
+      grid.push_back(is2);
+    
+    Vector<int> evaluated(grid.size(), 0);
+    Vector<float> nums1(grid.size(), 0);
+    Vector<float> nums2(grid.size(), 0);
+    
+    for ( int level= 0; level < 2; ++level )
     {
-      vstage1unknown2Function(argv[1], input, mask, support, fakeoutput, thStart, th1mult, th2mult, is2, 0, &res, &res2, &res3, &res4);
-      tprintf("MEANCORR: %f, SCALE2(IS2): %f, ROIRATIO: %f, IMGSCALE: %f\n", res4, is2, roiratio, imageScale);
-      nums1.push_back(res2);
-      nums2.push_back(res4);
-      bs.push_back(is2);
-      if ( res2 > maxCorr )
+      Vector<int> indices;
+      if ( level == 0 )
       {
-	maxCorr= res2;
-	bestScale= is2;
+        for ( unsigned int i= 0; i < grid.size(); i+= 2 )
+          indices.push_back(i);
+        if ( grid.size() > 1 && (grid.size() - 1) % 2 )
+          indices.push_back(grid.size() - 1);
+      }
+      else
+      {
+        int c= -1;
+        for ( unsigned int i= 0; i < grid.size(); ++i )
+          if ( evaluated(i) && (c == -1 || nums1(i) > nums1(c) || (nums1(i) == nums1(c) && nums2(i) > nums2(c))) )
+            c= i;
+        if ( c > 0 && !evaluated(c - 1) )
+          indices.push_back(c - 1);
+        if ( c >= 0 && c + 1 < int(grid.size()) && !evaluated(c + 1) )
+          indices.push_back(c + 1);
+      }
+      
+      Vector<float> scales, res2s, res4s;
+      for ( unsigned int k= 0; k < indices.size(); ++k )
+        scales.push_back(grid(indices(k)));
+      
+      evaluateScales(operators, argv[1], input, mask, support, thStart, th1mult, th2mult, scales, res2s, res4s);
+      
+      for ( unsigned int k= 0; k < indices.size(); ++k )
+      {
+        evaluated(indices(k))= 1;
+        nums1(indices(k))= res2s(k);
+        nums2(indices(k))= res4s(k);
       }
     }
     
+    tprintf("scales evaluated: %d/%d\n", evaluated.numberOfNonZeroElements(), grid.size());
+    
+    for ( std::map<float, Transform2Set<float, float>*>::iterator it= operators.begin(); it != operators.end(); ++it )
+      deleteTransform2Set(it->second);
+    
     Vector<float> rres;
     
     int bestIdx= -1;
     bestScale= -1;
     
-    for ( unsigned int i= 0; i < nums1.size(); ++i )
-      if ( nums1(i) == nums1.getMax() && (bestIdx == -1 || nums2(bestIdx) < nums2(i)) )
+    float maxNum1= -FLT_MAX;
+    for ( unsigned int i= 0; i < grid.size(); ++i )
+      if ( evaluated(i) && nums1(i) > maxNum1 )
+        maxNum1= nums1(i);
+    for ( unsigned int i= 0; i < grid.size(); ++i )
+      if ( evaluated(i) && nums1(i) == maxNum1 && (bestIdx == -1 || nums2(bestIdx) < nums2(i)) )
 	bestIdx= i;
-    for ( unsigned int i= 0; i < nums2.size(); ++i )
-      if ( nums2(i) == nums2(bestIdx) )
-	rres.push_back(bs(i));
+    for ( unsigned int i= 0; i < grid.size(); ++i )
+      if ( evaluated(i) && nums2(i) == nums2(bestIdx) )
+	rres.push_back(grid(i));
     bestScale= rres.getGMean();
 
     if ( roiratio < 0.5 || roiratio > 2 )
@@ -1418,7 +1918,7 @@ int vstage1Function(int , char** argv, int thStart, float th1mult, float th2mult
   
   else if ( unknown == 2 )
   {
-    float res, step= 0.025, mult= 0.75;
+    float step= 0.025, mult= 0.75;
     int iter= 0;
     
     if ( input.columns > 1000 )
@@ -1428,27 +1928,14 @@ int vstage1Function(int , char** argv, int thStart, float th1mult, float th2mult
     mask.resize(384);
     mask= 1;
     
-    float mind= FLT_MAX, minm= 1;
+    float minm= 1;
 
     tprintf("%d %d %d %d\n", input.columns, roi.columns, support.columns, output.columns);
     
-    Image<unsigned char> originalROI;
-    originalROI= roi;
-    
+    Vector<float> multipliers;
     while ( 1 )
     {
-      roi= originalROI;
-      vstage1Function(argv[1], input, roi, support, output, thStart, mult, mult, imageScale, 1, -1, NULL, &res, &mask, usepyramid);
-      
-      float tmp= fabs(res);
-      tprintf("distance: %f %f\n", res, tmp);
-      
-      if ( tmp < mind )
-      {
-	mind= tmp;
-	minm= mult;
-      }
-      
+      multipliers.push_back(mult);
       ++iter;
       
       mult+= step;
@@ -1456,9 +1943,10 @@ int vstage1Function(int , char** argv, int thStart, float th1mult, float th2mult
 	break;
     }
     
-    tprintf("%d %d %d %d\n", input.columns, roi.columns, support.columns, output.columns);
+    // the filter responses are computed once for all the multipliers
+    vstage1SweepFunction(ctx, argv[1], input, roi, support, output, multipliers, imageScale, minm, &mask, usepyramid);
     
-    vstage1Function(argv[1], input, roi, support, output, thStart, minm, minm, imageScale, 1, -1, NULL, &res, &mask, usepyramid);
+    tprintf("%d %d %d %d\n", input.columns, roi.columns, support.columns, output.columns);
     
     ofstream outputfile;
     outputfile.open("multiplier.txt");
@@ -1473,6 +1961,7 @@ int vstage1Function(int , char** argv, int thStart, float th1mult, float th2mult
 
 int vstage2Function(Image<float>& input, Image<unsigned char>& seed, Image<unsigned char>& roi, int maxit, float nw, char* relativeIntensities, float widthScaling, Image<unsigned char>& output)
 {
+  ProfilerScope span("stage", "stage2");
   tprintf("stage2: correction of edge borders, unknown: %d, ws: %f\n", unknown, widthScaling);
 
   Border2 originalBorder= input.getBorder2();
@@ -1571,8 +2060,49 @@ int vstage2Function(int , char** argv, int maxit, float nw, char* relativeIntens
   return 0;
 }
 
-int vstage4bFunction(Image<float>& input, Image<unsigned char>& seed, Image<unsigned char>& roi, Image<unsigned char>& support, float mp, float ap, float /*fp*/, float /*cp*/, int sizeth0, int sizeth1, float widthScaling, Image<unsigned char>& output, int usepyramid= 0, char* featurefile= NULL)
+// returns the distance of the farest pixels of a region, the farest pixels are extremal in their rows
+float distanceOfFarestPixels(Vector<int>& pixels, int stride)
+{
+  int minRow= INT_MAX, maxRow= -1;
+  for ( unsigned int i= 0; i < pixels.size(); ++i )
+  {
+    minRow= std::min(minRow, pixels(i)/stride);
+    maxRow= std::max(maxRow, pixels(i)/stride);
+  }
+  
+  Vector<int> left(maxRow - minRow + 1, INT_MAX), right(maxRow - minRow + 1, -1);
+  for ( unsigned int i= 0; i < pixels.size(); ++i )
+  {
+    int r= pixels(i)/stride - minRow;
+    left(r)= std::min(left(r), pixels(i)%stride);
+    right(r)= std::max(right(r), pixels(i)%stride);
+  }
+  
+  Vector<int> rows, columns;
+  for ( unsigned int r= 0; r < left.size(); ++r )
+    if ( right(r) >= 0 )
+    {
+      rows.push_back(r);
+      columns.push_back(left(r));
+      rows.push_back(r);
+      columns.push_back(right(r));
+    }
+  
+  int maxDist= 0;
+  for ( unsigned int i= 0; i < rows.size(); ++i )
+    for ( unsigned int j= i+1; j < rows.size(); ++j )
+    {
+      int dist= (rows(i)-rows(j))*(rows(i)-rows(j)) + (columns(i)-columns(j))*(columns(i)-columns(j));
+      if ( dist > maxDist )
+	maxDist= dist;
+    }
+  
+  return sqrt(float(maxDist));
+}
+
+int vstage4bFunction(VesselContext& ctx, Image<float>& input, Image<unsigned char>& seed, Image<unsigned char>& roi, Image<unsigned char>& support, float mp, float ap, float /*fp*/, float /*cp*/, int sizeth0, int sizeth1, float widthScaling, Image<unsigned char>& output, int usepyramid= 0, char* featurefile= NULL, Transform2Set<float, float>* t2setp= NULL)
 {
+  ProfilerScope span("stage", "stage4");
   tprintf("stage4: addition of thin objects %f %f %d\n", mp, ap, usepyramid);
   tprintf("th1mult: %f, th2mult: %f\n", vstage1th1multiplier, vstage1th2multiplier);
   
@@ -1587,7 +2117,7 @@ int vstage4bFunction(Image<float>& input, Image<unsigned char>& seed, Image<unsi
   
   tprintf("dimensions: %d %d, %d %d, %d %d, %d %d, %d %d\n", input.rows, input.columns, seed.rows, seed.columns, roi.rows, roi.columns, support.rows, support.columns, output.rows, output.columns);
   
-  Transform2Set<float, float>& t2set= *(generateTransform2Set<float, float>(std::string(featurefile), std::string("feature")));
+  Transform2Set<float, float>& t2set= t2setp ? *t2setp : *(generateTransform2Set<float, float>(std::string(featurefile), std::string("feature")));
   
   tprintf("t2set.size(): %d\n", t2set.size());
   
@@ -1599,35 +2129,40 @@ int vstage4bFunction(Image<float>& input, Image<unsigned char>& seed, Image<unsi
   
   Vector<int> mask2;
   mask2.resize(t2set.size());
-  wsocacheinit= 1;
-  wsocache.resize(t2set.size());
-  pyramidinit= 0;
+  ctx.wsocacheinit= 1;
+  ctx.wsocache.resize(t2set.size());
+  ctx.wsocache.setBudget((long long)(vesselwsobudget)*1024*1024, vesselwsoquantize);
+  ctx.pyramidinit= 0;
   mask2= 1;
-  if ( maskinit == 0 )
-    maskcache.resize(t2set.size());
+  if ( ctx.maskinit == 0 )
+    ctx.maskcache.resize(t2set.size());
   
   float minTh2= FLT_MAX;
   
   char fname[100];
   sprintf(fname, "maxPCC-%f.txt", widthScaling);
   FILE* fmc= NULL;
-  fmc= fopen(fname, "r");
-  if ( fmc != NULL )
+  // the file is shared by the images processed concurrently
+  #pragma omp critical (maxPCCFile)
   {
-    maxPCC.resize(t2set.size());
-    maxpccinit= 1;
-    float flag;
-    for ( unsigned int i= 0; i < maxPCC.size(); ++i )
+    fmc= fopen(fname, "r");
+    if ( fmc != NULL )
     {
-      int rv= fscanf(fmc, "%f", &flag);
-      if ( rv != 1 )
-	break;
-      maxPCC(i)= flag;
+      ctx.maxPCC.resize(t2set.size());
+      ctx.maxpccinit= 1;
+      float flag;
+      for ( unsigned int i= 0; i < ctx.maxPCC.size(); ++i )
+      {
+        int rv= fscanf(fmc, "%f", &flag);
+        if ( rv != 1 )
+	  break;
+        ctx.maxPCC(i)= flag;
+      }
+      fclose(fmc);
     }
-    fclose(fmc);
+    else
+      ctx.maxPCC.resize(t2set.size());
   }
-  else
-    maxPCC.resize(t2set.size());
   
   for ( unsigned int i= 0; i < t2set.size(); ++i )
   {
@@ -1666,7 +2201,7 @@ int vstage4bFunction(Image<float>& input, Image<unsigned char>& seed, Image<unsi
 	  if ( !roc )
 	  {
 	    if ( tmp->mgf->operator[](0)->size() < 100 )
-	      mask2(i)= checkOperator(tmp, i);
+	      mask2(i)= checkOperator(ctx, tmp, i);
 	  }
 	}
       }
@@ -1690,7 +2225,7 @@ int vstage4bFunction(Image<float>& input, Image<unsigned char>& seed, Image<unsi
 	  if ( !roc )
 	  {
 	    if ( tmp->mgf->operator[](0)->size() < 100 )
-	      mask2(i)= checkOperator(tmp, i);
+	      mask2(i)= checkOperator(ctx, tmp, i);
 	  }
 	}
       }
@@ -1703,19 +2238,23 @@ int vstage4bFunction(Image<float>& input, Image<unsigned char>& seed, Image<unsi
   }
   
   tprintf("features generated\n");
-  maxpccinit= 1;
+  ctx.maxpccinit= 1;
   
-  fmc= fopen(fname, "r");
-  if ( fmc == NULL )
-  {
-    fmc= fopen(fname, "w");
-    for ( unsigned int i= 0; i < maxPCC.size(); ++i )
-      fprintf(fmc, "%f\n", maxPCC(i));
-    fclose(fmc);
-  }
-  else
+  // the file is shared by the images processed concurrently
+  #pragma omp critical (maxPCCFile)
   {
-    fclose(fmc);
+    fmc= fopen(fname, "r");
+    if ( fmc == NULL )
+    {
+      fmc= fopen(fname, "w");
+      for ( unsigned int i= 0; i < ctx.maxPCC.size(); ++i )
+        fprintf(fmc, "%f\n", ctx.maxPCC(i));
+      fclose(fmc);
+    }
+    else
+    {
+      fclose(fmc);
+    }
   }
   
   tprintf("size of t2set after scaling: %d\n", mask2.numberOfNonZeroElements());
@@ -1748,40 +2287,54 @@ int vstage4bFunction(Image<float>& input, Image<unsigned char>& seed, Image<unsi
   reducedROI= roi;
   tprintf("roi size: %d\n", roi.numberOfNonZeroElements());
   
+  for ( unsigned int j= 0; j < t2set.size() && ctx.pyramidinit == 0; ++j )
+    if ( mask2(j) )
+      buildPyramid(ctx, input, reducedROI, support, operatorScale(t2set(j)), usepyramid);
+  
   tprintf("starting applying the transforms\n");
   int completed= 0;
   
-  #pragma omp parallel for schedule(dynamic, 2)
-  for ( unsigned int j= 0; j < t2set.size(); ++j )
+  // the operators are processed in batches, the positive responses of a batch are collected into per operator
+  // lists and added to outputTmp by a parallel reduction in the order of the operators, thus the float
+  // sums do not depend on the number of threads
+  unsigned int batch= 2*omp_get_max_threads();
+  for ( unsigned int first= 0; first < t2set.size(); first+= batch )
   {
-    if ( !mask2(j) )
-    {
-      completed++;
-      continue;
-    }
-    
-    int threadnum= omp_get_thread_num();
-    if ( threadnum == 0 )
-      tprintf("completed/total: %d/%zd\n", completed, t2set.size());
-    
-    Image<float> result(input), result2(input);
-    Image<unsigned char> rtmp;
-    rtmp.resizeImage(input);
-    
-    if ( dynamic_cast<PowerGaborRGLineSegmentTransform2<float, float>*>(t2set(j)) != NULL )
-      applyFilter(j, input, reducedROI, support, result, result2, b, dynamic_cast<PowerGaborRGLineSegmentTransform2<float,float>*>(t2set(j)), NULL, 0, usepyramid);
-    else if ( dynamic_cast<PowerGaborSimpleRGLineSegmentTransform2<float,float>*>(t2set(j)) != NULL )
-      applyFilter(j, input, reducedROI, support, result, result2, b, NULL, dynamic_cast<PowerGaborSimpleRGLineSegmentTransform2<float,float>*>(t2set(j)), 0, usepyramid);
+    unsigned int last= std::min(first + batch, (unsigned int)(t2set.size()));
+    Vector<VoteList> votes(last - first);
     
-    #pragma omp critical
+    #pragma omp parallel for schedule(dynamic, 1)
+    for ( unsigned int j= first; j < last; ++j )
     {
+      #pragma omp atomic
+      completed++;
+      
+      if ( !mask2(j) )
+	continue;
+      
+      int threadnum= omp_get_thread_num();
+      if ( threadnum == 0 )
+	tprintf("completed/total: %d/%zd\n", completed, t2set.size());
+      
+      Image<float> result(input), result2(input);
+      Image<unsigned char> rtmp;
+      rtmp.resizeImage(input);
+      
+      if ( dynamic_cast<PowerGaborRGLineSegmentTransform2<float, float>*>(t2set(j)) != NULL )
+	applyFilter(ctx, j, input, reducedROI, support, result, result2, b, dynamic_cast<PowerGaborRGLineSegmentTransform2<float,float>*>(t2set(j)), NULL, 0, usepyramid);
+      else if ( dynamic_cast<PowerGaborSimpleRGLineSegmentTransform2<float,float>*>(t2set(j)) != NULL )
+	applyFilter(ctx, j, input, reducedROI, support, result, result2, b, NULL, dynamic_cast<PowerGaborSimpleRGLineSegmentTransform2<float,float>*>(t2set(j)), 0, usepyramid);
+      
+      VoteList& v= votes(j - first);
       for ( unsigned int i= 0; i < result2.n; ++i )
 	if ( result2(i) > 0 )
 	{
-	  outputTmp(i)+= result2(i);
-	  outputNum(i)+= 1.0;
+	  v.pixels.push_back(i);
+	  v.values.push_back(result2(i));
 	}
     }
+    
+    reduceVotes(votes, outputTmp, &outputNum);
   }
 
   for ( unsigned int i= 0; i < outputTmp.n; ++i )
@@ -1790,68 +2343,90 @@ int vstage4bFunction(Image<float>& input, Image<unsigned char>& seed, Image<unsi
     else
       outputTmp(i)= 0;
   
-  Image<unsigned char> tmpb;
-  tmpb.resizeImage(outputTmp);
-  int regionsAdded= 0;
-  
+  // the components of the thresholded images at all levels are the nodes of the max-tree of the
+  // response quantized by the thresholds, each node is evaluated once
+  Vector<float> thresholds;
   for ( float threshold= 0.45; threshold <= 1; threshold+= 0.01 )
+    thresholds.push_back(threshold);
+  
+  Image<unsigned char> levels;
+  levels.resizeImage(outputTmp);
+  for ( unsigned int i= 0; i < outputTmp.n; ++i )
+    levels(i)= std::lower_bound(thresholds.begin(), thresholds.end(), outputTmp(i)) - thresholds.begin();
+  
+  tprintf("building max-tree of %zd levels\n", thresholds.size());
+  MaxTree tree;
+  {
+    ProfilerScope treeSpan("step", "max-tree");
+    tree.build(levels, thresholds.size() + 1);
+  }
+  
+  Vector<int> sizes(outputTmp.n, 0);
+  Vector<int> nonSeed(outputTmp.n, 0);
+  Vector<double> sums(outputTmp.n, 0);
+  Vector<int> nodes;
+  for ( unsigned int k= 0; k < tree.order.size(); ++k )
   {
-    tprintf("thresholding at %f\n", threshold); fflush(stdout);
-    for ( unsigned int i= 0; i < outputTmp.n; ++i )
+    int p= tree.order(k);
+    sizes(p)= 1;
+    if ( !seed(p) )
     {
-      if ( outputTmp(i) > threshold )
-	tmpb(i)= 255;
-      else
-	tmpb(i)= 0;
+      nonSeed(p)= 1;
+      sums(p)= outputTmp(p);
     }
-      
-    Region2Set regions, regions2;
-    ExtractRegions er;
+    if ( tree.isCanonical(p) )
+      nodes.push_back(p);
+  }
+  tree.accumulate(sizes);
+  tree.accumulate(nonSeed);
+  tree.accumulate(sums);
+  tprintf("number of components: %zd\n", nodes.size());
+  
+  Vector<unsigned char> accepted(outputTmp.n, 0);
+  int regionsAdded= 0;
+  
+  ProfilerScope componentSpan("step", "components");
+  componentSpan.arg("components", nodes.size());
+  
+  #pragma omp parallel for schedule(dynamic, 16)
+  for ( int k= 0; k < int(nodes.size()); ++k )
+  {
+    int p= nodes(k);
+    
+    if ( sizes(p) > 150000 )
+      continue;
+    if ( sizes(p) <= 1)
+      continue;
     
-    er.apply(tmpb, regions);
+    float regionSize= sizes(p);
     
-    #pragma omp parallel for num_threads(4), schedule(dynamic, 2)
-    for ( unsigned int i= 0; i < regions.size(); ++i )
+    if ( regionSize < sizeth0 || regionSize > sizeth1 )
+      continue;
+    
+    // the mean of a region without non-seed pixels is undefined and does not reject the region
+    if ( nonSeed(p) > 0 && sums(p)/nonSeed(p) < ap )
+      continue;
+    
+    Vector<int> pixels;
+    tree.getPixels(p, pixels);
+    float dofp= distanceOfFarestPixels(pixels, outputTmp.columns);
+    
+    if ( dofp > sizeth0 )
     {
-      if ( regions(i).size() > 150000 )
-	continue;
-      if ( regions(i).size() <= 1)
-	continue;
-      
-      Region2 tmpRegion;
-      tmpRegion.stride= tmpb.columns;
-
-      tmpRegion= regions(i);
-      
-      float regionSize= tmpRegion.size();
-      
-      if ( regionSize < sizeth0 || regionSize > sizeth1 )
-	continue;
-
-      
-      float rmean= 0;
-      int n= 0;
-      for ( unsigned int i= 0; i < tmpRegion.size(); ++i )
-	if ( !seed(tmpRegion(i)) )
-	{
-	  rmean+= outputTmp(tmpRegion(i));
-	  ++n;
-	}
-      rmean/= n;
-
-      if ( rmean < ap )
-	continue;
-      
-      float dofp= tmpRegion.getDistanceOfFarestPixels();
-
-      if ( dofp > sizeth0  )
-      {
-	#pragma omp critical
-	{
-	  tmpRegion.set(output, 0, (unsigned char)255);
-	  regionsAdded++;
-	}
-      }
+      accepted(p)= 1;
+      // the component is the same at the thresholds between the level of the parent and its own level
+      #pragma omp atomic
+      regionsAdded+= tree.level(p) - (tree.parent(p) == p ? 0 : tree.level(tree.parent(p)));
+    }
+  }
+  
+  for ( int k= int(tree.order.size()) - 1; k >= 0; --k )
+  {
+    int p= tree.order(k);
+    if ( accepted(p) || accepted(tree.parent(p)) )
+    {
+      accepted(p)= 1;
+      output(p)= 255;
     }
   }
   
@@ -1869,6 +2444,7 @@ int vstage4bFunction(Image<float>& input, Image<unsigned char>& seed, Image<unsi
 
 int vstage4Function(Image<float>& input, Image<unsigned char>& seed, Image<unsigned char>& roi, Image<unsigned char>& support, float mp, float ap, float fp, float cp, int sizeth0, int sizeth1, float widthScaling, Image<unsigned char>& output, int usepyramid= 0)
 {
+  ProfilerScope span("stage", "stage4");
   tprintf("stage4: addition of thin objects %f %f %d\n", mp, ap, usepyramid);
   tprintf("th1mult: %f, th2mult: %f\n", vstage1th1multiplier, vstage1th2multiplier);
   
@@ -1897,6 +2473,7 @@ int vstage4Function(int , char** argv, float mp, float ap, float fp, float cp, i
 {
   Image<float> input;
   Image<unsigned char> seed, roi, output, support, original, backscaled;
+  VesselContext ctx;
   
   Border2 b(71, 71, 71, 71);
   b.borderMode=BORDER_MODE_ZERO;
@@ -1947,7 +2524,7 @@ int vstage4Function(int , char** argv, float mp, float ap, float fp, float cp, i
       upperBound= 0.5;
     do
     {
-      vstage4bFunction(input, seed, roi, support, mp, ap, fp, cp, sizeth0, sizeth1, sc, output, 1, featurefile);
+      vstage4bFunction(ctx, input, seed, roi, support, mp, ap, fp, cp, sizeth0, sizeth1, sc, output, 1, featurefile);
       outputs.push_back(output);
       sc*= 1.5;
       tprintf("sc: %f\n", sc);
@@ -1990,7 +2567,7 @@ int vstage4Function(int , char** argv, float mp, float ap, float fp, float cp, i
     if ( input.rows > 1000 )
         pyramid= 1;
     
-    vstage4bFunction(input, seed, roi, support, mp, ap, fp, cp, sizeth0, sizeth1, widthScaling, output, pyramid, featurefile);
+    vstage4bFunction(ctx, input, seed, roi, support, mp, ap, fp, cp, sizeth0, sizeth1, widthScaling, output, pyramid, featurefile);
     
     for ( unsigned int i= 0; i < output.n; ++i )
       if ( output(i) )
@@ -2004,16 +2581,212 @@ int vstage4Function(int , char** argv, float mp, float ap, float fp, float cp, i
   return 0;
 }
 
+// stage 0 of the pipeline: computes the roi and the extended green channel of a color image, the support is the whole image
+int vpipelineStage0(char* filename, Image<float>& input, Image<unsigned char>& roi, Image<unsigned char>& support)
+{
+  Image<unsigned char> red, green, extended;
+  readImage(filename, red, READ_CHANNEL_RED);
+  readImage(filename, green, READ_CHANNEL_GREEN);
+  
+  vstage0FunctionROI(red, roi);
+  vstage0FunctionExtend(green, roi, extended);
+  
+  input= extended;
+  support.resizeImage(roi);
+  support= 255;
+  
+  return 0;
+}
+
+// stages 1, 2 and 4 of the pipeline on the output of stage 0, the Transform2Set is shared by stage 1 and stage 4
+int vpipelineStages(char* featurefile, Transform2Set<float, float>* t2set, Image<float>& input, Image<unsigned char>& roi, Image<unsigned char>& support, Image<unsigned char>& output, int thStart, float th1mult, float th2mult, float imageScale, int maxit, float nw, char* relativeIntensities, float widthScaling2, float mp, float ap, float fp, float cp, int sizeth0, int sizeth1, float widthScaling4)
+{
+  if ( unknown != 0 )
+    tprintf("pipeline supports only images of known scale, --unknown %d is ignored\n", unknown);
+  
+  VesselContext ctx;
+  
+  // stage 1
+  Image<float> input1;
+  Image<unsigned char> roi1, support1, stage1;
+  int usepyramid= 0;
+  input1= input;
+  roi1= roi;
+  support1= support;
+  
+  if ( input1.columns > 1000 )
+  {
+    reduceROI(input1, roi1);
+    usepyramid= 1;
+  }
+  
+  vstage1Function(ctx, featurefile, input1, roi1, support1, stage1, thStart, th1mult, th2mult, imageScale, 0, -1, NULL, NULL, NULL, usepyramid, t2set);
+  
+  // the responses cached for stage 1 are not used by the later stages
+  ctx.wsocache.clear();
+  
+  // stage 2
+  Image<float> input2;
+  Image<unsigned char> roi2, stage2;
+  input2= input;
+  roi2= roi;
+  
+  vstage2Function(input2, stage1, roi2, maxit, nw, relativeIntensities, widthScaling2, stage2);
+  
+  // stage 4
+  Border2 b(71, 71, 71, 71);
+  b.borderMode= BORDER_MODE_ZERO;
+  
+  Image<float> input4;
+  Image<unsigned char> roi4, support4, stage4;
+  input4= input;
+  output= stage2;
+  roi4= roi;
+  support4= support;
+  input4.setBorder(b);
+  output.setBorder(b);
+  roi4.setBorder(b);
+  support4.setBorder(b);
+  
+  if ( input4.columns > 1000 )
+    reduceROI(input4, roi4);
+  
+  sizeth0/= widthScaling4;
+  
+  int pyramid= 0;
+  if ( input4.rows > 1000 )
+    pyramid= 1;
+  
+  vstage4bFunction(ctx, input4, output, roi4, support4, mp, ap, fp, cp, sizeth0, sizeth1, widthScaling4, stage4, pyramid, featurefile, t2set);
+  
+  for ( unsigned int i= 0; i < stage4.n; ++i )
+    if ( stage4(i) )
+      output(i)= 255;
+  
+  output.removeBorder();
+  
+  return 0;
+}
+
+// runs stages 0, 1, 2 and 4 of the known scale flow of scripts/vessel.py in one process: the intermediate
+// images are kept in memory and the Transform2Set parsed for stage 1 is reused by stage 4
+int vpipelineFunction(int , char** argv, int thStart, float th1mult, float th2mult, float imageScale, int maxit, float nw, char* relativeIntensities, float widthScaling2, float mp, float ap, float fp, float cp, int sizeth0, int sizeth1, float widthScaling4)
+{
+  tprintf("fdf: %s\ninput: %s\noutput: %s\n", argv[1], argv[2], argv[3]);
+  
+  Image<float> input;
+  Image<unsigned char> roi, support, output;
+  
+  vpipelineStage0(argv[2], input, roi, support);
+  
+  Transform2Set<float, float>* t2set= generateTransform2Set<float, float>(std::string(argv[1]), std::string("feature"));
+  
+  vpipelineStages(argv[1], t2set, input, roi, support, output, thStart, th1mult, th2mult, imageScale, maxit, nw, relativeIntensities, widthScaling2, mp, ap, fp, cp, sizeth0, sizeth1, widthScaling4);
+  
+  tprintf("writing output image\n");
+  writeImage(argv[3], output);
+  
+  return 0;
+}
+
+// collects the images of a directory or the paths listed line by line in a text file
+void collectBatchImages(char* source, Vector<std::string>& images)
+{
+  Directory d(source);
+  if ( d.open() == 0 )
+  {
+    while ( d.hasNextFile() )
+    {
+      File f= d.nextFile();
+      std::string ext= f.getExtension();
+      std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+      if ( ext == "png" || ext == "jpg" || ext == "jpeg" || ext == "bmp" || ext == "tif" || ext == "tiff" || ext == "gif" || ext == "ppm" )
+        images.push_back(f.getAbsoluteFilename(d));
+    }
+    d.close();
+    std::sort(images.begin(), images.end());
+  }
+  else
+  {
+    ifstream list;
+    list.open(source);
+    std::string line;
+    while ( std::getline(list, line) )
+      if ( line.size() > 0 )
+        images.push_back(line);
+    list.close();
+  }
+}
+
+// segments all the images of a directory or list file with the pipeline: the model (Transform2Set, relative intensity
+// tables, maxPCC) is set up once, at most inflight images are processed concurrently, each with its own context
+int vbatchFunction(int , char** argv, int inflight, int thStart, float th1mult, float th2mult, float imageScale, int maxit, float nw, char* relativeIntensities, float widthScaling2, float mp, float ap, float fp, float cp, int sizeth0, int sizeth1, float widthScaling4)
+{
+  tprintf("fdf: %s\nimages: %s\noutput directory: %s\nin flight: %d\n", argv[1], argv[2], argv[3], inflight);
+  
+  Vector<std::string> images;
+  collectBatchImages(argv[2], images);
+  tprintf("number of images: %zd\n", images.size());
+  
+  if ( inflight < 1 )
+    inflight= 1;
+  
+  // the operators are rescaled during the stages, every image in flight gets its own set
+  Vector<Transform2Set<float, float>*> t2sets;
+  for ( int i= 0; i < inflight; ++i )
+    t2sets.push_back(generateTransform2Set<float, float>(std::string(argv[1]), std::string("feature")));
+  
+  // the stages update the thresholds of the operators in place, they are reset before each image
+  Vector<float> th1s, th2s;
+  operatorThresholds(*(t2sets(0)), th1s, th2s);
+  
+  // the parallel loops of the stages of an image share the threads left for its slot
+  int threads= omp_get_max_threads()/inflight;
+  if ( threads < 1 )
+    threads= 1;
+  int levels= omp_get_max_active_levels();
+  omp_set_max_active_levels(2);
+  tprintf("threads per image: %d\n", threads);
+  
+  #pragma omp parallel for num_threads(inflight) schedule(dynamic, 1)
+  for ( int i= 0; i < int(images.size()); ++i )
+  {
+    tprintf("segmenting %d/%zd: %s\n", i + 1, images.size(), images(i).c_str());
+    omp_set_num_threads(threads);
+    
+    Image<float> input;
+    Image<unsigned char> roi, support, output;
+    
+    Transform2Set<float, float>* t2set= t2sets(omp_get_thread_num());
+    setOperatorThresholds(*t2set, th1s, th2s);
+    
+    vpipelineStage0((char*)(images(i).c_str()), input, roi, support);
+    vpipelineStages(argv[1], t2set, input, roi, support, output, thStart, th1mult, th2mult, imageScale, maxit, nw, relativeIntensities, widthScaling2, mp, ap, fp, cp, sizeth0, sizeth1, widthScaling4);
+    
+    File f(images(i));
+    std::string name= f.getFilename();
+    name= name.substr(0, name.find_last_of("."));
+    std::string outputname= std::string(argv[3]) + std::string("/") + name + std::string(".png");
+    tprintf("writing output image %s\n", outputname.c_str());
+    writeImage(outputname.c_str(), output);
+  }
+  
+  omp_set_max_active_levels(levels);
+  
+  return 0;
+}
+
 int vstageallFunction(int , char** argv, int vstage1thStart, float vstage1th1multiplier, float vstage1th2multiplier, float vstage1imgscale, int vstage2maxit, float vstage2nw, char* vstage2relint, float vstage2ws, float /*vstage3th0*/, float /*vstage3th1*/, float /*vstage4mp*/, float /*vstage4ap*/, float /*vstage4fp*/, float /*vstage4cp*/, int /*vstage4sizeth0*/, int /*vstage4sizeth1*/, float /*vstage4ws*/)
 {
   Image<float> input;
   Image<unsigned char> roi, support, tmp, output;
+  VesselContext ctx;
   
   readImage(argv[2], input);
   readImage(argv[3], roi);
   readImage(argv[4], support);
   
-  vstage1Function(argv[1], input, roi, support, output, vstage1thStart, vstage1th1multiplier, vstage1th2multiplier, vstage1imgscale);
+  vstage1Function(ctx, argv[1], input, roi, support, output, vstage1thStart, vstage1th1multiplier, vstage1th2multiplier, vstage1imgscale);
   vstage2Function(input, output, roi, vstage2maxit, vstage2nw, vstage2relint, vstage2ws, tmp);
 /*  vstage3Function(tmp, vstage3th0, vstage3th1, output);
   vstage4Function(input, output, roi, support, vstage4mp, vstage4ap, vstage4fp, vstage4cp, vstage4sizeth0, vstage4sizeth1, vstage4ws, tmp);*/
@@ -2028,6 +2801,7 @@ int vstageallcolorFunction(int , char** argv, int vstage1thStart, float vstage1t
 {
   Image<float> input, originalGreen;
   Image<unsigned char> roi, support, tmp, output, red, green, extended;
+  VesselContext ctx;
   
   tprintf("reading color input image: %s\n", argv[2]);
   readImage(argv[2], red, READ_CHANNEL_RED);
@@ -2077,7 +2851,7 @@ int vstageallcolorFunction(int , char** argv, int vstage1thStart, float vstage1t
   writeImage("tmpc.bmp", support);
   
   tprintf("vstage1\n");
-  vstage1Function(argv[1], input, roi, support, output, vstage1thStart, vstage1th1multiplier, vstage1th2multiplier, vstage1imgscale);
+  vstage1Function(ctx, argv[1], input, roi, support, output, vstage1thStart, vstage1th1multiplier, vstage1th2multiplier, vstage1imgscale);
   
   tprintf("vstage2\n");
   vstage2Function(input, output, roi, vstage2maxit, vstage2nw, vstage2relint, vstage2vs, tmp);
@@ -2818,6 +3592,16 @@ int relativeIntensities(int , char** , bool ericolumns)
   return 0;
 }
 
+// writes the trace of the profiler and prints its summary at the exit of the process
+void writeProfile()
+{
+  if ( profiler.write(vesselprofile) )
+    eprintf("could not write profile %s\n", vesselprofile);
+  else
+    tprintf("profile written to %s\n", vesselprofile);
+  profiler.summary(stdout);
+}
+
 /**
  * main application
  * @param argc argument count
@@ -2834,6 +3618,9 @@ int main(int argc, char** argv)
     bool vstage2= false;
     //bool vstage3= false;
     bool vstage4= false;
+    bool vpipeline= false;
+    bool vbatch= false;
+    int vbatchinflight= 2;
     int vstage1thStart= 0;
     float vstage1imgscale= 1;
     int vstage2maxit= 30;
@@ -2916,6 +3703,18 @@ int main(int argc, char** argv)
     ot.addOption(string("--vessel.stage4.wa"), OPTION_FLOAT, (char*)&vstage4wa, 1, string("wavelength"));
     //ot.addOption(string("--vessel.stage4.wb"), OPTION_FLOAT, (char*)&vstage4wb, 1, string("upper wavelength bound"));
     ot.addUsage(string(argv[0]) + string(" --vessel.stage4 <input> <seed> <roi> <support> <output>"));
+    ot.addOption(string("--vessel.pipeline"), OPTION_BOOL, (char*)&vpipeline, 0, string("vessel extraction stages 0, 1, 2 and 4 in one process, parameterized by the stage options"));
+    ot.addUsage(string(argv[0]) + string(" --vessel.pipeline <feature.fdf> <colorinput> <output>"));
+    ot.addOption(string("--vessel.batch"), OPTION_BOOL, (char*)&vbatch, 0, string("vessel extraction pipeline for all images of a directory or list file with the model loaded once"));
+    ot.addOption(string("--vessel.cache"), OPTION_CHAR, (char*)&vesselcache, 1, string("container file of the cached filter responses"));
+    ot.addOption(string("--vessel.cache.budget"), OPTION_INT, (char*)&vesselcachebudget, 1, string("size of a new response cache in megabytes"));
+    ot.addOption(string("--vessel.cache.lzo"), OPTION_INT, (char*)&vesselcachelzo, 1, string("compress the cached responses"));
+    ot.addOption(string("--vessel.wsocache.budget"), OPTION_INT, (char*)&vesselwsobudget, 1, string("memory budget of the in-memory response cache in megabytes, -1 for unlimited"));
+    ot.addOption(string("--vessel.sweep.wave"), OPTION_INT, (char*)&vesselsweepwave, 1, string("maximum number of threshold multipliers evaluated at the same time by the sweep"));
+    ot.addOption(string("--vessel.wsocache.quantize"), OPTION_INT, (char*)&vesselwsoquantize, 1, string("store the in-memory responses as 16-bit fixed point numbers"));
+    ot.addOption(string("--vessel.batch.inflight"), OPTION_INT, (char*)&vbatchinflight, 1, string("maximum number of images held in memory"));
+    ot.addUsage(string(argv[0]) + string(" --vessel.batch <feature.fdf> <directory|list> <outputdirectory>"));
+    ot.addOption(string("--profile"), OPTION_CHAR, (char*)&vesselprofile, 1, string("write the timing of the stages and operators as a Chrome trace to the given file and print a summary"));
     /*ot.addOption(string("--vessel.stage5"), OPTION_BOOL, (char*)&vstage5, 0, string("vessel extraction stage 5"));
     ot.addOption(string("--vessel.stage5.tl"), OPTION_FLOAT, (char*)&vstage5tl, 1, string("translation lower limit"));
     ot.addOption(string("--vessel.stage5.tu"), OPTION_FLOAT, (char*)&vstage5tu, 1, string("translation upper limit"));
@@ -2959,6 +3758,12 @@ int main(int argc, char** argv)
 
     vstage2nweight= vstage2nw;
     
+    if ( vesselprofile[0] )
+    {
+      profiler.enable();
+      atexit(writeProfile);
+    }
+    
     if ( geometricMean )
       return gmeanFunction(argc, argv);
     else if ( geometricMean2 )
@@ -2983,6 +3788,10 @@ int main(int argc, char** argv)
       return vstage2Function(argc, argv, vstage2maxit, vstage2nw, vstage2relint, vstage2vs);
     else if ( vstage4 )
       return vstage4Function(argc, argv, vstage4mp, vstage4ap, vstage4fp, vstage4cp, vstage4sizeth0, vstage4sizeth1, vstage4ws);
+    else if ( vbatch )
+      return vbatchFunction(argc, argv, vbatchinflight, vstage1thStart, vstage1th1multiplier, vstage1th2multiplier, vstage1imgscale, vstage2maxit, vstage2nw, vstage2relint, vstage2vs, vstage4mp, vstage4ap, vstage4fp, vstage4cp, vstage4sizeth0, vstage4sizeth1, vstage4ws);
+    else if ( vpipeline )
+      return vpipelineFunction(argc, argv, vstage1thStart, vstage1th1multiplier, vstage1th2multiplier, vstage1imgscale, vstage2maxit, vstage2nw, vstage2relint, vstage2vs, vstage4mp, vstage4ap, vstage4fp, vstage4cp, vstage4sizeth0, vstage4sizeth1, vstage4ws);
     else if ( vesselall )
       return vstageallFunction(argc, argv, vstage1thStart, vstage1th1multiplier, vstage1th2multiplier, vstage1imgscale, vstage2maxit, vstage2nw, vstage2relint, vstage2vs, vstage3th0, vstage3th1, vstage4mp, vstage4ap, vstage4fp, vstage4cp, vstage4sizeth0, vstage4sizeth1, vstage4ws);
     else if ( vesselallcolor )
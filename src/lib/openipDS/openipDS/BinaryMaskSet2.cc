@@ -27,30 +27,34 @@ void openip::BinaryMaskSet2::generateLookUpTable()
     lutSize= lutSize << 25;
     lookUpTable.resize(lutSize);
 
-    std::ifstream inFile(lookUpTableFileName.c_str(), ios::binary);
-    if ( inFile != NULL )
-        inFile.read((char*)&(lookUpTable[0]), lutSize);
-    else
+    // the file may be read and written by several threads at the same time
+    #pragma omp critical (binaryMaskLookUpTable)
     {
-        if ( this->mode == MATCH_ANY )
-            for ( unsigned int i= 0; i < lookUpTable.size(); ++i )
-                lookUpTable[i]= matchAny(i);
-        else if ( this->mode == MATCH_NONE )
-            for ( unsigned int i= 0; i < lookUpTable.size(); ++i )
-                lookUpTable[i]= matchNone(i);
-        else if ( this->mode == MATCH_ALL )
-            for ( unsigned int i= 0; i < lookUpTable.size(); ++i )
-                lookUpTable[i]= matchAll(i);
-    }
+        std::ifstream inFile(lookUpTableFileName.c_str(), ios::binary);
+        if ( inFile != NULL )
+            inFile.read((char*)&(lookUpTable[0]), lutSize);
+        else
+        {
+            if ( this->mode == MATCH_ANY )
+                for ( unsigned int i= 0; i < lookUpTable.size(); ++i )
+                    lookUpTable[i]= matchAny(i);
+            else if ( this->mode == MATCH_NONE )
+                for ( unsigned int i= 0; i < lookUpTable.size(); ++i )
+                    lookUpTable[i]= matchNone(i);
+            else if ( this->mode == MATCH_ALL )
+                for ( unsigned int i= 0; i < lookUpTable.size(); ++i )
+                    lookUpTable[i]= matchAll(i);
+        }
 
-    if ( inFile == NULL )
-    {
-        std::ofstream outFile(lookUpTableFileName.c_str(), ios::binary);
-        if ( outFile != NULL )
-            outFile.write((char*)&(lookUpTable[0]), lutSize);
-        outFile.close();
+        if ( inFile == NULL )
+        {
+            std::ofstream outFile(lookUpTableFileName.c_str(), ios::binary);
+            if ( outFile != NULL )
+                outFile.write((char*)&(lookUpTable[0]), lutSize);
+            outFile.close();
+        }
+        inFile.close();
     }
-    inFile.close();
 }
 
 unsigned char openip::BinaryMaskSet2::matchAny(unsigned int env)
@@ -116,26 +116,30 @@ void openip::BinaryMaskSystem2::generateLookUpTable()
 
     this->lookUpTable.resize(lutSize);
 
-    std::ifstream inFile(lookUpTableFileName.c_str(), ios::binary);
-    
-    if ( inFile != NULL )
-        inFile.read((char*)&(lookUpTable[0]), lutSize);
-    else
+    // the file may be read and written by several threads at the same time
+    #pragma omp critical (binaryMaskLookUpTable)
     {
-        //BinaryMaskSystem2::iterator bit= this->begin();
+        std::ifstream inFile(lookUpTableFileName.c_str(), ios::binary);
 
-        for ( unsigned int i= 0; i < lutSize; ++i )
-            lookUpTable[i]= this->match(i);
-    }
+        if ( inFile != NULL )
+            inFile.read((char*)&(lookUpTable[0]), lutSize);
+        else
+        {
+            //BinaryMaskSystem2::iterator bit= this->begin();
 
-    if ( inFile == NULL )
-    {
-        std::ofstream outFile(lookUpTableFileName.c_str(), ios::binary);
-        if ( outFile != NULL )
-            outFile.write((char*)&(lookUpTable[0]), lutSize);
-        outFile.close();
+            for ( unsigned int i= 0; i < lutSize; ++i )
+                lookUpTable[i]= this->match(i);
+        }
+
+        if ( inFile == NULL )
+        {
+            std::ofstream outFile(lookUpTableFileName.c_str(), ios::binary);
+            if ( outFile != NULL )
+                outFile.write((char*)&(lookUpTable[0]), lutSize);
+            outFile.close();
+        }
+        inFile.close();
     }
-    inFile.close();
 }
 
 unsigned char openip::BinaryMaskSystem2::match(unsigned int env)
@@ -0,0 +1,111 @@
+/**
+ * @file CompactRegion2Set.h
+ * @author Gyorgy Kovacs <gyuriofkovacs@gmail.com>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * http://www.gnu.org/copyleft/gpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * The CompactRegion2Set stores a set of regions in compressed sparse row
+ * form: the pixels of all the regions in one array and the offsets of the
+ * regions in another, without the allocation of a Region2 object per region.
+ */
+
+#ifndef _COMPACT_REGION2_SET_H_
+#define _COMPACT_REGION2_SET_H_
+
+#include <openipDS/Vector.h>
+#include <openipDS/Region2.h>
+
+namespace openip
+{
+    /**
+     * CompactRegion2Set represents regions in compressed sparse row form, the pixels of region i
+     * are pixels[offsets[i]], ..., pixels[offsets[i+1]-1] in row-continuous representation
+     */
+    class CompactRegion2Set
+    {
+    public:
+        /**
+         * default constructor
+         */
+        CompactRegion2Set()
+        {
+            stride= 0;
+            offsets.push_back(0);
+        }
+
+        /**
+         * number of regions
+         * @return the number of regions
+         */
+        unsigned int size() const
+        {
+            return offsets.size() - 1;
+        }
+
+        /**
+         * number of pixels in region i
+         * @param i index of the region
+         * @return the number of pixels
+         */
+        int regionSize(int i) const
+        {
+            return offsets[i+1] - offsets[i];
+        }
+
+        /**
+         * pointer to the pixels of region i
+         * @param i index of the region
+         * @return pointer to the first pixel of the region
+         */
+        const int* region(int i) const
+        {
+            return &(pixels[offsets[i]]);
+        }
+
+        /**
+         * copies region i into a Region2 object
+         * @param i index of the region
+         * @param r output parameter, the region
+         */
+        void getRegion(int i, Region2& r) const
+        {
+            r.stride= stride;
+            r.resize(regionSize(i));
+            for ( int k= offsets[i]; k < offsets[i+1]; ++k )
+                r[k - offsets[i]]= pixels[k];
+        }
+
+        /**
+         * removes all the regions
+         */
+        void clear()
+        {
+            pixels.clear();
+            offsets.clear();
+            offsets.push_back(0);
+        }
+
+        /** pixels of the regions, region by region */
+        Vector<int> pixels;
+        /** offsets of the regions in the pixel array, size() + 1 elements */
+        Vector<int> offsets;
+        /** stride of the image of the regions */
+        int stride;
+    };
+}
+
+#endif
@@ -0,0 +1,202 @@
+/**
+ * @file FastFourierTransform.h
+ * @author Gyorgy Kovacs <gyuriofkovacs@gmail.com>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * http://www.gnu.org/copyleft/gpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * Self-contained radix-2 fast Fourier transform for the data structures
+ * package. The GSL based transforms of openipSC are not available here, this
+ * implementation is used by the filters needing convolutions in the frequency
+ * domain.
+ */
+
+#ifndef _FAST_FOURIER_TRANSFORM_H_
+#define _FAST_FOURIER_TRANSFORM_H_
+
+#include <complex>
+#include <math.h>
+
+#include <openipDS/Vector.h>
+
+namespace openip
+{
+    /**
+     * returns the smallest power of two not less than n
+     * @param n lower bound
+     * @return power of two
+     */
+    inline unsigned int nextPowerOfTwo(unsigned int n)
+    {
+        unsigned int p= 1;
+        while ( p < n )
+            p<<= 1;
+        return p;
+    }
+
+    /**
+     * radix-2 fast Fourier transform of a fixed length: the twiddle factors and the work buffers of the
+     * convolution are allocated once and reused by the transforms of the same length; a plan is not
+     * shared by threads
+     */
+    class FastFourierPlan
+    {
+    public:
+        /**
+         * constructor
+         * @param length length of the transforms, must be a power of two
+         */
+        FastFourierPlan(unsigned int length= 0);
+
+        /**
+         * sets the length of the transforms, the twiddle factors and buffers are only reallocated if the
+         * length changes
+         * @param length length of the transforms, must be a power of two
+         */
+        void resize(unsigned int length);
+
+        /**
+         * in-place iterative transform, the inverse transform is normalized by 1/length
+         * @param data complex vector of length elements
+         * @param inverse 0 for the forward, 1 for the inverse transform
+         */
+        void transform(std::complex<double>* data, int inverse= 0);
+
+        /**
+         * computes the circular convolution of the real and the imaginary part of the buffer with one
+         * complex forward and one complex inverse transform, the result is the real part of the product
+         */
+        void convolve();
+
+        /** length of the transforms */
+        unsigned int length;
+        /** twiddle factors of the forward transform */
+        Vector<std::complex<double> > twiddles;
+        /** input of the convolution, the two real sequences packed into the real and imaginary parts */
+        Vector<std::complex<double> > buffer;
+        /** output of the convolution */
+        Vector<std::complex<double> > product;
+    };
+
+    inline FastFourierPlan::FastFourierPlan(unsigned int length)
+    {
+        this->length= 0;
+        resize(length);
+    }
+
+    inline void FastFourierPlan::resize(unsigned int length)
+    {
+        if ( length == this->length )
+            return;
+
+        this->length= length;
+        twiddles.resize(length/2);
+        for ( unsigned int i= 0; i < length/2; ++i )
+            twiddles(i)= std::complex<double>(cos(2*M_PI*i/length), -sin(2*M_PI*i/length));
+        buffer.resize(length);
+        product.resize(length);
+    }
+
+    inline void FastFourierPlan::transform(std::complex<double>* data, int inverse)
+    {
+        if ( length < 2 )
+            return;
+
+        for ( unsigned int i= 1, j= 0; i < length; ++i )
+        {
+            unsigned int bit= length >> 1;
+            for ( ; j & bit; bit>>= 1 )
+                j^= bit;
+            j^= bit;
+            if ( i < j )
+                std::swap(data[i], data[j]);
+        }
+
+        for ( unsigned int half= 1, step= length/2; half < length; half<<= 1, step>>= 1 )
+        {
+            #pragma omp parallel for if ( length >= 65536 )
+            for ( int b= 0; b < int(length/2); ++b )
+            {
+                unsigned int k= b & (half - 1);
+                unsigned int i= ((b - k) << 1) + k;
+                std::complex<double> w= inverse ? std::conj(twiddles(k*step)) : twiddles(k*step);
+                std::complex<double> t= data[i + half] * w;
+                data[i + half]= data[i] - t;
+                data[i]+= t;
+            }
+        }
+
+        if ( inverse )
+            for ( unsigned int i= 0; i < length; ++i )
+                data[i]/= length;
+    }
+
+    inline void FastFourierPlan::convolve()
+    {
+        transform(&(buffer(0)));
+
+        // A(k)B(k) = (Z(k)^2 - conj(Z(-k))^2)/4i, the spectrum of the product is hermitian
+        std::complex<double> fouri(0, 4);
+        for ( unsigned int k= 0; k < length; ++k )
+        {
+            std::complex<double> zr= std::conj(buffer((length - k) & (length - 1)));
+            product(k)= (buffer(k)*buffer(k) - zr*zr)/fouri;
+        }
+
+        transform(&(product(0)), 1);
+    }
+
+    /**
+     * in-place iterative radix-2 fast Fourier transform, the inverse transform
+     * is normalized by 1/length
+     * @param data complex vector of length elements
+     * @param length length of the vector, must be a power of two
+     * @param inverse 0 for the forward, 1 for the inverse transform
+     */
+    inline void fastFourierTransform(std::complex<double>* data, unsigned int length, int inverse= 0)
+    {
+        FastFourierPlan plan(length);
+        plan.transform(data, inverse);
+    }
+
+    /**
+     * computes the circular convolution of two real sequences with one complex
+     * forward and one complex inverse transform: a is packed into the real, b
+     * into the imaginary part of the input
+     * @param a first real sequence
+     * @param b second real sequence
+     * @param length length of the sequences, must be a power of two
+     * @param result the real convolution of a and b, length elements
+     * @param plan if not NULL, the transforms use the twiddle factors and buffers of the plan
+     */
+    template<typename T>
+    void fastFourierConvolution(const T* a, const T* b, unsigned int length, double* result, FastFourierPlan* plan= NULL)
+    {
+        FastFourierPlan local;
+        FastFourierPlan& p= plan ? *plan : local;
+        p.resize(length);
+
+        for ( unsigned int i= 0; i < length; ++i )
+            p.buffer(i)= std::complex<double>(a[i], b[i]);
+
+        p.convolve();
+
+        for ( unsigned int i= 0; i < length; ++i )
+            result[i]= p.product(i).real();
+    }
+}
+
+#endif
@@ -40,13 +40,37 @@
 #include <openipDS/Filter1.h>
 #include <openipDS/Feature2.h>
 #include <openipDS/Template2.h>
+#include <openipDS/FastFourierTransform.h>
 
 #ifdef USE_OPENCL
 #include <CL/cl.h>
 #endif
 
+/** number of consecutive positions evaluated together by the compiled filters */
+#define FILTER2_TILE 1024
+
 namespace openip
 {
+    /**
+     * decides if a tile of positions is evaluated densely or position by position
+     * @param roi region of interest, NULL means the whole image
+     * @param begin first position of the tile
+     * @param length number of positions in the tile
+     * @return 0 if the tile has no foreground, 1 if it is sparse, 2 if it should be evaluated densely
+     */
+    inline int compiledTileMode(Image<unsigned char>* roi, int begin, int length)
+    {
+        if ( roi == NULL )
+            return 2;
+        int n= 0;
+        for ( int i= begin; i < begin + length; ++i )
+            if ( (*roi)(i) )
+                ++n;
+        if ( n == 0 )
+            return 0;
+        return 4*n < length ? 1 : 2;
+    }
+
     /**
      * Filter represents a filter as a set of PositionWeightPairs
      */
@@ -131,6 +155,33 @@ namespace openip
          */
         virtual void apply(Image<INPUT>& in, Image<OUTPUT>& out, Image<unsigned char>* roi= NULL, Image<unsigned char>* support= NULL);
         
+        /**
+         * applies the filter tile by tile on the dense representation of the filter, the taps are summed
+         * in the same order as by the position-wise apply
+         * @param in input image
+         * @param out output image
+         * @param roi if not NULL, only the foreground (non-zero) region of the roi image is used
+         */
+        virtual void applyCompiled(Image<INPUT>& in, Image<OUTPUT>& out, Image<unsigned char>* roi= NULL);
+
+        /**
+         * the whole image apply of the filter can run on the CompiledTemplate2 of the filter only if the
+         * position-wise apply is the one of the class implementing the whole image apply
+         * @return non-zero if the compiled evaluation can be used, the classes overriding the
+         * position-wise apply return 0
+         */
+        virtual int compilable();
+
+        /**
+         * returns the compiled form of the filter, it is compiled again only if the stride or
+         * the taps have changed since the last compilation
+         * @return the compiled form of the filter with its current stride
+         */
+        CompiledTemplate2<WEIGHTS>& getCompiledTemplate();
+
+        /** the compiled form of the filter, see getCompiledTemplate */
+        CompiledTemplate2<WEIGHTS> compiledTemplate;
+
 //        virtual int applyGPU(Image<INPUT>& in, Image<OUTPUT>& out, Image<unsigned char>* roi= NULL, Image<unsigned char>* support= NULL);
 
         /**
@@ -244,6 +295,14 @@ namespace openip
         * @param roi if not NULL, only the foreground (non-zero) region of the roi image is used
 	*/
         virtual void apply(Image<INPUT>& in, Image<OUTPUT>& out, Image<unsigned char>* roi= NULL, Image<unsigned char>* support= NULL);
+
+        /**
+         * applies the correlation filter tile by tile on the dense representation of the filter
+         * @param in input image
+         * @param out output image
+         * @param roi if not NULL, only the foreground (non-zero) region of the roi image is used
+         */
+        virtual void applyCompiled(Image<INPUT>& in, Image<OUTPUT>& out, Image<unsigned char>* roi= NULL);
     };
 
     template<typename INPUT, typename OUTPUT, typename WEIGHTS>
@@ -317,9 +376,42 @@ namespace openip
     */
         virtual void apply(Image<INPUT>& in, Image<OUTPUT>& out, Image<unsigned char>* roi= NULL, Image<unsigned char>* support= NULL);
 
+        /**
+         * estimates if the evaluation through FFT is cheaper than the tap by tap evaluation
+         * @param in input image
+         * @param roi if not NULL, only the foreground (non-zero) region of the roi image is used
+         * @param fraction the expected fraction of the roi the filter is evaluated in
+         * @param compiled non-zero if the alternative is the compiled evaluation, 0 if it is position by position
+         * @return non-zero if the Fourier backend should be used
+         */
+        virtual int preferFourier(Image<INPUT>& in, Image<unsigned char>* roi= NULL, float fraction= 1.0f, int compiled= 1);
+
+        /**
+         * applies the correlation filter to the whole image: the numerator is computed by FFT convolution,
+         * the mean and deviation of the image under the filter by prefix sums over the runs of the footprint
+         * @param in input image
+         * @param out output image
+         * @param roi if not NULL, only the foreground (non-zero) region of the roi image is used
+         * @param plan if not NULL, the transforms reuse the twiddle factors and buffers of the plan
+         */
+        virtual void applyFourier(Image<INPUT>& in, Image<OUTPUT>& out, Image<unsigned char>* roi= NULL, FastFourierPlan* plan= NULL);
+
+        /**
+         * applies the correlation filter tile by tile on the dense representation of the filter
+         * @param in input image
+         * @param out output image
+         * @param roi if not NULL, only the foreground (non-zero) region of the roi image is used
+         */
+        virtual void applyCompiled(Image<INPUT>& in, Image<OUTPUT>& out, Image<unsigned char>* roi= NULL);
+
         float meanF;
         float devF;
         int initialized;
+
+        /**
+         * CCORRELATION_BACKEND_AUTO, CCORRELATION_BACKEND_SPATIAL or CCORRELATION_BACKEND_FOURIER
+         */
+        int backend;
     };
     
     template<typename INPUT, typename OUTPUT, typename WEIGHTS>
@@ -383,6 +475,12 @@ namespace openip
          */
         virtual OUTPUT apply(Image<INPUT>& in, int n, Image<unsigned char>* support= NULL);
 
+        /**
+         * the position-wise apply is overridden, the compiled evaluation of Filter2 does not apply
+         * @return 0
+         */
+        virtual int compilable() { return 0; }
+
 
     /**
     * applies the correlation filter to image in into image out in the foreground (non 0) region of mask
@@ -459,6 +557,12 @@ namespace openip
          */
         virtual OUTPUT apply(Image<INPUT>& in, int n, Image<unsigned char>* support= NULL);
 
+        /**
+         * the position-wise apply is overridden, the compiled evaluation of Filter2 does not apply
+         * @return 0
+         */
+        virtual int compilable() { return 0; }
+
 
     /**
     * applies the correlation filter to image in into image out in the foreground (non 0) region of mask
@@ -538,6 +642,12 @@ namespace openip
          */
         virtual OUTPUT apply(Image<INPUT>& in, int n, Image<unsigned char>* support= NULL);
 
+        /**
+         * the position-wise apply is overridden, the compiled evaluation of Filter2 does not apply
+         * @return 0
+         */
+        virtual int compilable() { return 0; }
+
 
     /**
     * applies the correlation filter to image in into image out in the foreground (non 0) region of mask
@@ -637,6 +747,14 @@ namespace openip
         if ( updateStride(in.columns) )
             computeMinMax();
 
+        if ( support == NULL && compilable() )
+        {
+            if ( roi == NULL )
+                out= 0;
+            applyCompiled(in, out, roi);
+            return;
+        }
+
         if ( roi == NULL )
         {
             out= 0;
@@ -657,6 +775,65 @@ namespace openip
         }
     }
 
+    template<typename INPUT, typename OUTPUT, typename WEIGHTS>
+    void Filter2<INPUT, OUTPUT, WEIGHTS>::applyCompiled(Image<INPUT>& in, Image<OUTPUT>& out, Image<unsigned char>* roi)
+    {
+        CompiledTemplate2<WEIGHTS>& ct= this->getCompiledTemplate();
+        int begin= -this->getMin();
+        int end= in.size() - this->getMax();
+        int taps= ct.offsets.size();
+
+        #pragma omp parallel
+        {
+            Vector<float> acc(FILTER2_TILE);
+
+            #pragma omp for schedule(dynamic)
+            for ( int t= begin; t < end; t+= FILTER2_TILE )
+            {
+                int length= std::min(FILTER2_TILE, end - t);
+                int mode= compiledTileMode(roi, t, length);
+                if ( mode == 1 )
+                    for ( int i= t; i < t + length; ++i )
+                        if ( (*roi)(i) )
+                            out(i)= Filter2<INPUT, OUTPUT, WEIGHTS>::apply(in, i, NULL);
+                if ( mode != 2 )
+                    continue;
+
+                float* a= &(acc(0));
+                for ( int x= 0; x < length; ++x )
+                    a[x]= 0;
+                for ( int k= 0; k < taps; ++k )
+                {
+                    const INPUT* p= &(in(t + ct.offsets(k)));
+                    WEIGHTS w= ct.weights(k);
+                    for ( int x= 0; x < length; ++x )
+                        a[x]+= p[x] * w;
+                }
+
+                for ( int x= 0; x < length; ++x )
+                    if ( roi == NULL || (*roi)(t + x) )
+                        out(t + x)= a[x];
+            }
+        }
+    }
+
+    template<typename INPUT, typename OUTPUT, typename WEIGHTS>
+    CompiledTemplate2<WEIGHTS>& Filter2<INPUT, OUTPUT, WEIGHTS>::getCompiledTemplate()
+    {
+        #pragma omp critical (filter2CompiledTemplate)
+        {
+            if ( !compiledTemplate.compiledFrom(*this) )
+                compiledTemplate.compile(*this);
+        }
+        return compiledTemplate;
+    }
+
+    template<typename INPUT, typename OUTPUT, typename WEIGHTS>
+    int Filter2<INPUT, OUTPUT, WEIGHTS>::compilable()
+    {
+        return 1;
+    }
+
     template<typename INPUT, typename OUTPUT, typename WEIGHTS>
     void Filter2<INPUT, OUTPUT, WEIGHTS>::addElement(int row, int columns, WEIGHTS weight)
     {
@@ -938,6 +1115,14 @@ namespace openip
     void CorrelationFilter2<INPUT, OUTPUT, WEIGHTS>::apply(Image<INPUT>& in, Image<OUTPUT>& out, Image<unsigned char>* roi, Image<unsigned char>* support)
     {
         this->updateStride(in.columns);
+        if ( support == NULL && this->compilable() )
+        {
+            if ( roi == NULL )
+                out= 0;
+            applyCompiled(in, out, roi);
+            return;
+        }
+
         if ( roi == NULL )
         {
             out= 0;
@@ -955,6 +1140,64 @@ namespace openip
                     out(i)= apply(in, i, support);
         }
     }
+
+    template<typename INPUT, typename OUTPUT, typename WEIGHTS>
+    void CorrelationFilter2<INPUT, OUTPUT, WEIGHTS>::applyCompiled(Image<INPUT>& in, Image<OUTPUT>& out, Image<unsigned char>* roi)
+    {
+        CompiledTemplate2<WEIGHTS>& ct= this->getCompiledTemplate();
+        this->computeMinMax();
+        int begin= -this->min;
+        int end= in.size() - this->max;
+        int taps= ct.offsets.size();
+
+        float devF= 0;
+        for ( int k= 0; k < taps; ++k )
+            devF+= (ct.weights(k)) * (ct.weights(k));
+        devF= sqrt(devF);
+
+        #pragma omp parallel
+        {
+            Vector<float> accF(FILTER2_TILE), accI(FILTER2_TILE);
+
+            #pragma omp for schedule(dynamic)
+            for ( int t= begin; t < end; t+= FILTER2_TILE )
+            {
+                int length= std::min(FILTER2_TILE, end - t);
+                int mode= compiledTileMode(roi, t, length);
+                if ( mode == 1 )
+                    for ( int i= t; i < t + length; ++i )
+                        if ( (*roi)(i) )
+                            out(i)= CorrelationFilter2<INPUT, OUTPUT, WEIGHTS>::apply(in, i, NULL);
+                if ( mode != 2 )
+                    continue;
+
+                float* f= &(accF(0));
+                float* d= &(accI(0));
+                for ( int x= 0; x < length; ++x )
+                    f[x]= d[x]= 0;
+                for ( int k= 0; k < taps; ++k )
+                {
+                    const INPUT* p= &(in(t + ct.offsets(k)));
+                    WEIGHTS w= ct.weights(k);
+                    for ( int x= 0; x < length; ++x )
+                    {
+                        d[x]+= (p[x]) * (p[x]);
+                        f[x]+= (p[x]) * (w);
+                    }
+                }
+
+                for ( int x= 0; x < length; ++x )
+                    if ( roi == NULL || (*roi)(t + x) )
+                    {
+                        float devI= sqrt(d[x]);
+                        if ( fabs(devI) > FLT_EPSILON )
+                            out(t + x)= f[x]/devI/devF;
+                        else
+                            out(t + x)= 0;
+                    }
+            }
+        }
+    }
     
 #ifdef USE_OPENCL
     template<typename INPUT, typename OUTPUT, typename WEIGHTS>
@@ -1063,6 +1306,7 @@ namespace openip
     {
         this->stride= stride;
         this->initialized= 0;
+        this->backend= CCORRELATION_BACKEND_AUTO;
 
         devF= 0;
         meanF= 0;
@@ -1073,6 +1317,7 @@ namespace openip
     : Filter2<INPUT, OUTPUT, WEIGHTS>(f)
     {
         this->stride= f.stride;
+        this->backend= CCORRELATION_BACKEND_AUTO;
     }
 
     template<typename INPUT, typename OUTPUT, typename WEIGHTS>
@@ -1176,6 +1421,20 @@ namespace openip
     void CCorrelationFilter2<INPUT, OUTPUT, WEIGHTS>::apply(Image<INPUT>& in, Image<OUTPUT>& out, Image<unsigned char>* roi, Image<unsigned char>* support)
     {
         this->updateStride(in.columns);
+        if ( support == NULL && (backend == CCORRELATION_BACKEND_FOURIER || (backend == CCORRELATION_BACKEND_AUTO && preferFourier(in, roi))) )
+        {
+            applyFourier(in, out, roi);
+            return;
+        }
+
+        if ( support == NULL && this->compilable() )
+        {
+            if ( roi == NULL )
+                out= 0;
+            applyCompiled(in, out, roi);
+            return;
+        }
+
         if ( roi == NULL )
         {
             out= 0;
@@ -1194,6 +1453,177 @@ namespace openip
         }
     }
 
+    template<typename INPUT, typename OUTPUT, typename WEIGHTS>
+    void CCorrelationFilter2<INPUT, OUTPUT, WEIGHTS>::applyCompiled(Image<INPUT>& in, Image<OUTPUT>& out, Image<unsigned char>* roi)
+    {
+        CompiledTemplate2<WEIGHTS>& ct= this->getCompiledTemplate();
+        this->computeMinMax();
+        int begin= -this->min;
+        int end= in.size() - this->max;
+        int taps= ct.offsets.size();
+
+        #pragma omp parallel
+        {
+            Vector<float> accF(FILTER2_TILE), accI(FILTER2_TILE), accI2(FILTER2_TILE);
+
+            #pragma omp for schedule(dynamic)
+            for ( int t= begin; t < end; t+= FILTER2_TILE )
+            {
+                int length= std::min(FILTER2_TILE, end - t);
+                int mode= compiledTileMode(roi, t, length);
+                if ( mode == 1 )
+                    for ( int i= t; i < t + length; ++i )
+                        if ( (*roi)(i) )
+                            out(i)= CCorrelationFilter2<INPUT, OUTPUT, WEIGHTS>::apply(in, i, NULL);
+                if ( mode != 2 )
+                    continue;
+
+                float* f= &(accF(0));
+                float* meanI= &(accI(0));
+                float* meanI2= &(accI2(0));
+                for ( int x= 0; x < length; ++x )
+                    f[x]= meanI[x]= meanI2[x]= 0;
+
+                for ( int k= 0; k < taps; ++k )
+                {
+                    const INPUT* p= &(in(t + ct.offsets(k)));
+                    for ( int x= 0; x < length; ++x )
+                    {
+                        meanI[x]+= p[x];
+                        meanI2[x]+= float(p[x]) * p[x];
+                    }
+                }
+
+                // the same expressions as in the position-wise apply, in the same order
+                for ( int x= 0; x < length; ++x )
+                {
+                    meanI[x]/= this->size();
+                    meanI2[x]/= this->size();
+                    meanI2[x]= sqrt((meanI2[x] - meanI[x]*meanI[x])*this->size());
+                }
+
+                for ( int k= 0; k < taps; ++k )
+                {
+                    const INPUT* p= &(in(t + ct.offsets(k)));
+                    WEIGHTS w= ct.weights(k);
+                    for ( int x= 0; x < length; ++x )
+                        f[x]+= (p[x] - meanI[x]) * (w - meanF);
+                }
+
+                for ( int x= 0; x < length; ++x )
+                    if ( roi == NULL || (*roi)(t + x) )
+                    {
+                        if ( fabs(meanI2[x]) > FLT_EPSILON )
+                            out(t + x)= f[x]/meanI2[x]/devF;
+                        else
+                            out(t + x)= 0;
+                    }
+            }
+        }
+    }
+
+    template<typename INPUT, typename OUTPUT, typename WEIGHTS>
+    int CCorrelationFilter2<INPUT, OUTPUT, WEIGHTS>::preferFourier(Image<INPUT>& in, Image<unsigned char>* roi, float fraction, int compiled)
+    {
+        if ( this->size() == 0 )
+            return 0;
+
+        double pixels= (roi == NULL) ? in.n : roi->numberOfNonZeroElements();
+        double length= nextPowerOfTwo(in.n);
+
+        // three passes over the taps per pixel against two complex transforms of the padded image,
+        // the weights are set so that the estimate crosses over where the measured running times do;
+        // the compiled evaluation streams through whole tiles, but much faster than gathering the taps
+        double spatialCost= 3.0 * this->size() * pixels * fraction;
+        if ( compiled && this->compilable() )
+            spatialCost= 0.5 * this->size() * in.n * fraction;
+        double fourierCost= 8.0 * length * log2(length);
+
+        return fourierCost < spatialCost;
+    }
+
+    template<typename INPUT, typename OUTPUT, typename WEIGHTS>
+    void CCorrelationFilter2<INPUT, OUTPUT, WEIGHTS>::applyFourier(Image<INPUT>& in, Image<OUTPUT>& out, Image<unsigned char>* roi, FastFourierPlan* plan)
+    {
+        this->updateStride(in.columns);
+        this->computeMinMax();
+
+        if ( roi == NULL )
+            out= 0;
+
+        int n= in.n;
+        int size= this->size();
+        unsigned int length= nextPowerOfTwo(n);
+
+        FastFourierPlan local;
+        FastFourierPlan& p= plan ? *plan : local;
+        p.resize(length);
+
+        // the correlation is a convolution with the mirrored zero mean weights, circular wrapping
+        // never reaches the positions where all the taps are inside the image; the image is packed
+        // into the real, the weights into the imaginary part of the buffer of the plan
+        Vector<int> offsets;
+        double sumG= 0;
+        for ( int i= 0; i < n; ++i )
+            p.buffer(i)= std::complex<double>(in(i), 0);
+        for ( unsigned int i= n; i < length; ++i )
+            p.buffer(i)= 0;
+        for ( typename Filter2<INPUT, OUTPUT, WEIGHTS>::fIt fit= this->begin(); fit != this->end(); ++fit )
+        {
+            p.buffer((unsigned int)(-fit->first) & (length - 1))+= std::complex<double>(0, fit->second - meanF);
+            sumG+= fit->second - meanF;
+            offsets.push_back(fit->first);
+        }
+
+        p.convolve();
+        Vector<std::complex<double> >& numerator= p.product;
+
+        // the footprint is decomposed into runs of consecutive offsets
+        std::sort(offsets.begin(), offsets.end());
+        Vector<int> runBegin, runEnd;
+        for ( unsigned int i= 0; i < offsets.size(); ++i )
+            if ( i == 0 || offsets(i) != offsets(i-1) + 1 )
+            {
+                runBegin.push_back(offsets(i));
+                runEnd.push_back(offsets(i) + 1);
+            }
+            else
+                runEnd(runEnd.size()-1)= offsets(i) + 1;
+
+        Vector<double> prefix(n + 1), prefix2(n + 1);
+        prefix(0)= prefix2(0)= 0;
+        for ( int i= 0; i < n; ++i )
+        {
+            prefix(i+1)= prefix(i) + in(i);
+            prefix2(i+1)= prefix2(i) + double(in(i))*in(i);
+        }
+
+        int end= n - this->max;
+        int runs= runBegin.size();
+        #pragma omp parallel for
+        for ( int i= -this->min; i < end; ++i )
+        {
+            if ( roi != NULL && !(*roi)(i) )
+                continue;
+
+            double sum= 0, sum2= 0;
+            for ( int r= 0; r < runs; ++r )
+            {
+                sum+= prefix(i + runEnd(r)) - prefix(i + runBegin(r));
+                sum2+= prefix2(i + runEnd(r)) - prefix2(i + runBegin(r));
+            }
+
+            double meanI= sum/size;
+            double variance= sum2/size - meanI*meanI;
+            double devI= variance > 0 ? sqrt(variance*size) : 0;
+
+            if ( fabs(devI) > FLT_EPSILON )
+                out(i)= (numerator(i).real() - meanI*sumG)/devI/devF;
+            else
+                out(i)= 0;
+        }
+    }
+
     
     template<typename INPUT, typename OUTPUT, typename WEIGHTS>
     PWCMTMPWFilter2<INPUT, OUTPUT, WEIGHTS>::PWCMTMPWFilter2(int stride)
@@ -2027,6 +2027,12 @@ namespace openip
 
         virtual OUTPUT apply(Image<INPUT>& input, int n, Image<unsigned char>* support= NULL);
 
+        /**
+         * the position-wise apply is overridden, the compiled evaluation of Filter2 does not apply
+         * @return 0
+         */
+        virtual int compilable() { return 0; }
+
         virtual int getMin();
 
         virtual int getMax();
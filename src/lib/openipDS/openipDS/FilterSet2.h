@@ -773,6 +773,17 @@ namespace openip
 
         virtual void apply(Image<INPUT>& input, ImageVector<OUTPUT>& output, Image<unsigned char>* roi= NULL, Image<unsigned char>* support= NULL);
 
+        /**
+         * applies the filter set in position n, the responses of the filters already evaluated on the
+         * whole image are read from responses instead of being recomputed
+         * @param input input image
+         * @param n position in row-continuous representation
+         * @param support if not NULL, only the foreground (non-zero) region of the support image is used
+         * @param responses whole image responses of the filters, empty images for filters evaluated by position
+         * @return the maximum response
+         */
+        OUTPUT applyMax(Image<INPUT>& input, int n, Image<unsigned char>* support, Vector<Image<OUTPUT> >* responses);
+
         virtual Border2 getProposedBorder();
 
         void getWeights(Vector<Vector<WEIGHTS> >& v);
@@ -872,6 +883,12 @@ namespace openip
 
     template<typename INPUT, typename OUTPUT, typename WEIGHTS>
     OUTPUT MaxFilterSet2<INPUT, OUTPUT, WEIGHTS>::apply(Image<INPUT>& in, int n, Image<unsigned char>* support)
+    {
+        return applyMax(in, n, support, NULL);
+    }
+
+    template<typename INPUT, typename OUTPUT, typename WEIGHTS>
+    OUTPUT MaxFilterSet2<INPUT, OUTPUT, WEIGHTS>::applyMax(Image<INPUT>& in, int n, Image<unsigned char>* support, Vector<Image<OUTPUT> >* responses)
     {
         OUTPUT tmp;
         OUTPUT max= -FLT_MAX;
@@ -881,7 +898,7 @@ namespace openip
 	int maxIdx= 0;
 	for ( unsigned int i= 0; i < this->size(); i+=2 )
         {
-            tmp= (*this)[i]->apply(in, n, support);
+            tmp= (responses && (*responses)(i).n) ? (*responses)(i)(n) : (*this)[i]->apply(in, n, support);
             if ( tmp > max )
 	    {
                 max= tmp;
@@ -900,7 +917,7 @@ namespace openip
 	    j-= this->size();
 	  if ( j%2 == 1 )
 	  {
-	    tmp= (*this)[j]->apply(in, n, support);
+	    tmp= (responses && (*responses)(j).n) ? (*responses)(j)(n) : (*this)[j]->apply(in, n, support);
             if ( tmp > max )
 	    {
                 max= tmp;
@@ -933,12 +950,30 @@ namespace openip
 
         output= 0;
 
+        // the correlation filters set to the Fourier backend are evaluated on the whole image in the frequency
+        // domain, the orientations have the same transform length and share one plan; the automatic backend
+        // keeps the tap by tap evaluation: in flat neighborhoods (mirrored borders) its float variance is
+        // dominated by rounding, the FFT does not reproduce those responses and the trained thresholds of
+        // the models depend on them
+        Vector<Image<OUTPUT> > responses(this->size());
+        FastFourierPlan plan;
+        if ( support == NULL )
+            for ( unsigned int i= 0; i < this->size(); ++i )
+            {
+                CCorrelationFilter2<INPUT, OUTPUT, WEIGHTS>* cf= dynamic_cast<CCorrelationFilter2<INPUT, OUTPUT, WEIGHTS>*>((*this)[i]);
+                if ( cf && cf->backend == CCORRELATION_BACKEND_FOURIER )
+                {
+                    responses(i).resizeImage(input);
+                    cf->applyFourier(input, responses(i), roi, &plan);
+                }
+            }
+
         if ( roi == NULL )
         {
             //printf("without roi\n"); fflush(stdout);
             //#pragma omp parallel for
             for ( int i= -this->min; i < (int)(input.n) - this->max; ++i )
-                output(i)= apply(input, i, support);
+                output(i)= applyMax(input, i, support, &responses);
         }
         else
         {
@@ -946,7 +981,7 @@ namespace openip
             for ( int i= -this->min; i < (int)(input.n) - this->max; ++i )
                 if ( (*roi)(i) > 0 )
                 {
-                    output(i)= apply(input, i, support);
+                    output(i)= applyMax(input, i, support, &responses);
                     //++n;
                 }
         }
@@ -0,0 +1,311 @@
+/**
+ * @file FusedCCorrelationFilterBank2.h
+ * @author Gyorgy Kovacs <gyuriofkovacs@gmail.com>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * http://www.gnu.org/copyleft/gpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * The FusedCCorrelationFilterBank2 evaluates all the normalized cross-correlation
+ * filters of a filter set in one sweep per pixel: the union of the footprints
+ * is read once, the zero mean weights of the filters are stored as a dense
+ * tap x filter block, and the mean and deviation of the image under each
+ * footprint are computed from prefix sums.
+ */
+
+#ifndef _FUSED_CCORRELATION_FILTER_BANK2_H_
+#define _FUSED_CCORRELATION_FILTER_BANK2_H_
+
+#include <float.h>
+#include <math.h>
+#include <algorithm>
+
+#include <openipDS/Filter2.h>
+#include <openipDS/FilterSet2.h>
+#include <openipDS/Image.h>
+#include <openipDS/Vector.h>
+
+namespace openip
+{
+    /**
+     * FusedCCorrelationFilterBank2 is the compiled form of a set of CCorrelationFilter2 objects
+     */
+    template<typename INPUT, typename OUTPUT, typename WEIGHTS>
+    class FusedCCorrelationFilterBank2
+    {
+    public:
+        /**
+         * default constructor
+         */
+        FusedCCorrelationFilterBank2();
+
+        /**
+         * compiles the filters of the set, the strides of the filters need to be updated in advance
+         * @param filters set of CCorrelationFilter2 objects
+         * @return 0 on success, 1 if some filter of the set is not a CCorrelationFilter2
+         */
+        int compile(MaxFilterSet2<INPUT, OUTPUT, WEIGHTS>& filters);
+
+        /**
+         * computes the prefix sums of the image and of its square
+         * @param input input image
+         */
+        void prepare(Image<INPUT>& input);
+
+        /**
+         * computes the responses of all the filters in position n, prepare must be called in advance
+         * @param input input image
+         * @param n position in row-continuous representation
+         * @param responses output array of at least padded elements
+         */
+        void apply(Image<INPUT>& input, int n, float* responses);
+
+        /**
+         * computes the maximum response and its index in the foreground of the roi
+         * @param input input image
+         * @param output maximum responses
+         * @param direction index of the filter with the maximum response
+         * @param roi if not NULL, only the foreground (non-zero) region of the roi image is used
+         */
+        void apply(Image<INPUT>& input, Image<OUTPUT>& output, Image<int>& direction, Image<unsigned char>* roi= NULL);
+
+        /**
+         * computes the maximum response with the search of MaxFilterSet2::apply: the maximum of the even
+         * filters, refined by the odd filters within 15% of the filters around it
+         * @param input input image
+         * @param output maximum responses
+         * @param roi if not NULL, only the foreground (non-zero) region of the roi image is used
+         */
+        void applyMax(Image<INPUT>& input, Image<OUTPUT>& output, Image<unsigned char>* roi= NULL);
+
+        /** number of filters */
+        int filters;
+        /** number of filters rounded up to a multiple of 8, the row length of the weight block */
+        int padded;
+        /** smallest and largest offset of the union of the footprints */
+        int min, max;
+
+        /** union of the footprints, sorted */
+        Vector<int> offsets;
+        /** offsets.size() x padded zero mean weights, 0 where a filter has no tap */
+        Vector<float> weights;
+
+        /** runs of consecutive offsets of the filters, the runs of filter i are in [runIndex(i), runIndex(i+1)) */
+        Vector<int> runIndex, runBegin, runEnd;
+        /** number of taps, sum of zero mean weights and deviation of the weights of the filters */
+        Vector<float> sizes, sumG, devF;
+
+        /** prefix sums of the image and of its square */
+        Vector<double> prefix, prefix2;
+    };
+
+    template<typename INPUT, typename OUTPUT, typename WEIGHTS>
+    FusedCCorrelationFilterBank2<INPUT, OUTPUT, WEIGHTS>::FusedCCorrelationFilterBank2()
+    {
+        filters= 0;
+        padded= 0;
+        min= max= 0;
+    }
+
+    template<typename INPUT, typename OUTPUT, typename WEIGHTS>
+    int FusedCCorrelationFilterBank2<INPUT, OUTPUT, WEIGHTS>::compile(MaxFilterSet2<INPUT, OUTPUT, WEIGHTS>& fs)
+    {
+        filters= fs.size();
+        padded= (filters + 7)/8*8;
+
+        offsets.clear();
+        for ( int i= 0; i < filters; ++i )
+        {
+            CCorrelationFilter2<INPUT, OUTPUT, WEIGHTS>* cf= dynamic_cast<CCorrelationFilter2<INPUT, OUTPUT, WEIGHTS>*>(fs[i]);
+            if ( cf == NULL || cf->size() == 0 )
+                return 1;
+            for ( typename Filter2<INPUT, OUTPUT, WEIGHTS>::fIt fit= cf->begin(); fit != cf->end(); ++fit )
+                offsets.push_back(fit->first);
+        }
+        std::sort(offsets.begin(), offsets.end());
+        offsets.erase(std::unique(offsets.begin(), offsets.end()), offsets.end());
+        min= offsets(0);
+        max= offsets(offsets.size() - 1);
+
+        weights.clear();
+        weights.resize(offsets.size()*padded, 0.0f);
+        runIndex.clear();
+        runBegin.clear();
+        runEnd.clear();
+        sizes.clear();
+        sumG.clear();
+        devF.clear();
+
+        for ( int i= 0; i < filters; ++i )
+        {
+            CCorrelationFilter2<INPUT, OUTPUT, WEIGHTS>* cf= dynamic_cast<CCorrelationFilter2<INPUT, OUTPUT, WEIGHTS>*>(fs[i]);
+
+            Vector<int> own;
+            float sum= 0;
+            for ( typename Filter2<INPUT, OUTPUT, WEIGHTS>::fIt fit= cf->begin(); fit != cf->end(); ++fit )
+            {
+                int u= std::lower_bound(offsets.begin(), offsets.end(), fit->first) - offsets.begin();
+                weights(u*padded + i)+= fit->second - cf->meanF;
+                sum+= fit->second - cf->meanF;
+                own.push_back(fit->first);
+            }
+
+            std::sort(own.begin(), own.end());
+            runIndex.push_back(runBegin.size());
+            for ( unsigned int j= 0; j < own.size(); ++j )
+                if ( j == 0 || own(j) != own(j-1) + 1 )
+                {
+                    runBegin.push_back(own(j));
+                    runEnd.push_back(own(j) + 1);
+                }
+                else
+                    runEnd(runEnd.size()-1)= own(j) + 1;
+
+            sizes.push_back(cf->size());
+            sumG.push_back(sum);
+            devF.push_back(cf->devF);
+        }
+        runIndex.push_back(runBegin.size());
+
+        return 0;
+    }
+
+    template<typename INPUT, typename OUTPUT, typename WEIGHTS>
+    void FusedCCorrelationFilterBank2<INPUT, OUTPUT, WEIGHTS>::prepare(Image<INPUT>& input)
+    {
+        prefix.resize(input.n + 1);
+        prefix2.resize(input.n + 1);
+        prefix(0)= prefix2(0)= 0;
+        for ( unsigned int i= 0; i < input.n; ++i )
+        {
+            prefix(i+1)= prefix(i) + input(i);
+            prefix2(i+1)= prefix2(i) + double(input(i))*input(i);
+        }
+    }
+
+    template<typename INPUT, typename OUTPUT, typename WEIGHTS>
+    void FusedCCorrelationFilterBank2<INPUT, OUTPUT, WEIGHTS>::apply(Image<INPUT>& input, int n, float* responses)
+    {
+        for ( int j= 0; j < padded; ++j )
+            responses[j]= 0;
+
+        const float* w= &(weights(0));
+        int taps= offsets.size();
+        for ( int u= 0; u < taps; ++u, w+= padded )
+        {
+            float v= input(n + offsets(u));
+            for ( int j= 0; j < padded; ++j )
+                responses[j]+= v*w[j];
+        }
+
+        for ( int j= 0; j < filters; ++j )
+        {
+            double sum= 0, sum2= 0;
+            for ( int r= runIndex(j); r < runIndex(j+1); ++r )
+            {
+                sum+= prefix(n + runEnd(r)) - prefix(n + runBegin(r));
+                sum2+= prefix2(n + runEnd(r)) - prefix2(n + runBegin(r));
+            }
+
+            double meanI= sum/sizes(j);
+            double variance= sum2/sizes(j) - meanI*meanI;
+            double devI= variance > 0 ? sqrt(variance*sizes(j)) : 0;
+
+            if ( fabs(devI) > FLT_EPSILON )
+                responses[j]= (responses[j] - meanI*sumG(j))/devI/devF(j);
+            else
+                responses[j]= 0;
+        }
+    }
+
+    template<typename INPUT, typename OUTPUT, typename WEIGHTS>
+    void FusedCCorrelationFilterBank2<INPUT, OUTPUT, WEIGHTS>::apply(Image<INPUT>& input, Image<OUTPUT>& output, Image<int>& direction, Image<unsigned char>* roi)
+    {
+        prepare(input);
+
+        #pragma omp parallel
+        {
+            Vector<float> responses(padded);
+
+            #pragma omp for
+            for ( int i= -min; i < int(input.n) - max; ++i )
+            {
+                if ( roi && !(*roi)(i) )
+                    continue;
+
+                apply(input, i, &(responses(0)));
+
+                int maxIdx= -1;
+                float maxValue= -FLT_MAX;
+                for ( int j= 0; j < filters; ++j )
+                    if ( responses(j) > maxValue )
+                    {
+                        maxValue= responses(j);
+                        maxIdx= j;
+                    }
+
+                output(i)= maxValue;
+                direction(i)= maxIdx;
+            }
+        }
+    }
+
+    template<typename INPUT, typename OUTPUT, typename WEIGHTS>
+    void FusedCCorrelationFilterBank2<INPUT, OUTPUT, WEIGHTS>::applyMax(Image<INPUT>& input, Image<OUTPUT>& output, Image<unsigned char>* roi)
+    {
+        prepare(input);
+        output= 0;
+
+        int range= 0.15*filters;
+
+        #pragma omp parallel
+        {
+            Vector<float> responses(padded);
+
+            #pragma omp for
+            for ( int i= -min; i < int(input.n) - max; ++i )
+            {
+                if ( roi && !(*roi)(i) )
+                    continue;
+
+                apply(input, i, &(responses(0)));
+
+                int maxIdx= 0;
+                float maxValue= -FLT_MAX;
+                for ( int j= 0; j < filters; j+= 2 )
+                    if ( responses(j) > maxValue )
+                    {
+                        maxValue= responses(j);
+                        maxIdx= j;
+                    }
+
+                for ( int j= maxIdx - range; j < maxIdx + range; ++j )
+                {
+                    int k= j;
+                    if ( j < 0 )
+                        k+= filters;
+                    if ( j >= filters )
+                        k-= filters;
+                    if ( k%2 == 1 && responses(k) > maxValue )
+                        maxValue= responses(k);
+                }
+
+                output(i)= maxValue;
+            }
+        }
+    }
+}
+
+#endif
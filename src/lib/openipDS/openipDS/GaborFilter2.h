@@ -1014,6 +1014,12 @@ namespace openip
          */
         OUTPUT apply(Image<INPUT>& input, int n, Image<unsigned char>* support= NULL);
 
+        /**
+         * the position-wise apply is overridden, the compiled evaluation of Filter2 does not apply
+         * @return 0
+         */
+        virtual int compilable() { return 0; }
+
         /**
          * the real part of the Gabor filter
          */
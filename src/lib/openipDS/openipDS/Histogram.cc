@@ -22,6 +22,9 @@ namespace openip
     : Vector<float>(h)
     {
         normalized= h.normalized;
+        min= h.min;
+        max= h.max;
+        d= h.d;
     }
 
     Histogram::Histogram(int bins)
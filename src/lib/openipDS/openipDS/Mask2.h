@@ -78,6 +78,12 @@ namespace openip
          */
         virtual OUTPUT apply(Image<INPUT>& in, int n, Image<unsigned char>* roi= NULL);
 
+        /**
+         * the position-wise apply is overridden, the compiled evaluation of Filter2 does not apply
+         * @return 0
+         */
+        virtual int compilable() { return 0; }
+
         /**
          * applies the filter
          * @param in input image
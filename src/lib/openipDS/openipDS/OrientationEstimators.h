@@ -36,6 +36,12 @@ namespace openip
          */
         OUTPUT apply(Image<INPUT>& input, int n, Image<unsigned char>* support= NULL);
 
+        /**
+         * the position-wise apply is overridden, the compiled evaluation of Filter2 does not apply
+         * @return 0
+         */
+        virtual int compilable() { return 0; }
+
         virtual int updateStride(int stride);
 
         virtual int getMin();
@@ -175,6 +181,12 @@ namespace openip
          */
         OUTPUT apply(Image<INPUT>& input, int n, Image<unsigned char>* support= NULL);
 
+        /**
+         * the position-wise apply is overridden, the compiled evaluation of Filter2 does not apply
+         * @return 0
+         */
+        virtual int compilable() { return 0; }
+
         virtual int updateStride(int stride);
 
         virtual int getMin();
@@ -328,6 +340,12 @@ namespace openip
          */
         OUTPUT apply(Image<INPUT>& input, int n, Image<unsigned char>* support= NULL);
 
+        /**
+         * the position-wise apply is overridden, the compiled evaluation of Filter2 does not apply
+         * @return 0
+         */
+        virtual int compilable() { return 0; }
+
         virtual int updateStride(int stride);
 
         virtual int getMin();
@@ -467,6 +485,12 @@ namespace openip
          */
         OUTPUT apply(Image<INPUT>& input, int n, Image<unsigned char>* support= NULL);
 
+        /**
+         * the position-wise apply is overridden, the compiled evaluation of Filter2 does not apply
+         * @return 0
+         */
+        virtual int compilable() { return 0; }
+
         virtual int updateStride(int stride);
 
         virtual int getMin();
@@ -29,6 +29,12 @@ namespace openip
 
         virtual OUTPUT apply(Image<INPUT>& input, int n, Image<unsigned char>* support);
 
+        /**
+         * the position-wise apply is overridden, the compiled evaluation of Filter2 does not apply
+         * @return 0
+         */
+        virtual int compilable() { return 0; }
+
         virtual void apply(Image<INPUT>& input, Image<OUTPUT>& output, Image<unsigned char>* roi= NULL, Image<unsigned char>* support= NULL);
 
         virtual int updateStride(int stride);
@@ -11,6 +11,7 @@
 #include <openipDS/mathFunctions.h>
 #include <openipLL/imageIO.h>
 #include <openipDS/FilterSet2.h>
+#include <openipDS/FusedCCorrelationFilterBank2.h>
 #include <openipDS/ShiftedFeatureFilter2.h>
 #include <openipDS/MatchedGaborFilter2.h>
 
@@ -620,6 +621,16 @@ namespace openip
         */
         ~MatchedCCorrelationPowerGaborFilterR2();
 
+        /**
+         * applies the filter set with the search of MaxFilterSet2, small kernels are evaluated by the fused
+         * multi-orientation evaluator, large ones in the frequency domain
+         * @param input input image
+         * @param output output image
+         * @param roi if not NULL, only the foreground (non-zero) region of the roi image is used
+         * @param support if not NULL, only the foreground (non-zero) region of the support image is used
+         */
+        virtual void apply(Image<INPUT>& input, Image<OUTPUT>& output, Image<unsigned char>* roi= NULL, Image<unsigned char>* support= NULL);
+
         void apply(Image<INPUT>& input, Image<OUTPUT>& output, Image<int>& direction, Image<unsigned char>* roi= NULL, Image<unsigned char>* support= NULL);
     };
 
@@ -656,11 +667,40 @@ namespace openip
     {
     }
 
+    template<typename INPUT, typename OUTPUT>
+    void MatchedCCorrelationPowerGaborFilterR2<INPUT, OUTPUT>::apply(Image<INPUT>& input, Image<OUTPUT>& output, Image<unsigned char>* roi, Image<unsigned char>* support)
+    {
+        this->MaxFilterSet2<INPUT, OUTPUT, float>::updateStride(input.columns);
+
+        // the orientations set to the Fourier backend are evaluated by the filter set, the automatic backend
+        // stays on the fused bank (see MaxFilterSet2::apply)
+        int fourier= 0;
+        for ( unsigned int i= 0; i < this->size(); ++i )
+        {
+            CCorrelationFilter2<INPUT, OUTPUT, float>* cf= dynamic_cast<CCorrelationFilter2<INPUT, OUTPUT, float>*>((*this)[i]);
+            if ( cf && cf->backend == CCORRELATION_BACKEND_FOURIER )
+                fourier= 1;
+        }
+
+        FusedCCorrelationFilterBank2<INPUT, OUTPUT, float> bank;
+        if ( support == NULL && !fourier && bank.compile(*this) == 0 )
+            bank.applyMax(input, output, roi);
+        else
+            this->MaxFilterSet2<INPUT, OUTPUT, float>::apply(input, output, roi, support);
+    }
+
     template<typename INPUT, typename OUTPUT>
     void MatchedCCorrelationPowerGaborFilterR2<INPUT, OUTPUT>::apply(Image<INPUT>& input, Image<OUTPUT>& output, Image<int>& direction, Image<unsigned char>* roi, Image<unsigned char>* support)
     {
         this->MaxFilterSet2<INPUT, OUTPUT, float>::updateStride(input.columns);
 
+        FusedCCorrelationFilterBank2<INPUT, OUTPUT, float> bank;
+        if ( support == NULL && bank.compile(*this) == 0 )
+        {
+            bank.apply(input, output, direction, roi);
+            return;
+        }
+
         //#pragma omp parallel for
         for ( int i= -this->getMin(); i < int(input.n) - this->getMax(); ++i )
         {
@@ -33,18 +33,23 @@ namespace openip
         virtual bool operator<=(const PriorityQueueElement& p);
 
         virtual bool operator>=(const PriorityQueueElement& p);
+
+        /** insertion order, used to break ties in the PriorityQueue */
+        unsigned long sequence;
     };
 
     template<typename PRIORITY, typename DATA>
     PriorityQueueElement<PRIORITY, DATA>::PriorityQueueElement(PRIORITY p, DATA d)
     : pair<PRIORITY, DATA>(p,d)
     {
+        sequence= 0;
     }
 
     template<typename PRIORITY, typename DATA>
     PriorityQueueElement<PRIORITY, DATA>::PriorityQueueElement(const PriorityQueueElement& p)
     : pair<PRIORITY,DATA>(p)
     {
+        sequence= p.sequence;
     }
 
     template<typename PRIORITY, typename DATA>
@@ -82,6 +87,24 @@ namespace openip
         return this->first <= p.first;
     }
 
+    /**
+     * heap order of the PriorityQueue: an element is below an other one if its priority is lower or
+     * the priorities are equal and it was inserted later
+     */
+    template<typename PRIORITY, typename DATA>
+    struct PriorityQueueBelow
+    {
+        bool operator()(const PriorityQueueElement<PRIORITY, DATA>& a, const PriorityQueueElement<PRIORITY, DATA>& b) const
+        {
+            return a.first < b.first || (!(b.first < a.first) && a.sequence > b.sequence);
+        }
+    };
+
+    /**
+     * binary max-heap, top() is the element of the highest priority, equal priorities are served in the
+     * order of insertion; the elements are stored in heap order, so the vector can be iterated, but only
+     * push and pop keep the heap valid; elements added by push_back are taken into account by init()
+     */
     template<typename PRIORITY, typename DATA>
     class PriorityQueue: public std::vector<PriorityQueueElement<PRIORITY, DATA> >
     {
@@ -113,18 +136,23 @@ namespace openip
         DATA top();
 
         PRIORITY topP();
+
+        /** sequence number of the next inserted element */
+        unsigned long sequence;
     };
 
     template<typename PRIORITY, typename DATA>
     PriorityQueue<PRIORITY, DATA>::PriorityQueue()
     : std::vector<PriorityQueueElement<PRIORITY, DATA> >()
     {
+        sequence= 0;
     }
 
     template<typename PRIORITY, typename DATA>
     PriorityQueue<PRIORITY, DATA>::PriorityQueue(const PriorityQueue& p)
     : std::vector<PriorityQueueElement<PRIORITY, DATA> >(p)
     {
+        sequence= p.sequence;
     }
 
     template<typename PRIORITY, typename DATA>
@@ -135,46 +163,214 @@ namespace openip
     template<typename PRIORITY, typename DATA>
     void PriorityQueue<PRIORITY, DATA>::init()
     {
-        std::stable_sort(this->begin(), this->end());
+        // the elements are renumbered in the order of the vector
+        sequence= 0;
+        for ( unsigned int i= 0; i < this->size(); ++i )
+            (*this)[i].sequence= sequence++;
+        std::make_heap(this->begin(), this->end(), PriorityQueueBelow<PRIORITY, DATA>());
     }
 
     template<typename PRIORITY, typename DATA>
     void PriorityQueue<PRIORITY, DATA>::push(PriorityQueueElement<PRIORITY, DATA> p)
     {
+        p.sequence= sequence++;
         this->push_back(p);
-        std::stable_sort(this->begin(), this->end());
+        std::push_heap(this->begin(), this->end(), PriorityQueueBelow<PRIORITY, DATA>());
     }
 
     template<typename PRIORITY, typename DATA>
     void PriorityQueue<PRIORITY, DATA>::push(PRIORITY p, DATA d)
     {
-        this->push_back(PriorityQueueElement<PRIORITY, DATA>(p,d));
-        std::stable_sort(this->begin(), this->end());
+        push(PriorityQueueElement<PRIORITY, DATA>(p,d));
     }
 
     template<typename PRIORITY, typename DATA>
     PriorityQueueElement<PRIORITY, DATA> PriorityQueue<PRIORITY, DATA>::topPQE()
     {
-        return this->back();
+        return this->front();
     }
 
     template<typename PRIORITY, typename DATA>
     void PriorityQueue<PRIORITY, DATA>::pop()
     {
-        this->erase(this->end()-1);
-        std::stable_sort(this->begin(), this->end());
+        std::pop_heap(this->begin(), this->end(), PriorityQueueBelow<PRIORITY, DATA>());
+        this->pop_back();
     }
 
     template<typename PRIORITY, typename DATA>
     DATA PriorityQueue<PRIORITY, DATA>::top()
     {
-        return this->back().second;
+        return this->front().second;
     }
 
     template<typename PRIORITY, typename DATA>
     PRIORITY PriorityQueue<PRIORITY, DATA>::topP()
     {
-        return this->back().first;
+        return this->front().first;
+    }
+
+    /**
+     * hierarchical (bucket) queue for integer priorities with the interface of the PriorityQueue: one FIFO
+     * bucket for each priority, top() is the first element of the highest non-empty bucket; the range of
+     * the buckets is extended on demand, push and pop take constant amortized time if the range of the
+     * priorities is small, like for unsigned char images
+     */
+    template<typename PRIORITY, typename DATA>
+    class BucketPriorityQueue
+    {
+    public:
+        BucketPriorityQueue();
+
+        /**
+         * constructor preallocating the buckets of a range of priorities
+         * @param minimum lowest expected priority
+         * @param maximum highest expected priority
+         */
+        BucketPriorityQueue(PRIORITY minimum, PRIORITY maximum);
+
+        BucketPriorityQueue(const BucketPriorityQueue& b);
+
+        ~BucketPriorityQueue();
+
+        void push(PRIORITY p, DATA d);
+
+        void pop();
+
+        DATA top();
+
+        PRIORITY topP();
+
+        unsigned int size();
+
+        void clear();
+
+    protected:
+        void extend(long p);
+
+        /** elements of the buckets, a bucket is cleared when all its elements are popped */
+        std::vector<std::vector<DATA> > buckets;
+        /** index of the first element of the buckets not yet popped */
+        std::vector<unsigned int> heads;
+        /** priority of the first bucket */
+        long offset;
+        /** index of the highest non-empty bucket */
+        int highest;
+        /** number of elements */
+        unsigned int n;
+    };
+
+    template<typename PRIORITY, typename DATA>
+    BucketPriorityQueue<PRIORITY, DATA>::BucketPriorityQueue()
+    {
+        offset= 0;
+        highest= -1;
+        n= 0;
+    }
+
+    template<typename PRIORITY, typename DATA>
+    BucketPriorityQueue<PRIORITY, DATA>::BucketPriorityQueue(PRIORITY minimum, PRIORITY maximum)
+    {
+        offset= long(minimum);
+        buckets.resize(long(maximum) - long(minimum) + 1);
+        heads.resize(buckets.size(), 0);
+        highest= -1;
+        n= 0;
+    }
+
+    template<typename PRIORITY, typename DATA>
+    BucketPriorityQueue<PRIORITY, DATA>::BucketPriorityQueue(const BucketPriorityQueue& b)
+    : buckets(b.buckets), heads(b.heads)
+    {
+        offset= b.offset;
+        highest= b.highest;
+        n= b.n;
+    }
+
+    template<typename PRIORITY, typename DATA>
+    BucketPriorityQueue<PRIORITY, DATA>::~BucketPriorityQueue()
+    {
+    }
+
+    template<typename PRIORITY, typename DATA>
+    void BucketPriorityQueue<PRIORITY, DATA>::extend(long p)
+    {
+        if ( buckets.size() == 0 )
+        {
+            offset= p;
+            buckets.resize(1);
+            heads.resize(1, 0);
+        }
+        else if ( p < offset )
+        {
+            long shift= offset - p;
+            buckets.insert(buckets.begin(), shift, std::vector<DATA>());
+            heads.insert(heads.begin(), shift, 0);
+            offset= p;
+            if ( highest >= 0 )
+                highest+= shift;
+        }
+        else if ( p - offset >= long(buckets.size()) )
+        {
+            buckets.resize(p - offset + 1);
+            heads.resize(buckets.size(), 0);
+        }
+    }
+
+    template<typename PRIORITY, typename DATA>
+    void BucketPriorityQueue<PRIORITY, DATA>::push(PRIORITY p, DATA d)
+    {
+        long q= long(p);
+        if ( buckets.size() == 0 || q < offset || q - offset >= long(buckets.size()) )
+            extend(q);
+
+        int b= int(q - offset);
+        buckets[b].push_back(d);
+        if ( b > highest )
+            highest= b;
+        ++n;
+    }
+
+    template<typename PRIORITY, typename DATA>
+    void BucketPriorityQueue<PRIORITY, DATA>::pop()
+    {
+        if ( ++heads[highest] == buckets[highest].size() )
+        {
+            buckets[highest].clear();
+            heads[highest]= 0;
+        }
+        --n;
+        while ( highest >= 0 && buckets[highest].size() == 0 )
+            --highest;
+    }
+
+    template<typename PRIORITY, typename DATA>
+    DATA BucketPriorityQueue<PRIORITY, DATA>::top()
+    {
+        return buckets[highest][heads[highest]];
+    }
+
+    template<typename PRIORITY, typename DATA>
+    PRIORITY BucketPriorityQueue<PRIORITY, DATA>::topP()
+    {
+        return PRIORITY(highest + offset);
+    }
+
+    template<typename PRIORITY, typename DATA>
+    unsigned int BucketPriorityQueue<PRIORITY, DATA>::size()
+    {
+        return n;
+    }
+
+    template<typename PRIORITY, typename DATA>
+    void BucketPriorityQueue<PRIORITY, DATA>::clear()
+    {
+        for ( unsigned int i= 0; i < buckets.size(); ++i )
+        {
+            buckets[i].clear();
+            heads[i]= 0;
+        }
+        highest= -1;
+        n= 0;
     }
 
     template<typename DATA>
@@ -0,0 +1,190 @@
+#include <openipDS/Profiler.h>
+
+#include <algorithm>
+#include <set>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+namespace openip
+{
+    Profiler profiler;
+
+    /** statistics of the spans of the same category and name */
+    struct ProfilerSummaryRow
+    {
+        std::string category;
+        std::string name;
+        int calls;
+        double total;
+        double maximum;
+    };
+
+    static bool profilerSummaryRowGreater(const ProfilerSummaryRow& a, const ProfilerSummaryRow& b)
+    {
+        return a.total > b.total;
+    }
+
+    static void profilerWriteString(FILE* f, const char* s)
+    {
+        fputc('"', f);
+        for ( ; *s; ++s )
+        {
+            if ( *s == '"' || *s == '\\' )
+                fputc('\\', f);
+            fputc(*s, f);
+        }
+        fputc('"', f);
+    }
+
+    Profiler::Profiler()
+    {
+        enabled= 0;
+        origin= 0;
+        omp_init_lock(&lock);
+    }
+
+    Profiler::~Profiler()
+    {
+        omp_destroy_lock(&lock);
+    }
+
+    void Profiler::enable()
+    {
+        origin= omp_get_wtime();
+        enabled= 1;
+    }
+
+    double Profiler::now()
+    {
+        return (omp_get_wtime() - origin)*1000000.0;
+    }
+
+    void Profiler::record(ProfilerEvent& e)
+    {
+        e.thread= syscall(SYS_gettid);
+        omp_set_lock(&lock);
+        events.push_back(e);
+        omp_unset_lock(&lock);
+    }
+
+    void Profiler::count(const char* name, double value)
+    {
+        if ( !enabled )
+            return;
+
+        ProfilerEvent e;
+        e.category= "counter";
+        e.name= name;
+        e.phase= 'C';
+        e.duration= 0;
+        e.nargs= 1;
+        e.keys[0]= "value";
+        e.thread= syscall(SYS_gettid);
+
+        omp_set_lock(&lock);
+        e.begin= now();
+        e.values[0]= (counters[name]+= value);
+        events.push_back(e);
+        omp_unset_lock(&lock);
+    }
+
+    int Profiler::write(const char* filename)
+    {
+        FILE* f= fopen(filename, "w");
+        if ( f == NULL )
+            return 1;
+
+        int pid= getpid();
+        std::set<int> threads;
+
+        omp_set_lock(&lock);
+        fprintf(f, "{\"traceEvents\":[\n");
+        for ( unsigned int i= 0; i < events.size(); ++i )
+        {
+            ProfilerEvent& e= events[i];
+            threads.insert(e.thread);
+            fprintf(f, "{\"name\":");
+            profilerWriteString(f, e.name);
+            fprintf(f, ",\"cat\":");
+            profilerWriteString(f, e.category);
+            fprintf(f, ",\"ph\":\"%c\",\"ts\":%.3f,", e.phase, e.begin);
+            if ( e.phase == 'X' )
+                fprintf(f, "\"dur\":%.3f,", e.duration);
+            fprintf(f, "\"pid\":%d,\"tid\":%d,\"args\":{", pid, e.thread);
+            for ( int j= 0; j < e.nargs; ++j )
+            {
+                if ( j > 0 )
+                    fputc(',', f);
+                profilerWriteString(f, e.keys[j]);
+                fprintf(f, ":%.17g", e.values[j]);
+            }
+            fprintf(f, "}},\n");
+        }
+        omp_unset_lock(&lock);
+
+        for ( std::set<int>::iterator it= threads.begin(); it != threads.end(); ++it )
+        {
+            fprintf(f, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":", pid, *it);
+            if ( *it == pid )
+                fprintf(f, "\"main\"");
+            else
+                fprintf(f, "\"thread %d\"", *it);
+            fprintf(f, "}},\n");
+        }
+        fprintf(f, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"vessel\"}}\n", pid, pid);
+        fprintf(f, "],\"displayTimeUnit\":\"ms\"}\n");
+
+        int result= ferror(f);
+        fclose(f);
+
+        return result;
+    }
+
+    void Profiler::summary(FILE* f)
+    {
+        std::map<std::pair<std::string, std::string>, ProfilerSummaryRow> groups;
+
+        omp_set_lock(&lock);
+        for ( unsigned int i= 0; i < events.size(); ++i )
+        {
+            ProfilerEvent& e= events[i];
+            if ( e.phase != 'X' )
+                continue;
+            std::pair<std::string, std::string> key(e.category, e.name);
+            std::map<std::pair<std::string, std::string>, ProfilerSummaryRow>::iterator it= groups.find(key);
+            if ( it == groups.end() )
+            {
+                ProfilerSummaryRow r;
+                r.category= e.category;
+                r.name= e.name;
+                r.calls= 0;
+                r.total= 0;
+                r.maximum= 0;
+                it= groups.insert(std::make_pair(key, r)).first;
+            }
+            it->second.calls++;
+            it->second.total+= e.duration;
+            if ( e.duration > it->second.maximum )
+                it->second.maximum= e.duration;
+        }
+        std::map<std::string, double> totals= counters;
+        omp_unset_lock(&lock);
+
+        std::vector<ProfilerSummaryRow> rows;
+        for ( std::map<std::pair<std::string, std::string>, ProfilerSummaryRow>::iterator it= groups.begin(); it != groups.end(); ++it )
+            rows.push_back(it->second);
+        std::sort(rows.begin(), rows.end(), profilerSummaryRowGreater);
+
+        fprintf(f, "%-16s %-32s %10s %14s %12s %12s\n", "category", "name", "calls", "total ms", "mean ms", "max ms");
+        for ( unsigned int i= 0; i < rows.size(); ++i )
+            fprintf(f, "%-16s %-32s %10d %14.3f %12.3f %12.3f\n", rows[i].category.c_str(), rows[i].name.c_str(), rows[i].calls,
+                    rows[i].total/1000.0, rows[i].total/1000.0/rows[i].calls, rows[i].maximum/1000.0);
+
+        if ( !totals.empty() )
+        {
+            fprintf(f, "%-49s %14s\n", "counter", "total");
+            for ( std::map<std::string, double>::iterator it= totals.begin(); it != totals.end(); ++it )
+                fprintf(f, "%-49s %14.0f\n", it->first.c_str(), it->second);
+        }
+    }
+}
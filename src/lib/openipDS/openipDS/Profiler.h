@@ -0,0 +1,199 @@
+/**
+ * @file Profiler.h
+ * @author Gyorgy Kovacs <gyuriofkovacs@gmail.com>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * http://www.gnu.org/copyleft/gpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * The Profiler records timed spans and counters of a run. The spans are
+ * usually recorded by ProfilerScope objects, which measure the lifetime of
+ * a block by omp_get_wtime, like StopperOpenMP. The records can be written
+ * as a Chrome trace (JSON, readable by chrome://tracing and Perfetto) and
+ * summarized as a table. The profiler is disabled by default, then a
+ * ProfilerScope costs a single test.
+ */
+
+#ifndef _PROFILER_H_
+#define _PROFILER_H_
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <map>
+
+#include <omp.h>
+
+namespace openip
+{
+    /** maximum number of numeric arguments of a span */
+    #define PROFILER_MAX_ARGS 3
+
+    /**
+     * a recorded span or counter sample
+     */
+    struct ProfilerEvent
+    {
+        /** category of the event, a string literal */
+        const char* category;
+        /** name of the event, a string literal */
+        const char* name;
+        /** 'X' for spans, 'C' for counter samples */
+        char phase;
+        /** start time in microseconds since the profiler was enabled */
+        double begin;
+        /** duration in microseconds */
+        double duration;
+        /** id of the thread recording the event */
+        int thread;
+        /** number of arguments */
+        int nargs;
+        /** names of the arguments, string literals */
+        const char* keys[PROFILER_MAX_ARGS];
+        /** values of the arguments */
+        double values[PROFILER_MAX_ARGS];
+    };
+
+    /**
+     * collects the spans and counters of a run
+     */
+    class Profiler
+    {
+    public:
+        /**
+         * default constructor, the profiler is disabled
+         */
+        Profiler();
+
+        /**
+         * destructor
+         */
+        ~Profiler();
+
+        /**
+         * enables the profiler, the time is measured from this call
+         */
+        void enable();
+
+        /**
+         * current time
+         * @return microseconds elapsed since the profiler was enabled
+         */
+        double now();
+
+        /**
+         * records an event, it can be called from any thread
+         * @param e the event, the thread id is filled in
+         */
+        void record(ProfilerEvent& e);
+
+        /**
+         * increments a counter, the total is recorded as a counter sample
+         * @param name name of the counter, a string literal
+         * @param value increment
+         */
+        void count(const char* name, double value);
+
+        /**
+         * writes the recorded events in Chrome trace format
+         * @param filename output file
+         * @return 0 on success, non-zero if the file can not be written
+         */
+        int write(const char* filename);
+
+        /**
+         * prints the number of calls, the total, mean and maximum time of the spans grouped by
+         * category and name, sorted by the total time, and the totals of the counters
+         * @param f output stream
+         */
+        void summary(FILE* f= stdout);
+
+        /** 1 if the profiler records events, 0 otherwise */
+        int enabled;
+
+    protected:
+        /** recorded events */
+        std::vector<ProfilerEvent> events;
+        /** totals of the counters */
+        std::map<std::string, double> counters;
+        /** time of enabling, in seconds */
+        double origin;
+        /** lock serializing the recording threads */
+        omp_lock_t lock;
+    };
+
+    /** the profiler of the process */
+    extern Profiler profiler;
+
+    /**
+     * records the lifetime of a block as a span of the profiler
+     */
+    class ProfilerScope
+    {
+    public:
+        /**
+         * starts the span if the profiler is enabled
+         * @param category category of the span, a string literal
+         * @param name name of the span, a string literal
+         */
+        ProfilerScope(const char* category, const char* name)
+        {
+            active= profiler.enabled;
+            if ( active )
+            {
+                e.category= category;
+                e.name= name;
+                e.phase= 'X';
+                e.nargs= 0;
+                e.begin= profiler.now();
+            }
+        }
+
+        /**
+         * finishes and records the span
+         */
+        ~ProfilerScope()
+        {
+            if ( active )
+            {
+                e.duration= profiler.now() - e.begin;
+                profiler.record(e);
+            }
+        }
+
+        /**
+         * attaches a numeric argument to the span, at most PROFILER_MAX_ARGS are kept
+         * @param key name of the argument, a string literal
+         * @param value value of the argument
+         */
+        void arg(const char* key, double value)
+        {
+            if ( active && e.nargs < PROFILER_MAX_ARGS )
+            {
+                e.keys[e.nargs]= key;
+                e.values[e.nargs]= value;
+                ++e.nargs;
+            }
+        }
+
+    protected:
+        /** 1 if the span is recorded */
+        int active;
+        /** the span being measured */
+        ProfilerEvent e;
+    };
+}
+
+#endif
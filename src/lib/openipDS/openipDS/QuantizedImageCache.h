@@ -0,0 +1,268 @@
+/**
+ * @file QuantizedImageCache.h
+ * @author Gyorgy Kovacs <gyuriofkovacs@gmail.com>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * http://www.gnu.org/copyleft/gpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * The QuantizedImageCache holds float images in memory in a compact form
+ * bounded by a memory budget. The values are stored as 16-bit fixed point
+ * numbers relative to the maximum absolute value of the image. If all the
+ * pixels outside a mask are zero, only the pixels of the mask are stored.
+ * Images that would exceed the budget are not stored.
+ */
+
+#ifndef _QUANTIZED_IMAGE_CACHE_H_
+#define _QUANTIZED_IMAGE_CACHE_H_
+
+#include <math.h>
+
+#include <openipDS/Image.h>
+#include <openipDS/Vector.h>
+
+namespace openip
+{
+    /**
+     * element of the QuantizedImageCache
+     */
+    struct QuantizedImageCacheEntry
+    {
+        /** quantized values */
+        Vector<short> quantized;
+        /** values, if the entry is not quantized */
+        Vector<float> values;
+        /** the values are quantized[i]*scale */
+        float scale;
+        /** 1 if only the pixels of the mask are stored */
+        int compact;
+        /** number of pixels of the image */
+        int n;
+        /** 1 if the entry holds an image */
+        int valid;
+    };
+
+    /**
+     * indexed cache of float images with a memory budget
+     */
+    class QuantizedImageCache
+    {
+    public:
+        /**
+         * default constructor, the budget is unlimited and the images are quantized
+         */
+        QuantizedImageCache();
+
+        /**
+         * sets the number of slots, the content of the remaining slots is kept
+         * @param n number of slots
+         */
+        void resize(int n);
+
+        /**
+         * number of slots
+         * @return the number of slots
+         */
+        unsigned int size();
+
+        /**
+         * sets the parameters of the cache, the images already stored are not affected
+         * @param budget maximum number of bytes used by the stored images, negative for unlimited
+         * @param quantize 1 to store 16-bit fixed point values, 0 to store floats
+         */
+        void setBudget(long long budget, int quantize= 1);
+
+        /**
+         * tests if a slot holds an image
+         * @param k index of the slot
+         * @return 1 if the slot holds an image, 0 otherwise
+         */
+        int contains(int k);
+
+        /**
+         * restores an image
+         * @param k index of the slot
+         * @param image output parameter, it has to be resized to the size of the stored image in advance
+         * @param mask the mask used when the image was stored
+         * @return 0 if the image was restored, non-zero otherwise
+         */
+        int get(int k, Image<float>& image, Image<unsigned char>* mask= NULL);
+
+        /**
+         * stores an image, the previous content of the slot is replaced
+         * @param k index of the slot
+         * @param image image to store
+         * @param mask if all the pixels outside the foreground of the mask are zero, only the foreground is stored
+         * @return 0 if the image was stored, non-zero if it would exceed the budget, then the slot becomes empty
+         */
+        int put(int k, Image<float>& image, Image<unsigned char>* mask= NULL);
+
+        /**
+         * removes all the slots and images
+         */
+        void clear();
+
+        /** maximum number of bytes, negative for unlimited */
+        long long budget;
+        /** number of bytes used */
+        long long used;
+        /** 1 if the images are quantized */
+        int quantize;
+
+    protected:
+        /**
+         * number of bytes used by an entry
+         * @param e entry
+         * @return the number of bytes
+         */
+        long long bytes(QuantizedImageCacheEntry& e);
+
+        /** slots of the cache */
+        Vector<QuantizedImageCacheEntry> entries;
+    };
+
+    inline QuantizedImageCache::QuantizedImageCache()
+    {
+        budget= -1;
+        used= 0;
+        quantize= 1;
+    }
+
+    inline void QuantizedImageCache::resize(int n)
+    {
+        QuantizedImageCacheEntry e;
+        e.scale= 0;
+        e.compact= 0;
+        e.n= 0;
+        e.valid= 0;
+        entries.resize(n, e);
+    }
+
+    inline unsigned int QuantizedImageCache::size()
+    {
+        return entries.size();
+    }
+
+    inline void QuantizedImageCache::setBudget(long long budget, int quantize)
+    {
+        this->budget= budget;
+        this->quantize= quantize;
+    }
+
+    inline int QuantizedImageCache::contains(int k)
+    {
+        return entries(k).valid;
+    }
+
+    inline long long QuantizedImageCache::bytes(QuantizedImageCacheEntry& e)
+    {
+        return (long long)(e.quantized.size())*sizeof(short) + (long long)(e.values.size())*sizeof(float);
+    }
+
+    inline int QuantizedImageCache::get(int k, Image<float>& image, Image<unsigned char>* mask)
+    {
+        QuantizedImageCacheEntry& e= entries(k);
+        if ( !e.valid || e.n != int(image.n) || (e.compact && (mask == NULL || mask->n != image.n)) )
+            return 1;
+
+        if ( e.compact )
+            image= 0;
+
+        int j= 0;
+        for ( unsigned int i= 0; i < image.n; ++i )
+        {
+            if ( e.compact && !(*mask)(i) )
+                continue;
+            image(i)= e.values.size() ? e.values(j) : e.quantized(j)*e.scale;
+            ++j;
+        }
+
+        return 0;
+    }
+
+    inline int QuantizedImageCache::put(int k, Image<float>& image, Image<unsigned char>* mask)
+    {
+        QuantizedImageCacheEntry e;
+        e.n= image.n;
+        e.valid= 1;
+        e.compact= (mask != NULL && mask->n == image.n);
+
+        int count= 0;
+        float maximum= 0;
+        for ( unsigned int i= 0; i < image.n; ++i )
+        {
+            if ( e.compact && !(*mask)(i) && image(i) != 0 )
+                e.compact= 0;
+            if ( fabs(image(i)) > maximum )
+                maximum= fabs(image(i));
+        }
+        for ( unsigned int i= 0; i < image.n; ++i )
+            if ( !e.compact || (*mask)(i) )
+                ++count;
+
+        long long required= (long long)(count)*(quantize ? sizeof(short) : sizeof(float));
+        int fits;
+        #pragma omp critical (quantizedImageCache)
+        {
+            long long released= bytes(entries(k));
+            fits= budget < 0 || used - released + required <= budget;
+            used+= (fits ? required : 0) - released;
+        }
+        if ( !fits )
+        {
+            QuantizedImageCacheEntry& t= entries(k);
+            Vector<short>().swap(t.quantized);
+            Vector<float>().swap(t.values);
+            t.valid= 0;
+            return 1;
+        }
+
+        e.scale= maximum > 0 ? maximum/32767 : 1;
+        if ( quantize )
+            e.quantized.resize(count);
+        else
+            e.values.resize(count);
+
+        int j= 0;
+        for ( unsigned int i= 0; i < image.n; ++i )
+        {
+            if ( e.compact && !(*mask)(i) )
+                continue;
+            if ( quantize )
+                e.quantized(j)= short(floor(image(i)/e.scale + 0.5f));
+            else
+                e.values(j)= image(i);
+            ++j;
+        }
+
+        QuantizedImageCacheEntry& t= entries(k);
+        t.quantized.swap(e.quantized);
+        t.values.swap(e.values);
+        t.scale= e.scale;
+        t.compact= e.compact;
+        t.n= e.n;
+        t.valid= 1;
+
+        return 0;
+    }
+
+    inline void QuantizedImageCache::clear()
+    {
+        entries.clear();
+        used= 0;
+    }
+}
+
+#endif
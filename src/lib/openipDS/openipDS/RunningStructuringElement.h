@@ -28,6 +28,9 @@
 #include <openipDS/StructuringElement2.h>
 #include <openipDS/PixelSet1.h>
 
+/** number of rows in the strips of the parallel sweeps, independent of the number of threads */
+#define RUNNING_STRUCTURING_ELEMENT_STRIP_ROWS 32
+
 namespace openip
 {
     /**
@@ -80,6 +83,27 @@ namespace openip
          */
         void initFronts(StructuringElement2* se);
 
+        /**
+         * number of strips the positions [begin, end) are split into for parallel
+         * processing, the strips consist of RUNNING_STRUCTURING_ELEMENT_STRIP_ROWS rows,
+         * thus the partition does not depend on the number of threads
+         * @return number of strips
+         */
+        int numberOfStrips();
+
+        /**
+         * initializes the running structuring element in the first position of a strip;
+         * the positions [begin, end) are split at row boundaries into strips of
+         * RUNNING_STRUCTURING_ELEMENT_STRIP_ROWS rows, each strip can be processed by a copy
+         * of the running structuring element in a different thread, sliding by next() from
+         * first to last - 1
+         * @param strip index of the strip
+         * @param strips number of strips
+         * @param first the first position of the strip
+         * @param last the first position after the strip
+         */
+        void initStrip(int strip, int strips, int& first, int& last);
+
         virtual double value();
 
         /**
@@ -186,11 +210,67 @@ namespace openip
         position= p;
     }
 
+    template<typename INPUT>
+    int RunningStructuringElement<INPUT>::numberOfStrips()
+    {
+        if ( end <= begin )
+            return 1;
+
+        int rows= (end - 1)/input->columns - begin/input->columns + 1;
+
+        return (rows + RUNNING_STRUCTURING_ELEMENT_STRIP_ROWS - 1)/RUNNING_STRUCTURING_ELEMENT_STRIP_ROWS;
+    }
+
+    template<typename INPUT>
+    void RunningStructuringElement<INPUT>::initStrip(int strip, int strips, int& first, int& last)
+    {
+        int columns= input->columns;
+        int firstRow= begin/columns;
+
+        first= (firstRow + strip*RUNNING_STRUCTURING_ELEMENT_STRIP_ROWS)*columns;
+        last= first + RUNNING_STRUCTURING_ELEMENT_STRIP_ROWS*columns;
+        if ( first < begin )
+            first= begin;
+        if ( last > end || strip == strips - 1 )
+            last= end;
+
+        if ( first < last )
+            init(first);
+        else
+            first= last;
+    }
+
     template<typename INPUT>
     double RunningStructuringElement<INPUT>::value()
     {
         return 0.0;
     }
+
+    /**
+     * sweeps an initialized running structuring element through the positions [begin, end) in
+     * parallel strips, each strip by its own copy of the element
+     * @param rse running structuring element initialized by init(input, support)
+     * @param f functor, f(i, r) is called in each position i with the copy r being in position i
+     */
+    template<typename RUNNING_ELEMENT, typename FUNCTOR>
+    void sweepStrips(RUNNING_ELEMENT& rse, FUNCTOR& f)
+    {
+        int strips= rse.numberOfStrips();
+
+        #pragma omp parallel for
+        for ( int s= 0; s < strips; ++s )
+        {
+            RUNNING_ELEMENT r(rse);
+            int first, last;
+            r.initStrip(s, strips, first, last);
+            for ( int i= first; i < last; ++i )
+            {
+                f(i, r);
+                if ( i < last - 1 )
+                    r.next();
+            }
+        }
+    }
 }
 
 #endif	/* _RUNNINGSTRUCTURINGELEMENT_H */
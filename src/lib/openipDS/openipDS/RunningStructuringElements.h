@@ -24,6 +24,8 @@
 #ifndef _RUNNINGSTRUCTURINGELEMENTS_H
 #define	_RUNNINGSTRUCTURINGELEMENTS_H
 
+#include <limits>
+
 #include <openipDS/RunningStructuringElement.h>
 #include <openipDS/StructuringElement2s.h>
 #include <openipDS/Histogram.h>
@@ -194,6 +196,14 @@ namespace openip
          */
         void next();
 
+        /**
+         * initializes the running structuring element by setting the input and
+         * support images, the range of the histogram is set to the range of the input
+         * @param input input image
+         * @param support support image, NULL if not used
+         */
+        void init(Image<INPUT>* input, Image<unsigned char>* support= NULL);
+
         /**
          * initializes in position p
          */
@@ -210,6 +220,12 @@ namespace openip
          * size of the elements
          */
         int size;
+
+    protected:
+        /**
+         * bin indices of the 256 values of 8 bit unsigned images, empty for other types
+         */
+        Vector<int> bins;
     };
 
     /**
@@ -421,6 +437,146 @@ namespace openip
         INPUT max;
     };
 
+    /**
+     * RunningStructuringElementMoments maintains the power sums of the intensities
+     * (sum of (x - shift)^k, k= 0..4) and the raw spatial moments (sum of c^p r^q x, p+q <= 3,
+     * c and r being the coordinates relative to the center) of the elements covered
+     * by the structuring element, in running style: moving to the next pixel only the
+     * left and right fronts are updated and the spatial moments are shifted by the
+     * binomial theorem. The shift is the mean of the elements at the initialization
+     * (rounded for integer images), thus the central sums do not cancel. The sums are
+     * accumulated in double precision, for integer images they are exact; for other
+     * images the sums are recomputed around the new mean whenever the mean has drifted
+     * from the shift by more than the standard deviation.
+     */
+    template<typename INPUT>
+    class RunningStructuringElementMoments: public RunningStructuringElement<INPUT>
+    {
+    public:
+        using RunningStructuringElement<INPUT>::position;
+        using RunningStructuringElement<INPUT>::input;
+        using RunningStructuringElement<INPUT>::leftFront;
+        using RunningStructuringElement<INPUT>::rightFront;
+        using RunningStructuringElement<INPUT>::se;
+        using RunningStructuringElement<INPUT>::support;
+        using RunningStructuringElement<INPUT>::begin;
+        using RunningStructuringElement<INPUT>::end;
+        using RunningStructuringElement<INPUT>::initFronts;
+
+        /**
+         * constructor, se defines the shape of the structuring element
+         * @param se base structuring element, defining the shape
+         * @param intensityOrder the power sums are maintained up to this order (0..4), -1 if not used
+         * @param spatialOrder the raw spatial moments are maintained up to this order (0..3), -1 if not used
+         */
+        RunningStructuringElementMoments(StructuringElement2 se, int intensityOrder= 2, int spatialOrder= -1);
+
+        /**
+         * copy constructor
+         * @param rse instance to copy
+         */
+        RunningStructuringElementMoments(const RunningStructuringElementMoments& rse);
+
+        /**
+         * destructor
+         */
+        ~RunningStructuringElementMoments();
+
+        /**
+         * initializes the running structuring element by setting the
+         * input and support images
+         * @param input input image
+         * @param support only the foreground (non-zero) pixels of the support are taken into account, NULL if not used
+         */
+        void init(Image<INPUT>* input, Image<unsigned char>* support= NULL);
+
+        /**
+         * initializes the structuring element in position p
+         * @param p position in row-continuous representation
+         */
+        void init(int p);
+
+        /**
+         * updates the sums by moving to the next pixel
+         */
+        void next();
+
+        /**
+         * moves the structuring element to the position p, by running or by
+         * initializing, whichever is cheaper
+         * @param p position in row-continuous representation, p >= position
+         */
+        void moveTo(int p);
+
+        /**
+         * returns the mean of the elements
+         * @return the mean
+         */
+        virtual double value();
+
+        /**
+         * mean of the elements, 0/0 for empty sets, like PixelSet::getMean
+         * @return the mean
+         */
+        double mean();
+
+        /**
+         * sum of the k-th powers of the deviations from the mean, computed from the power sums,
+         * the even sums are not negative
+         * @param k the power, 2 <= k <= intensityOrder
+         * @return the central power sum
+         */
+        double centralPowerSum(int k);
+
+        /**
+         * spatial moment of order (p, q) around the point (c, r)
+         * @param p power of the column coordinates
+         * @param q power of the row coordinates
+         * @param c column coordinate of the reference point
+         * @param r row coordinate of the reference point
+         * @return the sum of (column - c)^p (row - r)^q x
+         */
+        double spatialMoment(int p, int q, double c, double r);
+
+        /** power sums, powerSum[k] is the sum of (x - shift)^k, powerSum[0] is the number of elements */
+        double powerSum[5];
+
+        /** the intensities are shifted by this value in the power sums */
+        double shift;
+
+        /** raw spatial moments, moment[p][q] is the sum of column^p row^q x */
+        double moment[4][4];
+
+        /** the order of the power sums maintained */
+        int intensityOrder;
+
+        /** the order of the spatial moments maintained */
+        int spatialOrder;
+
+    protected:
+        /**
+         * adds an element to the sums
+         * @param x the value of the element
+         * @param sign 1 for adding, -1 for removing
+         * @param c column coordinate relative to the center
+         * @param r row coordinate relative to the center
+         */
+        void accumulate(double x, double sign, int c, int r);
+
+        /** column coordinates of the elements of se */
+        Vector<int> columns;
+        /** row coordinates of the elements of se */
+        Vector<int> rows;
+        /** column coordinates of the left front relative to the current center */
+        Vector<int> leftColumns;
+        /** row coordinates of the left front */
+        Vector<int> leftRows;
+        /** column coordinates of the right front relative to the next center */
+        Vector<int> rightColumns;
+        /** row coordinates of the right front */
+        Vector<int> rightRows;
+    };
+
     template<typename INPUT>
     RunningStructuringElementHistogram<INPUT>::RunningStructuringElementHistogram(StructuringElement2 se, int numberOfBins)
     : RunningStructuringElement<INPUT>(se), size(se.size())
@@ -430,7 +586,7 @@ namespace openip
 
     template<typename INPUT>
     RunningStructuringElementHistogram<INPUT>::RunningStructuringElementHistogram(const RunningStructuringElementHistogram& rseh)
-    : RunningStructuringElement<INPUT>(rseh), h(rseh.h), size(rseh.size)
+    : RunningStructuringElement<INPUT>(rseh), h(rseh.h), size(rseh.size), bins(rseh.bins)
     {
     }
 
@@ -446,12 +602,30 @@ namespace openip
     }
 
     template<typename INPUT>
-    void RunningStructuringElementHistogram<INPUT>::init(int p)
+    void RunningStructuringElementHistogram<INPUT>::init(Image<INPUT>* input, Image<unsigned char>* support)
     {
+        this->input= input;
+        this->support= support;
+
         h.clear();
         INPUT min, max;
-        input->getMinMax(min, max, this->support);
+        input->getMinMax(min, max, support);
         h.setParameters(min, max, this->size);
+
+        bins.clear();
+        if ( std::numeric_limits<INPUT>::is_integer && !std::numeric_limits<INPUT>::is_signed && sizeof(INPUT) == 1 )
+        {
+            bins.resize(256);
+            for ( int i= 0; i < 256; ++i )
+                bins(i)= h.getIndex((INPUT)i);
+        }
+
+        RunningStructuringElement<INPUT>::init(input, support);
+    }
+
+    template<typename INPUT>
+    void RunningStructuringElementHistogram<INPUT>::init(int p)
+    {
         h= 0;
 
         if ( support == NULL )
@@ -480,7 +654,28 @@ namespace openip
     template<typename INPUT>
     void RunningStructuringElementHistogram<INPUT>::next()
     {
-        if ( support == NULL )
+        if ( support == NULL && bins.size() == 256 && leftFront.size() == rightFront.size() )
+        {
+            // 8 bit images: the bin indices are looked up, the leaving and entering
+            // pixels are processed in pairs and the pairs falling in the same bin are skipped
+            const INPUT* data= &((*input)(position));
+            const int* lut= &(bins(0));
+            const int* left= &(leftFront(0));
+            const int* right= &(rightFront(0));
+            float* hist= &(h(0));
+            int n= leftFront.size();
+            for ( int k= 0; k < n; ++k )
+            {
+                int out= lut[(int)(data[left[k]])];
+                int in= lut[(int)(data[right[k]])];
+                if ( out != in )
+                {
+                    hist[out]-= 1;
+                    hist[in]+= 1;
+                }
+            }
+        }
+        else if ( support == NULL )
         {
             PixelSet1::iterator pit;
             for ( pit= leftFront.begin(); pit != leftFront.end(); ++pit )
@@ -1243,6 +1438,231 @@ namespace openip
 
         position= p;
     }
+
+    template<typename INPUT>
+    RunningStructuringElementMoments<INPUT>::RunningStructuringElementMoments(StructuringElement2 se, int intensityOrder, int spatialOrder)
+    : RunningStructuringElement<INPUT>(se)
+    {
+        this->intensityOrder= intensityOrder;
+        this->spatialOrder= spatialOrder;
+        this->shift= 0;
+        for ( int k= 0; k < 5; ++k )
+            powerSum[k]= 0;
+        for ( int a= 0; a < 4; ++a )
+            for ( int b= 0; b < 4; ++b )
+                moment[a][b]= 0;
+    }
+
+    template<typename INPUT>
+    RunningStructuringElementMoments<INPUT>::RunningStructuringElementMoments(const RunningStructuringElementMoments& rsem)
+    : RunningStructuringElement<INPUT>(rsem), shift(rsem.shift), intensityOrder(rsem.intensityOrder), spatialOrder(rsem.spatialOrder),
+      columns(rsem.columns), rows(rsem.rows), leftColumns(rsem.leftColumns), leftRows(rsem.leftRows), rightColumns(rsem.rightColumns), rightRows(rsem.rightRows)
+    {
+        for ( int k= 0; k < 5; ++k )
+            powerSum[k]= rsem.powerSum[k];
+        for ( int a= 0; a < 4; ++a )
+            for ( int b= 0; b < 4; ++b )
+                moment[a][b]= rsem.moment[a][b];
+    }
+
+    template<typename INPUT>
+    RunningStructuringElementMoments<INPUT>::~RunningStructuringElementMoments()
+    {
+    }
+
+    template<typename INPUT>
+    void RunningStructuringElementMoments<INPUT>::init(Image<INPUT>* input, Image<unsigned char>* support)
+    {
+        this->input= input;
+        this->support= support;
+
+        this->se.updateStride(input->columns);
+        initFronts(&(this->se));
+
+        begin= -this->se.getMin();
+        end= input->n - this->se.getMax();
+
+        int r, c;
+        columns.clear();
+        rows.clear();
+        for ( unsigned int i= 0; i < se.size(); ++i )
+        {
+            se.getXY(se(i), r, c);
+            columns.push_back(c);
+            rows.push_back(r);
+        }
+        leftColumns.clear();
+        leftRows.clear();
+        for ( unsigned int i= 0; i < leftFront.size(); ++i )
+        {
+            se.getXY(leftFront(i), r, c);
+            leftColumns.push_back(c);
+            leftRows.push_back(r);
+        }
+        rightColumns.clear();
+        rightRows.clear();
+        for ( unsigned int i= 0; i < rightFront.size(); ++i )
+        {
+            se.getXY(rightFront(i) - 1, r, c);
+            rightColumns.push_back(c);
+            rightRows.push_back(r);
+        }
+
+        if ( begin < end )
+            init(begin);
+    }
+
+    template<typename INPUT>
+    void RunningStructuringElementMoments<INPUT>::accumulate(double x, double sign, int c, int r)
+    {
+        double t;
+        if ( intensityOrder >= 0 )
+        {
+            t= sign;
+            for ( int k= 0; k <= intensityOrder; ++k )
+            {
+                powerSum[k]+= t;
+                t*= x - shift;
+            }
+        }
+        if ( spatialOrder >= 0 )
+        {
+            double cp= sign*x;
+            for ( int a= 0; a <= spatialOrder; ++a )
+            {
+                t= cp;
+                for ( int b= 0; a + b <= spatialOrder; ++b )
+                {
+                    moment[a][b]+= t;
+                    t*= r;
+                }
+                cp*= c;
+            }
+        }
+    }
+
+    template<typename INPUT>
+    void RunningStructuringElementMoments<INPUT>::init(int p)
+    {
+        for ( int k= 0; k < 5; ++k )
+            powerSum[k]= 0;
+        for ( int a= 0; a < 4; ++a )
+            for ( int b= 0; b < 4; ++b )
+                moment[a][b]= 0;
+
+        shift= 0;
+        if ( intensityOrder >= 1 )
+        {
+            double sum= 0;
+            int n= 0;
+            for ( unsigned int i= 0; i < se.size(); ++i )
+                if ( support == NULL || (*support)(p + se(i)) > 0 )
+                {
+                    sum+= (*input)(p + se(i));
+                    ++n;
+                }
+            if ( n > 0 )
+                shift= std::numeric_limits<INPUT>::is_integer ? floor(sum/n + 0.5) : sum/n;
+        }
+
+        for ( unsigned int i= 0; i < se.size(); ++i )
+            if ( support == NULL || (*support)(p + se(i)) > 0 )
+                accumulate((*input)(p + se(i)), 1, columns(i), rows(i));
+
+        position= p;
+    }
+
+    template<typename INPUT>
+    void RunningStructuringElementMoments<INPUT>::next()
+    {
+        for ( unsigned int i= 0; i < leftFront.size(); ++i )
+            if ( support == NULL || (*support)(position + leftFront(i)) > 0 )
+                accumulate((*input)(position + leftFront(i)), -1, leftColumns(i), leftRows(i));
+
+        // the column coordinates of the remaining elements decrease by one: (c - 1)^a expanded
+        for ( int a= spatialOrder; a >= 1; --a )
+            for ( int b= 0; a + b <= spatialOrder; ++b )
+            {
+                double binomial= 1, sign= -1;
+                for ( int j= a - 1; j >= 0; --j )
+                {
+                    binomial= binomial*(j + 1)/(a - j);
+                    moment[a][b]+= sign*binomial*moment[j][b];
+                    sign= -sign;
+                }
+            }
+
+        for ( unsigned int i= 0; i < rightFront.size(); ++i )
+            if ( support == NULL || (*support)(position + rightFront(i)) > 0 )
+                accumulate((*input)(position + rightFront(i)), 1, rightColumns(i), rightRows(i));
+
+        ++position;
+
+        if ( !std::numeric_limits<INPUT>::is_integer && intensityOrder >= 2 && powerSum[0] > 0 )
+        {
+            double d= powerSum[1]/powerSum[0];
+            if ( 2*d*d > powerSum[2]/powerSum[0] )
+                init(position);
+        }
+    }
+
+    template<typename INPUT>
+    void RunningStructuringElementMoments<INPUT>::moveTo(int p)
+    {
+        if ( (p - position) * int(leftFront.size() + rightFront.size()) > int(se.size()) )
+            init(p);
+        else
+            while ( position < p )
+                next();
+    }
+
+    template<typename INPUT>
+    double RunningStructuringElementMoments<INPUT>::value()
+    {
+        return mean();
+    }
+
+    template<typename INPUT>
+    double RunningStructuringElementMoments<INPUT>::mean()
+    {
+        return shift + powerSum[1] / powerSum[0];
+    }
+
+    template<typename INPUT>
+    double RunningStructuringElementMoments<INPUT>::centralPowerSum(int k)
+    {
+        double m= powerSum[1] / powerSum[0];
+        double result= 0, binomial= 1, mj= 1;
+        for ( int j= k; j >= 0; --j )
+        {
+            result+= ((k - j) % 2 ? -1 : 1) * binomial * mj * powerSum[j];
+            binomial= binomial*j/(k - j + 1);
+            mj*= m;
+        }
+        if ( k % 2 == 0 && result < 0 )
+            result= 0;
+        return result;
+    }
+
+    template<typename INPUT>
+    double RunningStructuringElementMoments<INPUT>::spatialMoment(int p, int q, double c, double r)
+    {
+        double result= 0;
+        double bp= 1, cp= 1;
+        for ( int a= p; a >= 0; --a )
+        {
+            double bq= 1, rq= 1;
+            for ( int b= q; b >= 0; --b )
+            {
+                result+= bp * cp * bq * rq * moment[a][b];
+                bq= bq*b/(q - b + 1);
+                rq*= -r;
+            }
+            bp= bp*a/(p - a + 1);
+            cp*= -c;
+        }
+        return result;
+    }
 }
 
 #endif	/* _RUNNINGSTRUCTURINGELEMENTS_H */
@@ -104,8 +104,82 @@ namespace openip
         virtual Border2 getProposedBorder();
         
         void getCoordinate2D(int n, int& rows, int& columns);
+
+        /**
+         * computes the feature in the foreground region of the roi; the moment based features
+         * (intensityOrder or spatialOrder is non-negative) are computed by applyMoments from
+         * the moments of a RunningStructuringElementMoments running along the rows, the other
+         * features are computed in each position independently
+         * @param input input image
+         * @param output output image
+         * @param roi the feature is computed in the foreground (non-zero) region of the roi, NULL if not used
+         * @param support only the foreground (non-zero) pixels of the support are used, NULL if not used
+         */
+        virtual void apply(Image<INPUT>& input, Image<OUTPUT>& output, Image<unsigned char>* roi= NULL, Image<unsigned char>* support= NULL);
+
+        /**
+         * computes the feature from the moments of the neighborhood of a position
+         * @param input input image
+         * @param rsem moments of the neighborhood of the position rsem.position
+         * @return the computed feature
+         */
+        virtual OUTPUT applyMoments(Image<INPUT>& input, RunningStructuringElementMoments<INPUT>& rsem);
+
+        /** order of the intensity power sums applyMoments uses, -1 if not used */
+        int intensityOrder;
+
+        /** order of the spatial moments applyMoments uses, -1 if not used */
+        int spatialOrder;
     };
 
+    template<typename INPUT, typename OUTPUT>
+    void StatisticalFeature2<INPUT, OUTPUT>::apply(Image<INPUT>& input, Image<OUTPUT>& output, Image<unsigned char>* roi, Image<unsigned char>* support)
+    {
+        if ( intensityOrder < 0 && spatialOrder < 0 )
+        {
+            this->Feature2<INPUT, OUTPUT>::apply(input, output, roi, support);
+            return;
+        }
+
+        this->updateStride(input.columns);
+        this->computeMinMax();
+
+        RunningStructuringElementMoments<INPUT> prototype(*this, intensityOrder, spatialOrder);
+        prototype.init(&input, support);
+
+        int begin= prototype.begin;
+        int end= prototype.end;
+
+        #pragma omp parallel for schedule(dynamic)
+        for ( int r= 0; r < input.rows; ++r )
+        {
+            int first= r*input.columns > begin ? r*input.columns : begin;
+            int last= (r + 1)*input.columns < end ? (r + 1)*input.columns : end;
+
+            RunningStructuringElementMoments<INPUT> rsem(prototype);
+            int initialized= 0;
+            for ( int i= first; i < last; ++i )
+            {
+                if ( roi != NULL && (*roi)(i) == 0 )
+                    continue;
+                if ( initialized )
+                    rsem.moveTo(i);
+                else
+                {
+                    rsem.init(i);
+                    initialized= 1;
+                }
+                output(i)= applyMoments(input, rsem);
+            }
+        }
+    }
+
+    template<typename INPUT, typename OUTPUT>
+    OUTPUT StatisticalFeature2<INPUT, OUTPUT>::applyMoments(Image<INPUT>& input, RunningStructuringElementMoments<INPUT>& rsem)
+    {
+        return this->apply(input, rsem.position, rsem.support);
+    }
+
     template<typename INPUT, typename OUTPUT>
     void StatisticalFeature2<INPUT, OUTPUT>::getCoordinate2D(int n, int& rows, int& columns)
     {
@@ -134,13 +208,13 @@ namespace openip
 
     template<typename INPUT, typename OUTPUT>
     StatisticalFeature2<INPUT, OUTPUT>::StatisticalFeature2(int r, int stride)
-    : StructuringElementDisk(r, stride)
+    : StructuringElementDisk(r, stride), intensityOrder(-1), spatialOrder(-1)
     {
     }
 
     template<typename INPUT, typename OUTPUT>
     StatisticalFeature2<INPUT, OUTPUT>::StatisticalFeature2(const StatisticalFeature2& s)
-    : StructuringElementDisk(s), Feature2<INPUT, OUTPUT>(s)
+    : StructuringElementDisk(s), Feature2<INPUT, OUTPUT>(s), intensityOrder(s.intensityOrder), spatialOrder(s.spatialOrder)
     {
     }
 
@@ -199,6 +273,14 @@ namespace openip
          * @return the computed feature
          */
         OUTPUT apply(Image<INPUT>& input, int n, Image<unsigned char>* support= NULL);
+
+        /**
+         * computes the feature from the moments of the neighborhood of a position
+         * @param input input image
+         * @param rsem moments of the neighborhood of the position rsem.position
+         * @return the computed feature
+         */
+        OUTPUT applyMoments(Image<INPUT>& input, RunningStructuringElementMoments<INPUT>& rsem);
     };
 
     template<typename INPUT, typename OUTPUT>
@@ -208,6 +290,8 @@ namespace openip
         std::stringstream ss;
         ss << "SNRFeature2 " << r;
         descriptor= ss.str();
+        this->intensityOrder= 2;
+        this->spatialOrder= -1;
     }
 
     template<typename INPUT, typename OUTPUT>
@@ -222,6 +306,18 @@ namespace openip
             return 0;
     }
 
+    template<typename INPUT, typename OUTPUT>
+    OUTPUT SNRFeature2<INPUT, OUTPUT>::applyMoments(Image<INPUT>&, RunningStructuringElementMoments<INPUT>& rsem)
+    {
+        double mean= rsem.mean();
+        double variance= rsem.centralPowerSum(2)/rsem.powerSum[0];
+
+        if ( variance >= 1 )
+            return (OUTPUT)(mean/sqrt(variance));
+        else
+            return 0;
+    }
+
     /**
      * Invariant Hu's Moment 1 feature
      */
@@ -251,6 +347,28 @@ namespace openip
          * @return the computed feature
          */
         OUTPUT apply(Image<INPUT>& input, int n, Image<unsigned char>* support= NULL);
+
+        /**
+         * computes the feature from the moments of the neighborhood of a position
+         * @param input input image
+         * @param rsem moments of the neighborhood of the position rsem.position
+         * @return the computed feature
+         */
+        OUTPUT applyMoments(Image<INPUT>& input, RunningStructuringElementMoments<INPUT>& rsem);
+
+        /**
+         * computes the normalized central moments from the raw moments of the neighborhood
+         * @param m raw moments, m[p][q] is the sum of column^p row^q x, p + q <= 3
+         * @param nu normalized central moments, nu[p][q] is filled for 2 <= p + q <= 3
+         */
+        void normalizedMoments(double m[4][4], double nu[4][4]);
+
+        /**
+         * computes the invariant from the normalized central moments
+         * @param nu normalized central moments, nu[p][q] for 2 <= p + q <= 3
+         * @return the invariant
+         */
+        virtual OUTPUT invariant(double nu[4][4]);
         
         float M00(Image<INPUT>& input, int n, Image<unsigned char>* support= NULL);
         
@@ -324,6 +442,8 @@ namespace openip
         std::stringstream ss;
         ss << "InvariantHuMoment1Feature2 " << r;
         descriptor= ss.str();
+        this->intensityOrder= -1;
+        this->spatialOrder= 3;
     }
 
     template<typename INPUT, typename OUTPUT>
@@ -371,6 +491,40 @@ namespace openip
         
         return a + b;
     }
+
+    template<typename INPUT, typename OUTPUT>
+    OUTPUT InvariantHuMoment1Feature2<INPUT, OUTPUT>::applyMoments(Image<INPUT>&, RunningStructuringElementMoments<INPUT>& rsem)
+    {
+        double nu[4][4];
+        normalizedMoments(rsem.moment, nu);
+        return invariant(nu);
+    }
+
+    template<typename INPUT, typename OUTPUT>
+    void InvariantHuMoment1Feature2<INPUT, OUTPUT>::normalizedMoments(double m[4][4], double nu[4][4])
+    {
+        double cx= 0, cy= 0;
+        if ( m[0][0] != 0 )
+        {
+            cx= m[1][0]/m[0][0];
+            cy= m[0][1]/m[0][0];
+        }
+
+        double u00= m[0][0];
+        nu[1][1]= (m[1][1] - cx * m[0][1]) / pow(u00, 2.0);
+        nu[2][0]= (m[2][0] - cx * m[1][0]) / pow(u00, 2.0);
+        nu[0][2]= (m[0][2] - cy * m[0][1]) / pow(u00, 2.0);
+        nu[2][1]= (m[2][1] - 2 * cx * m[1][1] - cy * m[2][0] + 2 * cx * cx * m[0][1]) / pow(u00, 2.5);
+        nu[1][2]= (m[1][2] - 2 * cy * m[1][1] - cx * m[0][2] + 2 * cy * cy * m[1][0]) / pow(u00, 2.5);
+        nu[3][0]= (m[3][0] - 3 * cx * m[2][0] + 2 * cx * cx * m[1][0]) / pow(u00, 2.5);
+        nu[0][3]= (m[0][3] - 3 * cy * m[0][2] + 2 * cy * cy * m[0][1]) / pow(u00, 2.5);
+    }
+
+    template<typename INPUT, typename OUTPUT>
+    OUTPUT InvariantHuMoment1Feature2<INPUT, OUTPUT>::invariant(double nu[4][4])
+    {
+        return (OUTPUT)(nu[2][0] + nu[0][2]);
+    }
     
     template<typename INPUT, typename OUTPUT>
     float InvariantHuMoment1Feature2<INPUT, OUTPUT>::M00(Image<INPUT>& input, int n, Image<unsigned char>* support)
@@ -802,6 +956,13 @@ namespace openip
          * @return the computed feature
          */
         OUTPUT apply(Image<INPUT>& input, int n, Image<unsigned char>* roi= NULL);
+
+        /**
+         * computes the invariant from the normalized central moments
+         * @param nu normalized central moments, nu[p][q] for 2 <= p + q <= 3
+         * @return the invariant
+         */
+        OUTPUT invariant(double nu[4][4]);
     };
 
     template<typename INPUT, typename OUTPUT>
@@ -821,6 +982,14 @@ namespace openip
         return a * a + b * b;
     }
 
+    template<typename INPUT, typename OUTPUT>
+    OUTPUT InvariantHuMoment2Feature2<INPUT, OUTPUT>::invariant(double nu[4][4])
+    {
+        double a= nu[2][0] - nu[0][2];
+        double b= 2 * nu[1][1];
+        return (OUTPUT)(a * a + b * b);
+    }
+
     /**
      * Invariant Hu's Moment 3 feature
      */
@@ -881,6 +1050,13 @@ namespace openip
          * @return the computed feature
          */
         OUTPUT apply(Image<INPUT>& input, int n, Image<unsigned char>* support= NULL);
+
+        /**
+         * computes the invariant from the normalized central moments
+         * @param nu normalized central moments, nu[p][q] for 2 <= p + q <= 3
+         * @return the invariant
+         */
+        OUTPUT invariant(double nu[4][4]);
     };
 
     template<typename INPUT, typename OUTPUT>
@@ -901,6 +1077,15 @@ namespace openip
         return a * a + b * b;
     }
 
+    template<typename INPUT, typename OUTPUT>
+    OUTPUT InvariantHuMoment3Feature2<INPUT, OUTPUT>::invariant(double nu[4][4])
+    {
+        double a= nu[3][0] - 3 * nu[1][2];
+        double b= 3 * nu[2][1] - nu[0][3];
+
+        return (OUTPUT)(a * a + b * b);
+    }
+
     /**
      * Invariant Hu's Moment 4 feature
      */
@@ -961,6 +1146,13 @@ namespace openip
          * @return the computed feature
          */
         OUTPUT apply(Image<INPUT>& input, int n, Image<unsigned char>* support= NULL);
+
+        /**
+         * computes the invariant from the normalized central moments
+         * @param nu normalized central moments, nu[p][q] for 2 <= p + q <= 3
+         * @return the invariant
+         */
+        OUTPUT invariant(double nu[4][4]);
     };
 
     template<typename INPUT, typename OUTPUT>
@@ -981,6 +1173,15 @@ namespace openip
         return a * a + b * b;
     }
 
+    template<typename INPUT, typename OUTPUT>
+    OUTPUT InvariantHuMoment4Feature2<INPUT, OUTPUT>::invariant(double nu[4][4])
+    {
+        double a= nu[3][0] + nu[1][2];
+        double b= nu[2][1] + nu[0][3];
+
+        return (OUTPUT)(a * a + b * b);
+    }
+
     /**
      * Invariant Hu's Moment 5 feature
      */
@@ -1041,6 +1242,13 @@ namespace openip
          * @return the computed feature
          */
         OUTPUT apply(Image<INPUT>& input, int n, Image<unsigned char>* support= NULL);
+
+        /**
+         * computes the invariant from the normalized central moments
+         * @param nu normalized central moments, nu[p][q] for 2 <= p + q <= 3
+         * @return the invariant
+         */
+        OUTPUT invariant(double nu[4][4]);
     };
 
     template<typename INPUT, typename OUTPUT>
@@ -1063,6 +1271,14 @@ namespace openip
         return (m30 - 3*m12)*(m30 + m12)*((m30 + m12)*(m30 + m12) - 3*(m21 + m03)*(m21 + m03)) + (3*m21 - m03)*(m21 + m03)*(3*(m30 + m12)*(m30 + m12) - (m21 + m03)*(m21 + m03));
     }
 
+    template<typename INPUT, typename OUTPUT>
+    OUTPUT InvariantHuMoment5Feature2<INPUT, OUTPUT>::invariant(double nu[4][4])
+    {
+        double m30= nu[3][0], m03= nu[0][3], m21= nu[2][1], m12= nu[1][2];
+
+        return (OUTPUT)((m30 - 3*m12)*(m30 + m12)*((m30 + m12)*(m30 + m12) - 3*(m21 + m03)*(m21 + m03)) + (3*m21 - m03)*(m21 + m03)*(3*(m30 + m12)*(m30 + m12) - (m21 + m03)*(m21 + m03)));
+    }
+
     /**
      * Invariant Hu's Moment 6 feature
      */
@@ -1123,6 +1339,13 @@ namespace openip
          * @return the computed feature
          */
         OUTPUT apply(Image<INPUT>& input, int n, Image<unsigned char>* support= NULL);
+
+        /**
+         * computes the invariant from the normalized central moments
+         * @param nu normalized central moments, nu[p][q] for 2 <= p + q <= 3
+         * @return the invariant
+         */
+        OUTPUT invariant(double nu[4][4]);
     };
 
     template<typename INPUT, typename OUTPUT>
@@ -1148,6 +1371,14 @@ namespace openip
         return (m20 - m02)*((m30 + m12)*(m30 + m12) - (m21 + m03)*(m21 + m03)) + 4 * m11 * (m30 + m12) * (m21 + m03);
     }
 
+    template<typename INPUT, typename OUTPUT>
+    OUTPUT InvariantHuMoment6Feature2<INPUT, OUTPUT>::invariant(double nu[4][4])
+    {
+        double m20= nu[2][0], m02= nu[0][2], m30= nu[3][0], m12= nu[1][2], m21= nu[2][1], m03= nu[0][3], m11= nu[1][1];
+
+        return (OUTPUT)((m20 - m02)*((m30 + m12)*(m30 + m12) - (m21 + m03)*(m21 + m03)) + 4 * m11 * (m30 + m12) * (m21 + m03));
+    }
+
     /**
      * Invariant Hu's Moment 7 feature
      */
@@ -1208,6 +1439,13 @@ namespace openip
          * @return the computed feature
          */
         OUTPUT apply(Image<INPUT>& input, int n, Image<unsigned char>* support= NULL);
+
+        /**
+         * computes the invariant from the normalized central moments
+         * @param nu normalized central moments, nu[p][q] for 2 <= p + q <= 3
+         * @return the invariant
+         */
+        OUTPUT invariant(double nu[4][4]);
     };
 
     template<typename INPUT, typename OUTPUT>
@@ -1230,6 +1468,14 @@ namespace openip
         return (3*m21 - m03)*(m30 + m12)*((m30 + m12)*(m30 + m12) - 3 * (m21 + m03) * (m21 + m03)) - (m30 - 3*m12) * (m21 + m03) * (3 * (m30 + m12) * (m30 + m12) - (m21 + m03) * (m21 + m03));
     }
 
+    template<typename INPUT, typename OUTPUT>
+    OUTPUT InvariantHuMoment7Feature2<INPUT, OUTPUT>::invariant(double nu[4][4])
+    {
+        double m21= nu[2][1], m03= nu[0][3], m30= nu[3][0], m12= nu[1][2];
+
+        return (OUTPUT)((3*m21 - m03)*(m30 + m12)*((m30 + m12)*(m30 + m12) - 3 * (m21 + m03) * (m21 + m03)) - (m30 - 3*m12) * (m21 + m03) * (3 * (m30 + m12) * (m30 + m12) - (m21 + m03) * (m21 + m03)));
+    }
+
     /**
      * Invariant Hu's Moment 8 feature
      */
@@ -1290,6 +1536,13 @@ namespace openip
          * @return the computed feature
          */
         OUTPUT apply(Image<INPUT>& input, int n, Image<unsigned char>* support= NULL);
+
+        /**
+         * computes the invariant from the normalized central moments
+         * @param nu normalized central moments, nu[p][q] for 2 <= p + q <= 3
+         * @return the invariant
+         */
+        OUTPUT invariant(double nu[4][4]);
     };
 
     template<typename INPUT, typename OUTPUT>
@@ -1314,6 +1567,14 @@ namespace openip
         
         return m11*((m30 + m12)*(m30 + m12) - (m03 + m21)*(m03 + m21)) - (m20 - m02)*(m30 + m12)*(m03 + m21);
     }
+
+    template<typename INPUT, typename OUTPUT>
+    OUTPUT InvariantHuMoment8Feature2<INPUT, OUTPUT>::invariant(double nu[4][4])
+    {
+        double m21= nu[2][1], m03= nu[0][3], m30= nu[3][0], m12= nu[1][2], m20= nu[2][0], m02= nu[0][2], m11= nu[1][1];
+
+        return (OUTPUT)(m11*((m30 + m12)*(m30 + m12) - (m03 + m21)*(m03 + m21)) - (m20 - m02)*(m30 + m12)*(m03 + m21));
+    }
     
     /**
      * Eccentricity feature
@@ -1344,6 +1605,24 @@ namespace openip
          * @return the computed feature
          */
         OUTPUT apply(Image<INPUT>& input, int n, Image<unsigned char>* support= NULL);
+
+        /**
+         * computes the feature from the moments of the neighborhood of a position
+         * @param input input image
+         * @param rsem moments of the neighborhood of the position rsem.position
+         * @return the computed feature
+         */
+        OUTPUT applyMoments(Image<INPUT>& input, RunningStructuringElementMoments<INPUT>& rsem);
+
+        /**
+         * computes the eccentricity from the second order central moments
+         * @param sum00 sum of the intensities
+         * @param sum20 second order central moment in the column direction
+         * @param sum02 second order central moment in the row direction
+         * @param sum11 mixed second order central moment
+         * @return the eccentricity
+         */
+        OUTPUT eccentricity(double sum00, double sum20, double sum02, double sum11);
     };
 
     template<typename INPUT, typename OUTPUT>
@@ -1353,6 +1632,8 @@ namespace openip
         std::stringstream ss;
         ss << "EccentricityFeature2 " << r;
         descriptor= ss.str();
+        this->intensityOrder= -1;
+        this->spatialOrder= 2;
     }
 
     template<typename INPUT, typename OUTPUT>
@@ -1402,7 +1683,13 @@ namespace openip
             }
         }
 
-        float n20= 0, n02= 0, n11= 0;
+        return eccentricity(sum00, sum20, sum02, sum11);
+    }
+
+    template<typename INPUT, typename OUTPUT>
+    OUTPUT EccentricityFeature2<INPUT, OUTPUT>::eccentricity(double sum00, double sum20, double sum02, double sum11)
+    {
+        double n20= 0, n02= 0, n11= 0;
         if ( fabs(sum00) > 0.01 )
         {
             n20= sum20/sum00;
@@ -1419,15 +1706,29 @@ namespace openip
         if ( (n20 + n02)*(n20 + n02) < 4 * (n20*n02 - n11*n11) )
             return (OUTPUT)0;
 
-        float l1= (n20 + n02 + sqrt((n20+n02)*(n20+n02) - 4*(n20*n02-n11*n11)))/2;
-        float l2= (n20 + n02 - sqrt((n20+n02)*(n20+n02) - 4*(n20*n02-n11*n11)))/2;
+        double l1= (n20 + n02 + sqrt((n20+n02)*(n20+n02) - 4*(n20*n02-n11*n11)))/2;
+        double l2= (n20 + n02 - sqrt((n20+n02)*(n20+n02) - 4*(n20*n02-n11*n11)))/2;
 
         if ( fabs(l1) > 0.01 && l2/l1 < 1.0 )
-            return (OUTPUT)(sqrt(1.0f - l2/l1));
+            return (OUTPUT)(sqrt(1.0 - l2/l1));
         else
             return (OUTPUT)1.0f;
     }
 
+    template<typename INPUT, typename OUTPUT>
+    OUTPUT EccentricityFeature2<INPUT, OUTPUT>::applyMoments(Image<INPUT>&, RunningStructuringElementMoments<INPUT>& rsem)
+    {
+        double m00= rsem.moment[0][0];
+        double cx= 1.0, cy= 1.0;
+        if ( fabs(m00) > 0.0001 )
+        {
+            cx= rsem.moment[1][0]/m00;
+            cy= rsem.moment[0][1]/m00;
+        }
+
+        return eccentricity(m00, rsem.spatialMoment(2, 0, cx, cy), rsem.spatialMoment(0, 2, cx, cy), rsem.spatialMoment(1, 1, cx, cy));
+    }
+
     /**
      * Orientation feature
      */
@@ -1457,6 +1758,14 @@ namespace openip
          * @return the computed feature
          */
         OUTPUT apply(Image<INPUT>& input, int n, Image<unsigned char>* support= NULL);
+
+        /**
+         * computes the feature from the moments of the neighborhood of a position
+         * @param input input image
+         * @param rsem moments of the neighborhood of the position rsem.position
+         * @return the computed feature
+         */
+        OUTPUT applyMoments(Image<INPUT>& input, RunningStructuringElementMoments<INPUT>& rsem);
     };
 
     template<typename INPUT, typename OUTPUT>
@@ -1466,6 +1775,8 @@ namespace openip
         std::stringstream ss;
         ss << "OrientationFeature2 " << r;
         descriptor= ss.str();
+        this->intensityOrder= -1;
+        this->spatialOrder= 2;
     }
 
     template<typename INPUT, typename OUTPUT>
@@ -1503,6 +1814,23 @@ namespace openip
             return (OUTPUT)(0);
     }
 
+    template<typename INPUT, typename OUTPUT>
+    OUTPUT OrientationFeature2<INPUT, OUTPUT>::applyMoments(Image<INPUT>&, RunningStructuringElementMoments<INPUT>& rsem)
+    {
+        double m00= rsem.moment[0][0];
+        double m10= rsem.moment[1][0];
+        double m01= rsem.moment[0][1];
+
+        double n11= rsem.moment[1][1] - m10*m01/m00;
+        double n20= rsem.moment[2][0] - m10*m10/m00;
+        double n02= rsem.moment[0][2] - m01*m01/m00;
+
+        if ( n20 != n02 )
+            return (OUTPUT)((atan2(2*n11,(n20-n02)))/2.0);
+        else
+            return (OUTPUT)(0);
+    }
+
     /**
      * Central Moment feature
      */
@@ -1535,6 +1863,14 @@ namespace openip
          */
         OUTPUT apply(Image<INPUT>& input, int n, Image<unsigned char>* support= NULL);
 
+        /**
+         * computes the feature from the moments of the neighborhood of a position
+         * @param input input image
+         * @param rsem moments of the neighborhood of the position rsem.position
+         * @return the computed feature
+         */
+        OUTPUT applyMoments(Image<INPUT>& input, RunningStructuringElementMoments<INPUT>& rsem);
+
         /** exponent of the x components */
         float p;
         /** exponent of the y components */
@@ -1556,6 +1892,8 @@ namespace openip
         std::stringstream ss;
         ss << "CentralMomentFeature2 " << r << " " << p << " " << q;
         descriptor= ss.str();
+        if ( p >= 0 && q >= 0 && p == floor(p) && q == floor(q) && p + q <= 3 )
+            this->spatialOrder= int(p + q);
     }
 
     template<typename INPUT, typename OUTPUT>
@@ -1596,6 +1934,16 @@ namespace openip
         return (OUTPUT)(sum);
     }
 
+    template<typename INPUT, typename OUTPUT>
+    OUTPUT CentralMomentFeature2<INPUT, OUTPUT>::applyMoments(Image<INPUT>&, RunningStructuringElementMoments<INPUT>& rsem)
+    {
+        double m00= rsem.moment[0][0];
+        double cx= rsem.moment[1][0]/m00;
+        double cy= rsem.moment[0][1]/m00;
+
+        return (OUTPUT)(rsem.spatialMoment(int(p), int(q), cx, cy));
+    }
+
     /**
      * Maximum intensity feature
      */
@@ -1879,6 +2227,14 @@ namespace openip
          */
         OUTPUT apply(Image<INPUT>& input, int n, Image<unsigned char>* support= NULL);
 
+        /**
+         * computes the feature from the moments of the neighborhood of a position
+         * @param input input image
+         * @param rsem moments of the neighborhood of the position rsem.position
+         * @return the computed feature
+         */
+        OUTPUT applyMoments(Image<INPUT>& input, RunningStructuringElementMoments<INPUT>& rsem);
+
 #ifdef USE_OPENCL
         virtual std::string getOpenCLKernel();
         
@@ -1896,6 +2252,8 @@ namespace openip
         std::stringstream ss;
         ss << "MeanFeature2 " << r;
         descriptor= ss.str();
+        this->intensityOrder= 1;
+        this->spatialOrder= -1;
     }
 
     template<typename INPUT, typename OUTPUT>
@@ -1907,6 +2265,15 @@ namespace openip
             return (OUTPUT)(this->getMean(input, n, support));
     }
 
+    template<typename INPUT, typename OUTPUT>
+    OUTPUT MeanFeature2<INPUT, OUTPUT>::applyMoments(Image<INPUT>& input, RunningStructuringElementMoments<INPUT>& rsem)
+    {
+        if ( radius <= 0 )
+            return (OUTPUT)(input(rsem.position));
+        else
+            return (OUTPUT)(rsem.mean());
+    }
+
 #ifdef USE_OPENCL
     template<typename INPUT, typename OUTPUT>
     std::string MeanFeature2<INPUT, OUTPUT>::getOpenCLKernel()
@@ -2058,6 +2425,14 @@ namespace openip
          * @return the computed feature
          */
         OUTPUT apply(Image<INPUT>& input, int n, Image<unsigned char>* support= NULL);
+
+        /**
+         * computes the feature from the moments of the neighborhood of a position
+         * @param input input image
+         * @param rsem moments of the neighborhood of the position rsem.position
+         * @return the computed feature
+         */
+        OUTPUT applyMoments(Image<INPUT>& input, RunningStructuringElementMoments<INPUT>& rsem);
     };
 
     template<typename INPUT, typename OUTPUT>
@@ -2067,6 +2442,8 @@ namespace openip
         std::stringstream ss;
         ss << "VarianceFeature2 " << r;
         descriptor= ss.str();
+        this->intensityOrder= 2;
+        this->spatialOrder= -1;
     }
 
     template<typename INPUT, typename OUTPUT>
@@ -2081,6 +2458,12 @@ namespace openip
         return (OUTPUT)(this->getVariance(input, n, support));
     }
 
+    template<typename INPUT, typename OUTPUT>
+    OUTPUT VarianceFeature2<INPUT, OUTPUT>::applyMoments(Image<INPUT>&, RunningStructuringElementMoments<INPUT>& rsem)
+    {
+        return (OUTPUT)(rsem.centralPowerSum(2)/rsem.powerSum[0]);
+    }
+
     /**
      * Standard Deviation intensity feature
      */
@@ -2117,6 +2500,14 @@ namespace openip
          * @return the computed feature
          */
         OUTPUT apply(Image<INPUT>& input, int n, Image<unsigned char>* support= NULL);
+
+        /**
+         * computes the feature from the moments of the neighborhood of a position
+         * @param input input image
+         * @param rsem moments of the neighborhood of the position rsem.position
+         * @return the computed feature
+         */
+        OUTPUT applyMoments(Image<INPUT>& input, RunningStructuringElementMoments<INPUT>& rsem);
     };
 
     template<typename INPUT, typename OUTPUT>
@@ -2126,6 +2517,8 @@ namespace openip
         std::stringstream ss;
         ss << "StandardDeviationFeature2 " << r;
         descriptor= ss.str();
+        this->intensityOrder= 2;
+        this->spatialOrder= -1;
     }
 
     template<typename INPUT, typename OUTPUT>
@@ -2139,6 +2532,12 @@ namespace openip
     {
         return (OUTPUT)(this->getStandardDeviation(input, n, support));
     }
+
+    template<typename INPUT, typename OUTPUT>
+    OUTPUT StandardDeviationFeature2<INPUT, OUTPUT>::applyMoments(Image<INPUT>&, RunningStructuringElementMoments<INPUT>& rsem)
+    {
+        return (OUTPUT)(sqrt(rsem.centralPowerSum(2)/rsem.powerSum[0]));
+    }
     
     template<typename INPUT, typename OUTPUT>
     class TotalVariationFeature2: public StatisticalFeature2<INPUT, OUTPUT>
@@ -2247,6 +2646,14 @@ namespace openip
          * @return the computed feature
          */
         OUTPUT apply(Image<INPUT>& input, int n, Image<unsigned char>* support= NULL);
+
+        /**
+         * computes the feature from the moments of the neighborhood of a position
+         * @param input input image
+         * @param rsem moments of the neighborhood of the position rsem.position
+         * @return the computed feature
+         */
+        OUTPUT applyMoments(Image<INPUT>& input, RunningStructuringElementMoments<INPUT>& rsem);
     };
 
     template<typename INPUT, typename OUTPUT>
@@ -2256,6 +2663,8 @@ namespace openip
         std::stringstream ss;
         ss << "SkewnessFeature2 " << r;
         descriptor= ss.str();
+        this->intensityOrder= 3;
+        this->spatialOrder= -1;
     }
 
     template<typename INPUT, typename OUTPUT>
@@ -2270,6 +2679,18 @@ namespace openip
         return (OUTPUT)(this->getSkewness(input, n, support));
     }
 
+    template<typename INPUT, typename OUTPUT>
+    OUTPUT SkewnessFeature2<INPUT, OUTPUT>::applyMoments(Image<INPUT>&, RunningStructuringElementMoments<INPUT>& rsem)
+    {
+        double m2= rsem.centralPowerSum(2);
+
+        // the rounding errors of the power sums of non-integer images are not taken for deviation
+        if ( m2 > 1e-12 * rsem.powerSum[2] )
+            return (OUTPUT)(rsem.centralPowerSum(3) / pow(m2, 3.0/2.0));
+        else
+            return 0;
+    }
+
     template<typename INPUT, typename OUTPUT>
     class KurtosisFeature2: public StatisticalFeature2<INPUT, OUTPUT>
     {
@@ -2303,6 +2724,14 @@ namespace openip
          * @return the computed feature
          */
         OUTPUT apply(Image<INPUT>& input, int n, Image<unsigned char>* support= NULL);
+
+        /**
+         * computes the feature from the moments of the neighborhood of a position
+         * @param input input image
+         * @param rsem moments of the neighborhood of the position rsem.position
+         * @return the computed feature
+         */
+        OUTPUT applyMoments(Image<INPUT>& input, RunningStructuringElementMoments<INPUT>& rsem);
     };
 
     template<typename INPUT, typename OUTPUT>
@@ -2312,6 +2741,8 @@ namespace openip
         std::stringstream ss;
         ss << "KurtosisFeature2 " << r;
         descriptor= ss.str();
+        this->intensityOrder= 4;
+        this->spatialOrder= -1;
     }
 
     template<typename INPUT, typename OUTPUT>
@@ -2326,6 +2757,17 @@ namespace openip
         return (OUTPUT)(this->getKurtosis(input, n, support));
     }
 
+    template<typename INPUT, typename OUTPUT>
+    OUTPUT KurtosisFeature2<INPUT, OUTPUT>::applyMoments(Image<INPUT>&, RunningStructuringElementMoments<INPUT>& rsem)
+    {
+        double m2= rsem.centralPowerSum(2);
+
+        if ( m2 > 1e-12 * rsem.powerSum[2] )
+            return (OUTPUT)(rsem.centralPowerSum(4) / (m2*m2));
+        else
+            return 0;
+    }
+
     /**
      * Standard Deviation intensity feature
      */
@@ -2362,6 +2804,14 @@ namespace openip
          * @return the computed feature
          */
         OUTPUT apply(Image<INPUT>& input, int n, Image<unsigned char>* support= NULL);
+
+        /**
+         * computes the feature from the moments of the neighborhood of a position
+         * @param input input image
+         * @param rsem moments of the neighborhood of the position rsem.position
+         * @return the computed feature
+         */
+        OUTPUT applyMoments(Image<INPUT>& input, RunningStructuringElementMoments<INPUT>& rsem);
     };
 
     template<typename INPUT, typename OUTPUT>
@@ -2371,6 +2821,8 @@ namespace openip
         std::stringstream ss;
         ss << "NormalizationFeature2 " << r;
         descriptor= ss.str();
+        this->intensityOrder= 2;
+        this->spatialOrder= -1;
     }
 
     template<typename INPUT, typename OUTPUT>
@@ -2391,6 +2843,18 @@ namespace openip
         else
             return 0;
     }
+
+    template<typename INPUT, typename OUTPUT>
+    OUTPUT NormalizationFeature2<INPUT, OUTPUT>::applyMoments(Image<INPUT>& input, RunningStructuringElementMoments<INPUT>& rsem)
+    {
+        double mean= rsem.mean();
+        double deviation= sqrt(rsem.centralPowerSum(2)/rsem.powerSum[0]);
+
+        if ( fabs(deviation) > 0.001 )
+            return (OUTPUT)((input(rsem.position) - mean)/deviation);
+        else
+            return 0;
+    }
     
     template<typename INPUT, typename OUTPUT>
     class NormalizationInto01Feature2: public StatisticalFeature2<INPUT, OUTPUT>
@@ -3356,6 +3820,14 @@ namespace openip
          * @return the computed feature
          */
         OUTPUT apply(Image<INPUT>& input, int n, Image<unsigned char>* support= NULL);
+
+        /**
+         * computes the feature from the moments of the neighborhood of a position
+         * @param input input image
+         * @param rsem moments of the neighborhood of the position rsem.position
+         * @return the computed feature
+         */
+        OUTPUT applyMoments(Image<INPUT>& input, RunningStructuringElementMoments<INPUT>& rsem);
     };
 
     template<typename INPUT, typename OUTPUT>
@@ -3365,6 +3837,8 @@ namespace openip
         std::stringstream ss;
         ss << "DistanceOfCenterOfGravityFeature2 " << r;
         descriptor= ss.str();
+        this->intensityOrder= -1;
+        this->spatialOrder= 1;
     }
 
     template<typename INPUT, typename OUTPUT>
@@ -3389,6 +3863,15 @@ namespace openip
         return sqrt(cx*cx + cy*cy);
     }
 
+    template<typename INPUT, typename OUTPUT>
+    OUTPUT DistanceOfCenterOfGravityFeature2<INPUT, OUTPUT>::applyMoments(Image<INPUT>&, RunningStructuringElementMoments<INPUT>& rsem)
+    {
+        double cx= rsem.moment[1][0]/rsem.moment[0][0];
+        double cy= rsem.moment[0][1]/rsem.moment[0][0];
+
+        return (OUTPUT)(sqrt(cx*cx + cy*cy));
+    }
+
     template<typename INPUT, typename OUTPUT>
     class IdenticalFeature2: public StatisticalFeature2<INPUT, OUTPUT>
     {
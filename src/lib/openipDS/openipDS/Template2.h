@@ -454,6 +454,82 @@ namespace openip
       }
       return 0;
     }
+    /**
+     * CompiledTemplate2 is a dense representation of a Template2 for whole image evaluation: the taps are
+     * stored as a structure of arrays in the order of the template (the order of summation is kept)
+     */
+    template<typename WEIGHTS>
+    class CompiledTemplate2
+    {
+    public:
+        /**
+         * default constructor
+         */
+        CompiledTemplate2();
+
+        /**
+         * constructor, compiles the parameter template
+         * @param t template to compile
+         */
+        CompiledTemplate2(Template2<WEIGHTS>& t);
+
+        /**
+         * compiles the parameter template with its current stride
+         * @param t template to compile
+         */
+        void compile(Template2<WEIGHTS>& t);
+
+        /**
+         * checks if the compiled form belongs to the parameter template with its current stride
+         * @param t template to check
+         * @return non-zero if the stride and the taps are the same
+         */
+        int compiledFrom(Template2<WEIGHTS>& t);
+
+        /** offsets of the taps in the order of the template */
+        Vector<int> offsets;
+        /** weights of the taps in the order of the template */
+        Vector<WEIGHTS> weights;
+
+        /** stride the template was compiled with */
+        int stride;
+    };
+
+    template<typename WEIGHTS>
+    CompiledTemplate2<WEIGHTS>::CompiledTemplate2()
+    {
+        stride= 0;
+    }
+
+    template<typename WEIGHTS>
+    CompiledTemplate2<WEIGHTS>::CompiledTemplate2(Template2<WEIGHTS>& t)
+    {
+        compile(t);
+    }
+
+    template<typename WEIGHTS>
+    void CompiledTemplate2<WEIGHTS>::compile(Template2<WEIGHTS>& t)
+    {
+        stride= t.stride;
+        offsets.resize(t.size());
+        weights.resize(t.size());
+        for ( unsigned int i= 0; i < t.size(); ++i )
+        {
+            offsets(i)= t(i).first;
+            weights(i)= t(i).second;
+        }
+    }
+
+    template<typename WEIGHTS>
+    int CompiledTemplate2<WEIGHTS>::compiledFrom(Template2<WEIGHTS>& t)
+    {
+        if ( stride != t.stride || offsets.size() != t.size() )
+            return 0;
+        for ( unsigned int i= 0; i < t.size(); ++i )
+            if ( offsets(i) != t(i).first || weights(i) != t(i).second )
+                return 0;
+        return 1;
+    }
 }
 
 #endif
@@ -80,6 +80,13 @@ namespace openip
     /** filter system mode minimum own*/
     #define FILTER_SYSTEM_MODE_MIN_OWN 10
 
+    /** normalized cross-correlation backend chosen by the estimated cost*/
+    #define CCORRELATION_BACKEND_AUTO 0
+    /** normalized cross-correlation computed tap by tap*/
+    #define CCORRELATION_BACKEND_SPATIAL 1
+    /** normalized cross-correlation computed by FFT convolution and prefix sums*/
+    #define CCORRELATION_BACKEND_FOURIER 2
+
     /**
      * set border pixels to zero
      */
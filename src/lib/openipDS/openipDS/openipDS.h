@@ -52,8 +52,10 @@
 #include <openipDS/Filter2s.h>
 #include <openipDS/FilterSet2.h>
 #include <openipDS/FilterSystem2.h>
+#include <openipDS/FastFourierTransform.h>
 #include <openipDS/FourierMatrix.h>
 #include <openipDS/FourierVector.h>
+#include <openipDS/FusedCCorrelationFilterBank2.h>
 #include <openipDS/GaborFilter2.h>
 #include <openipDS/GaussianScaleSpace.h>
 #include <openipDS/Histogram.h>
@@ -4,139 +4,96 @@
 #include <openipDS/Vector.h>
 #include <openipDS/Stopper.h>
 
+#include <omp.h>
+
 namespace openip
 {
-    class EquivalenceClasses
-    {
-    public:
-        EquivalenceClasses();
-        
-        EquivalenceClasses(const EquivalenceClasses& e);
-        
-        ~EquivalenceClasses();
-        
-        int getClass(int);
-        
-        void insert(int, int);
-        
-        void reduce();
-        
-        Vector<Set<int> > classes;
-        Vector<int> map;
-    };
-    
-    EquivalenceClasses::EquivalenceClasses()
-    {
-        map.clear();
-        classes.clear();
-    }
-        
-    EquivalenceClasses::EquivalenceClasses(const EquivalenceClasses& /*e*/)
-    {
-    }
-
-    EquivalenceClasses::~EquivalenceClasses()
+    /**
+     * finds the root of pixel p in the union-find forest with path compression
+     * @param parent union-find forest
+     * @param p pixel
+     * @return the root, the pixel of the smallest index in the set of p
+     */
+    inline int findRoot(int* parent, int p)
     {
+        int r= p;
+        while ( parent[r] != r )
+            r= parent[r];
+        while ( parent[p] != r )
+        {
+            int next= parent[p];
+            parent[p]= r;
+            p= next;
+        }
+        return r;
     }
 
-    int EquivalenceClasses::getClass(int element)
+    /**
+     * unites the sets of pixels p and q, the root of the union is the smaller root
+     * @param parent union-find forest
+     * @param p pixel
+     * @param q pixel
+     */
+    inline void unite(int* parent, int p, int q)
     {
-        return map(element);
+        p= findRoot(parent, p);
+        q= findRoot(parent, q);
+        if ( p < q )
+            parent[q]= p;
+        else if ( q < p )
+            parent[p]= q;
     }
 
-    void EquivalenceClasses::insert(int a, int b)
+    /**
+     * scans the rows [firstRow, lastRow) and unites the foreground pixels with their foreground neighbors
+     * in the previous row and column; the rows before firstRow are not visited. For 8-connectivity the
+     * decision tree of Wu et al. is used: the upper neighbor is adjacent to the other three, the
+     * upper-right one is not adjacent to the left and upper-left ones.
+     */
+    void scanRows(Image<unsigned char>& input, int* parent, int firstRow, int lastRow, int neighborhood)
     {
-        if ( map.size() <= (unsigned int)(a) )
-            map.resize(a + 1, -1);
-        if ( map.size() <= (unsigned int)(b) )
-            map.resize(b + 1, -1);
-        
-        if ( map(a) == -1 && map(b) == -1 )
-        {
-            classes.push_back( (Set<int>()) );
-            map(a)= classes.size() - 1;
-            map(b)= classes.size() - 1;
-            //classes(map(a)).insert(a);
-            //classes(map(b)).insert(b);
-	    classes(map(a)).push_back(a);
-	    classes(map(b)).push_back(b);
-        }
-        else if ( map(a) == map(b) )
-        {
-            return;
-        }
-        else if ( map(a) >= 0 && map(b) == -1 )
-        {
-            //classes(map(a)).insert(b);
-	    classes(map(a)).push_back(b);
-            map(b)= map(a);
-        }
-        else if ( map(b) >= 0 && map(a) == -1 )
-        {
-            //classes(map(b)).insert(a);
-	    classes(map(b)).push_back(a);
-            map(a)= map(b);
-        }
-        else if ( map(a) != map(b) && map(a) >= 0 && map(b) >= 0 )
-        {
-            vector<int> tmp;
-            for ( Set<int>::iterator it= classes(map(b)).begin(); it != classes(map(b)).end(); ++it )
+        int columns= input.columns;
+        for ( int i= firstRow; i < lastRow; ++i )
+            for ( int j= 0; j < columns; ++j )
             {
-                if ( *it != b )
+                int p= i*columns + j;
+                if ( !(input(p) > 0) )
+                    continue;
+
+                parent[p]= p;
+                bool up= i > firstRow && input(p - columns) > 0;
+                bool left= j > 0 && input(p - 1) > 0;
+
+                if ( neighborhood == 2 )
                 {
-                //classes(map(a)).insert(*it);
-		classes(map(a)).push_back(*it);
-                tmp.push_back(*it);
+                    bool upleft= i > firstRow && j > 0 && input(p - columns - 1) > 0;
+                    bool upright= i > firstRow && j + 1 < columns && input(p - columns + 1) > 0;
+
+                    if ( up )
+                        unite(parent, p, p - columns);
+                    else if ( upright )
+                    {
+                        unite(parent, p, p - columns + 1);
+                        if ( upleft )
+                            unite(parent, p, p - columns - 1);
+                        else if ( left )
+                            unite(parent, p, p - 1);
+                    }
+                    else if ( upleft )
+                        unite(parent, p, p - columns - 1);
+                    else if ( left )
+                        unite(parent, p, p - 1);
+                }
+                else
+                {
+                    if ( up )
+                        unite(parent, p, p - columns);
+                    if ( left )
+                        unite(parent, p, p - 1);
                 }
             }
-            sort(classes(map(a)).begin(), classes(map(a)).end());
-	    Vector<int>::iterator it= unique(classes(map(a)).begin(), classes(map(a)).end());
-	    classes(map(a)).resize(std::distance(classes(map(a)).begin(), it));
-            for ( unsigned int i= 0; i < tmp.size(); ++i )
-            {
-                map(tmp[i])= map(a);
-            }
-            classes(map(b)).clear();
-            classes(map(a)).insert(b);
-            map(b)= map(a);
-        }
     }
-    
-    void EquivalenceClasses::reduce()
-    {
-        //tprintf("reduce %d\n", classes.size());
-        int start= 0, end= classes.size() - 1;
-        
-        while ( start < end )
-        {
-            while ( classes(start).size() != 0 && start < end )
-                ++start;
-            while ( classes(end).size() == 0 && start < end )
-                --end;
-            if ( start < end )
-            {
-	        //delete classes(start);
-                classes(start)= classes(end);
-                classes.erase(classes.begin() + end);
-                --end;
-            }
-        }
 
-        unsigned int i;
-        for ( i= 0; i < classes.size(); ++i )
-            if ( classes(i).size() == 0 )
-                break;
-        classes.resize(i);
-            
-        for ( unsigned int i= 0; i < classes.size(); ++i )
-        {
-            for ( Set<int>::iterator it= classes(i).begin(); it != classes(i).end(); ++it )
-            {
-                map(*it)= i;
-            }
-        }
-    }
-    
     ComponentLabeling::ComponentLabeling(int neighborhood)
     : Transform2<unsigned char, int>()
     {
@@ -156,103 +113,49 @@ namespace openip
     {
         output= 0;
 
-        int label= 1;
-        int a, b, c, d, nn= 0;
-        EquivalenceClasses eqv;
-        eqv.insert(label, label);
-        
-        for ( int i= 0; i < input.rows; ++i )
-            for ( int j= 0; j < input.columns; ++j )
-                if ( input(i,j) > 0 )
+        int n= input.n;
+        int columns= input.columns;
+        Vector<int> parent(n, -1);
+
+        // the strips are labeled in parallel, the sets crossing the strip boundaries are merged afterwards
+        int strips= omp_get_max_threads();
+        if ( strips > input.rows )
+            strips= input.rows;
+        if ( strips < 1 )
+            strips= 1;
+
+        #pragma omp parallel for num_threads(strips)
+        for ( int s= 0; s < strips; ++s )
+            scanRows(input, &(parent(0)), input.rows*s/strips, input.rows*(s+1)/strips, neighborhood);
+
+        for ( int s= 1; s < strips; ++s )
+        {
+            int i= input.rows*s/strips;
+            for ( int j= 0; j < columns; ++j )
+            {
+                int p= i*columns + j;
+                if ( !(input(p) > 0) )
+                    continue;
+                if ( input(p - columns) > 0 )
+                    unite(&(parent(0)), p, p - columns);
+                if ( neighborhood == 2 )
                 {
-		  if ( neighborhood == 2 )
-		  {
-		    if ( j-1 >= 0 )
-		      a= output(i,j-1);
-		    else
-		      a= 0;
-		    if ( i-1 >= 0 && j-1 >= 0 )
-		      b= output(i-1, j-1);
-		    else
-		      b= 0;
-		    if ( i-1 >= 0 )
-		      c= output(i-1, j);
-		    else
-		      c= 0;
-		    if ( i-1 >= 0 && j + 1 < input.columns )
-		      d= output(i-1, j+1);
-		    else
-		      d= 0;
-                    
-                    if ( a == 0 && b == 0 && c == 0 && d == 0 )
-                    {
-                        output(i,j)= label++;
-                        eqv.insert(label - 1, label - 1);
-                    }
-                    else
-                    {
-                        if ( a != 0 )
-                            nn= a;
-                        if ( b != 0 )
-                            nn= b;
-                        if ( c != 0 )
-                            nn= c;
-                        if ( d != 0 )
-                            nn= d;
-                        
-                        if ( a != 0 )
-                            eqv.insert(nn,a);
-                        if ( b != 0 )
-                            eqv.insert(nn,b);
-                        if ( c != 0 )
-                            eqv.insert(nn,c);
-                        if ( d != 0 )
-                            eqv.insert(nn,d);
-                        
-                        output(i,j)= nn;
-                    }
-		  }
-		  else if ( neighborhood == 1 )
-		  {
-		    if ( j-1 >= 0 )
-		      a= output(i,j-1);
-		    else
-		      a= 0;
-		    if ( i-1 >= 0 )
-		      c= output(i-1, j);
-		    else
-		      c= 0;
-                    
-                    if ( a == 0 && c == 0)
-                    {
-                        output(i,j)= label++;
-                        eqv.insert(label - 1, label - 1);
-                    }
-                    else
-                    {
-                        if ( a != 0 )
-                            nn= a;
-                        if ( c != 0 )
-                            nn= c;
-                        
-                        if ( a != 0 )
-                            eqv.insert(nn,a);
-                        if ( c != 0 )
-                            eqv.insert(nn,c);
-                        
-                        output(i,j)= nn;
-                    }
-		  }
+                    if ( j > 0 && input(p - columns - 1) > 0 )
+                        unite(&(parent(0)), p, p - columns - 1);
+                    if ( j + 1 < columns && input(p - columns + 1) > 0 )
+                        unite(&(parent(0)), p, p - columns + 1);
                 }
-        
-        
-        eqv.reduce();
-        for ( unsigned int i= 0; i < output.n; ++i )
-            if ( output(i) > 0 )
-                output(i)= eqv.map(output(i))+1;
-	
-	/*for ( int i= 0; i < eqv.classes.size(); ++i )
-	  delete eqv.classes[i];*/
+            }
+        }
+
+        // the roots are the first pixels of the components, the labels follow the raster order
+        int label= 1;
+        for ( int p= 0; p < n; ++p )
+            if ( parent(p) >= 0 )
+            {
+                int r= findRoot(&(parent(0)), p);
+                output(p)= r == p ? label++ : output(r);
+            }
     }
     
     ExtractRegions::ExtractRegions(int neighborhood)
@@ -268,45 +171,45 @@ namespace openip
     {
     }
 
-    void ExtractRegions::apply(Image<unsigned char>& input, Vector<Region2>& result, bool foreground)
+    void ExtractRegions::apply(Image<unsigned char>& input, CompactRegion2Set& result, bool foreground)
     {
+        result.clear();
+        result.stride= input.columns;
+
 	if ( input.getMax() == 0 )
-	{
-	  result.clear();
 	  return;
-	}
 	
         ComponentLabeling cl(neighborhood);
         Image<int> tmp;
         tmp.resizeImage(input);
-        
-	//tprintf("cl\n");
         cl.apply(input, tmp);
-	//tprintf("cl finished\n");
 
-	//printf("m"); fflush(stdout);
-        int min, max;
-        tmp.getMinMax(min, max);
-        
-        result.resize(max - min + 1);
+        int first= foreground ? 1 : 0;
+        int max= tmp.getMax();
 
-	//printf("n %d,%d,%d", result.size(), max, min); fflush(stdout);
-        for ( unsigned int i= 0; i < result.size(); ++i )
-        {
-            result[i].stride= input.columns;
-            result[i].clear();
-        }
-        //printf("o"); fflush(stdout);
+        // counting sort of the pixels by labels
+        result.offsets.resize(max - first + 2, 0);
         for ( unsigned int i= 0; i < input.n; ++i )
-        {
-            result[tmp(i)].push_back(i);
-        }
-        //printf("p"); fflush(stdout);
-        if ( foreground == true )
-	{
-          result.erase(result.begin());
-	}
-	    
+            if ( tmp(i) >= first )
+                ++result.offsets(tmp(i) - first + 1);
+        for ( unsigned int i= 1; i < result.offsets.size(); ++i )
+            result.offsets(i)+= result.offsets(i-1);
+
+        result.pixels.resize(result.offsets(result.offsets.size() - 1));
+        Vector<int> next(result.offsets);
+        for ( unsigned int i= 0; i < input.n; ++i )
+            if ( tmp(i) >= first )
+                result.pixels(next(tmp(i) - first)++)= i;
+    }
+
+    void ExtractRegions::apply(Image<unsigned char>& input, Vector<Region2>& result, bool foreground)
+    {
+        CompactRegion2Set regions;
+        apply(input, regions, foreground);
+
+        result.resize(regions.size());
+        for ( unsigned int i= 0; i < regions.size(); ++i )
+            regions.getRegion(i, result[i]);
     }
 
     RecursiveComponentLabeling3::RecursiveComponentLabeling3()
@@ -19,6 +19,7 @@
 #include <openipDS/Volume.h>
 #include <openipDS/VoxelSet1.h>
 #include <openipDS/Region2Set.h>
+#include <openipDS/CompactRegion2Set.h>
 #include <openipDS/Region3Set.h>
 #include <queue>
 
@@ -64,6 +65,15 @@ namespace openip
         ~ExtractRegions();
         
         virtual void apply(Image<unsigned char>& input, Vector<Region2>& result, bool foreground= true);
+
+        /**
+         * extracts the connected components of the non-zero pixels in compressed sparse row form,
+         * the pixels of each region are in increasing order
+         * @param input input image
+         * @param result output parameter, the regions
+         * @param foreground if false, the background (zero) pixels are the first region
+         */
+        virtual void apply(Image<unsigned char>& input, CompactRegion2Set& result, bool foreground= true);
 	
 	int neighborhood;
     };
@@ -24,6 +24,12 @@ namespace openip
         ConnectingFilter2(float theta, int width, int length1, int length2, int mask, float eps, int stride= 4000);
 	
 	virtual OUTPUT apply(Image<INPUT>& input, int n, Image<unsigned char>* support= NULL);
+
+	/**
+	 * the position-wise apply is overridden, the compiled evaluation of Filter2 does not apply
+	 * @return 0
+	 */
+	virtual int compilable() { return 0; }
 	
 	void getPositions(Image<unsigned char>& input, Vector<int>& results, int seed, int color);
 	
@@ -258,6 +264,12 @@ namespace openip
         ConnectingDirectionFilter2(float theta, int width, int length1, int length2, int mask, float eps, int stride= 4000);
 	
 	virtual OUTPUT apply(Image<INPUT>& input, int n, Image<unsigned char>* support= NULL);
+
+	/**
+	 * the position-wise apply is overridden, the compiled evaluation of Filter2 does not apply
+	 * @return 0
+	 */
+	virtual int compilable() { return 0; }
 	
 	float theta;
 	float width;
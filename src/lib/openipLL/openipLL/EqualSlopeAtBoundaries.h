@@ -6,6 +6,7 @@
 #include <openipDS/StructuringElement2s.h>
 
 #include <math.h>
+#include <stdlib.h>
 
 int backgroundlength= 5;
 
@@ -22,6 +23,17 @@ namespace openip
     virtual ~EqualSlopeAtBoundaries();
 
     virtual void computeDescriptors(Image<unsigned char>& input, int n, Image<INPUT>& image, float& width, float& dyn, float& ri);
+
+    // the descriptors depend only on the labels in the (2*reach+1)x(2*reach+1) square around n
+    virtual void computeDescriptors(Image<unsigned char>& input, int n, Image<INPUT>& image, float& width, float& dyn, float& ri, int& reach);
+    
+    // batched computeDescriptors: the gradient orientation of each contour pixel is computed once and
+    // shared by the descriptors of its neighbors, the pixels are processed in parallel; the batched
+    // functions of an object must not be called concurrently
+    virtual void computeDescriptors(Image<unsigned char>& input, Vector<int>& pixels, Image<INPUT>& image, Vector<float>& width, Vector<float>& dyn, Vector<float>& ri, Vector<int>* reach= NULL);
+    
+    // batched swidthc
+    virtual void swidthc(Image<unsigned char>& input, Vector<int>& pixels, Vector<float>& widths);
     
     virtual void apply(Image<unsigned char>& input, Image<unsigned char>& output, Image<INPUT>& image);
 
@@ -64,6 +76,16 @@ namespace openip
     virtual int isInnerContour4(Image<unsigned char>& input, int i);
     
     virtual Border2 getProposedBorder();
+    
+    // descriptors of pixel n from the sums of the contour gradients of its 5x5 neighborhood
+    void descriptorsAlongOrientation(Image<unsigned char>& input, int n, Image<INPUT>& image, float ats, float atc, float sum, float& width, float& dyn, float& ri, int& reach);
+    
+    // width of swidthb2 from the sums of the contour gradients of the 5x5 neighborhood of n
+    float widthAlongOrientation(Image<unsigned char>& input, int n, float ats, float atc, float sum);
+    
+    // computes the orientation terms of the contour pixels of the 5x5 neighborhoods of the pixels,
+    // a new batch invalidates the terms of the previous one
+    void prepareOrientations(Image<unsigned char>& input, Vector<int>& pixels, int newBatch= 1);
 
     SobelFilterX<unsigned char, float> sx;
     SobelFilterY<unsigned char, float> sy;
@@ -88,6 +110,17 @@ namespace openip
     Vector<Vector<int> > coordinates;
     Vector<Vector<int> > rows;
     Vector<Vector<int> > columns;
+    
+    // workspace of the batched functions: the orientation terms sin(t)*magn, cos(t)*magn and magn of
+    // the contour pixels, valid where orientationStamp equals stamp
+    Vector<float> orientationSin;
+    Vector<float> orientationCos;
+    Vector<float> orientationMagnitude;
+    Vector<unsigned char> orientationContour;
+    Vector<int> orientationStamp;
+    Vector<float> orientationWidth;
+    Vector<int> widthStamp;
+    int stamp;
   };
 
   template<typename INPUT>
@@ -98,6 +131,7 @@ namespace openip
     this->slope= slope;
     this->width= width;
     this->stride= 0;
+    this->stamp= 0;
     
     generateStructuringElementDisk(sed, r, 4000);
     generateStructuringElementDisk(sed2, 2*r, 4000);
@@ -135,6 +169,7 @@ namespace openip
     this->slope= e.slope;
     this->width= e.width;
     this->stride= e.stride;
+    this->stamp= 0;
     
     sed= e.sed;
   }
@@ -266,6 +301,13 @@ namespace openip
   
   template<typename INPUT>
   void EqualSlopeAtBoundaries<INPUT>::computeDescriptors(Image<unsigned char>& input, int n, Image<INPUT>& image, float& width, float& dyn, float& ri)
+  {
+    int reach;
+    computeDescriptors(input, n, image, width, dyn, ri, reach);
+  }
+  
+  template<typename INPUT>
+  void EqualSlopeAtBoundaries<INPUT>::computeDescriptors(Image<unsigned char>& input, int n, Image<INPUT>& image, float& width, float& dyn, float& ri, int& reach)
   {
     float gx, gy, t;
     float ats, atc, magn;
@@ -291,6 +333,18 @@ namespace openip
 	sum+= magn;
       }
     }
+    
+    descriptorsAlongOrientation(input, n, image, ats, atc, sum, width, dyn, ri, reach);
+  }
+  
+  template<typename INPUT>
+  void EqualSlopeAtBoundaries<INPUT>::descriptorsAlongOrientation(Image<unsigned char>& input, int n, Image<INPUT>& image, float ats, float atc, float sum, float& width, float& dyn, float& ri, int& reach)
+  {
+    float t;
+    
+    // the contour tests and the Sobel filters of the 5x5 window
+    reach= 3;
+    
     if ( (ats == 0 && atc == 0) )
     {
       dyn= ri= 0;
@@ -317,8 +371,10 @@ namespace openip
     
     // determining borders of the intersected vessel
     int a= -1, b= -1;
+    unsigned int last= coordinates(idx).size() - 1;
     for ( unsigned int i= 0; i < coordinates(idx).size(); ++i )
     {
+      last= i;
       //if ( n + coordinates(idx)(i) >= 0 && n + coordinates(idx)(i) < input.n )
       {
 	if ( a == -1 && input(n + coordinates(idx)(i)) > 0 )
@@ -332,6 +388,12 @@ namespace openip
     }
     //printf("c: %d,%d\n", a, b);
     
+    // the points of the line segment are ordered by their distance from n
+    if ( abs(rows(idx)(last)) > reach )
+      reach= abs(rows(idx)(last));
+    if ( abs(columns(idx)(last)) > reach )
+      reach= abs(columns(idx)(last));
+    
     // determining width
     int ar= 0, ac= 0, br= 0, bc= 0;
     if ( a != -1 )
@@ -358,8 +420,10 @@ namespace openip
     int nn= 0;
     int bglength= width/2 < 5 ? 5 : width/2;
     //int bglength= backgroundlength;
+    last= 0;
     for ( unsigned int i= 1; i < coordinates(idx).size() && nn < int(bglength); ++i )
     {
+      last= i;
       if ( n - coordinates(idx)(i) >= 0 && n - coordinates(idx)(i) < int(input.n) && !input(n - coordinates(idx)(i)) && !isOuterContour8(input, n - coordinates(idx)(i)) ) 
       {
 	meanValue+= image(n - coordinates(idx)(i));
@@ -370,6 +434,12 @@ namespace openip
       meanValue/= nn;
     else
       meanValue= 0;
+    
+    // the outer contour test of the background points
+    if ( abs(rows(idx)(last)) + 1 > reach )
+      reach= abs(rows(idx)(last)) + 1;
+    if ( abs(columns(idx)(last)) + 1 > reach )
+      reach= abs(columns(idx)(last)) + 1;
 
     // determining relative intensity
     if ( meanValue == minValue )
@@ -395,6 +465,89 @@ namespace openip
     
     
     
+  }
+  
+  template<typename INPUT>
+  void EqualSlopeAtBoundaries<INPUT>::prepareOrientations(Image<unsigned char>& input, Vector<int>& pixels, int newBatch)
+  {
+    if ( orientationStamp.size() != input.n )
+    {
+      orientationSin.resize(input.n);
+      orientationCos.resize(input.n);
+      orientationMagnitude.resize(input.n);
+      orientationContour.resize(input.n);
+      orientationStamp.resize(input.n);
+      orientationWidth.resize(input.n);
+      widthStamp.resize(input.n);
+      orientationStamp= 0;
+      widthStamp= 0;
+      stamp= 0;
+    }
+    if ( newBatch )
+      ++stamp;
+    
+    Vector<int> positions;
+    for ( unsigned int k= 0; k < pixels.size(); ++k )
+      for ( unsigned int i= 0; i < ses5.size(); ++i )
+      {
+	int m= pixels(k) + ses5(i);
+	if ( m >= 0 && m < int(input.n) && orientationStamp(m) != stamp )
+	{
+	  orientationStamp(m)= stamp;
+	  positions.push_back(m);
+	}
+      }
+    
+    #pragma omp parallel for
+    for ( unsigned int k= 0; k < positions.size(); ++k )
+    {
+      int m= positions(k);
+      orientationContour(m)= (isOuterContour8(input, m) || isInnerContour8(input, m));
+      if ( orientationContour(m) )
+      {
+	float gx= sx.apply(input, m);
+	float gy= sy.apply(input, m);
+	float t= atan2(gy, gx);
+	float magn= sqrt(gx*gx + gy*gy);
+	orientationSin(m)= sin(t)*magn;
+	orientationCos(m)= cos(t)*magn;
+	orientationMagnitude(m)= magn;
+      }
+    }
+  }
+  
+  template<typename INPUT>
+  void EqualSlopeAtBoundaries<INPUT>::computeDescriptors(Image<unsigned char>& input, Vector<int>& pixels, Image<INPUT>& image, Vector<float>& width, Vector<float>& dyn, Vector<float>& ri, Vector<int>* reach)
+  {
+    prepareOrientations(input, pixels);
+    
+    width.resize(pixels.size());
+    dyn.resize(pixels.size());
+    ri.resize(pixels.size());
+    if ( reach )
+      reach->resize(pixels.size());
+    
+    #pragma omp parallel for schedule(dynamic, 64)
+    for ( unsigned int k= 0; k < pixels.size(); ++k )
+    {
+      int n= pixels(k);
+      float ats= 0, atc= 0, sum= 0;
+      for ( unsigned int i= 0; i < ses5.size(); ++i )
+      {
+	int m= n + ses5(i);
+	if ( m >= 0 && m < int(input.n) && orientationContour(m) )
+	{
+	  ats+= orientationSin(m);
+	  atc+= orientationCos(m);
+	  sum+= orientationMagnitude(m);
+	}
+      }
+      
+      int r;
+      descriptorsAlongOrientation(input, n, image, ats, atc, sum, width(k), dyn(k), ri(k), r);
+      if ( reach )
+	(*reach)(k)= r;
+    }
   }
   
   template<typename INPUT>
@@ -597,7 +750,14 @@ namespace openip
       }
     }
 
-    //printf("%f ", sum); fflush(stdout);
+    return widthAlongOrientation(input, n, ats, atc, sum);
+  }
+  
+  template<typename INPUT>
+  float EqualSlopeAtBoundaries<INPUT>::widthAlongOrientation(Image<unsigned char>& input, int n, float ats, float atc, float sum)
+  {
+    float t;
+    
     if ( (ats == 0 && atc == 0) /*|| sum == 0*/ )
       return -1;
     
@@ -606,77 +766,48 @@ namespace openip
     
     t= atan2(atc, ats);
     
-    //printf("a:%f ", t);
-    
-    // determining points of the line segment
-    Vector<int> pr;
-    Vector<int> pc;
+    // the points of the line segment are generated only until the far border of the vessel is found
+    int a= -1, b= -1;
+    int ar= 0, ac= 0, br= 0, bc= 0;
+    int pr= 0, pc= 0, np= 0, inside= 0;
     for ( int i= 0; i < length*4; ++i )
     {
       int c= (cos(t)*i*0.25);
       int r= (sin(t)*i*0.25);
       
-      //int m= (r*input.columns + c);
+      if ( np > 0 && pr == r && pc == c )
+        continue;
+      pr= r;
+      pc= c;
+      ++np;
       
-      if ( pr.size() == 0 || (pr(pr.size()-1) != r || pc(pc.size()-1) != c) )
+      int m= n + r*input.columns + c;
+      inside= (m >= 0 && m < int(input.n));
+      if ( inside )
       {
-	pr.push_back(r);
-	pc.push_back(c);
+        if ( a == -1 && input(m) > 0 )
+        {
+          a= np - 1;
+          ar= r;
+          ac= c;
+        }
+        if ( a != -1 && input(m) == 0 )
+        {
+          b= np - 1;
+          br= r;
+          bc= c;
+          break;
+        }
       }
     }
-    
-    /*for ( int i= 0; i < pr.size(); ++i )
-      printf("%d,%d ", pr(i), pc(i));
-    printf("\n");*/
-    
-    // determining borders of the intersected vessel
-    int a= -1, b= -1;
-    for ( unsigned int i= 0; i < pr.size(); ++i )
+    // the last point of the segment closes the vessel
+    if ( b == -1 && a != -1 && inside )
     {
-      if ( n + pr(i)*input.columns + pc(i) >= 0 && n + pr(i)*input.columns + pc(i) < int(input.n) )
-      {
-	if ( a == -1 && input(n + pr(i)*input.columns + pc(i)) > 0 )
-	  a= i;
-	if ( a != -1 && (input(n + pr(i)*input.columns + pc(i)) == 0 || i == pr.size()-1) )
-	{
-	  b= i;
-	  break;
-	}
-      }
-      /*else
-	break;*/
+      br= pr;
+      bc= pc;
     }
-    //printf("c: %d,%d\n", a, b);
-    Region2 r;
-    r.stride= input.columns;
     
-    int ar, ac, br, bc;
-    if ( a != -1 )
-    {
-	//r.getCoordinate2D(p(a), ar, ac);
-      ar= pr(a);
-      ac= pc(a);
-    }
-    else
-      ar= ac= 0;
-    if ( b != -1 )
-    {
-      //r.getCoordinate2D(p(b), br, bc);
-      br= pr(b);
-      bc= pc(b);
-    }
-    else
-      br= bc= 0;
-    //printf("%d,%d,%d,%d,%d,%d ", p(a),p(b),ar, ac, br, bc);
-    float wid= sqrt((ar - br)*(ar - br) + (ac - bc)*(ac - bc));
-    //printf("width: %f\n", wid);
-    return (wid);
-    
-    /*if ( b == -1 || a == -1 )
-      return 0;
-    
-    return (b-a);*/
-    //return 0;
+    return sqrt((ar - br)*(ar - br) + (ac - bc)*(ac - bc));
   }
   
   template<typename INPUT>
@@ -716,6 +847,63 @@ namespace openip
     return 0;
   }  
   
+  template<typename INPUT>
+  void EqualSlopeAtBoundaries<INPUT>::swidthc(Image<unsigned char>& input, Vector<int>& pixels, Vector<float>& widths)
+  {
+    prepareOrientations(input, pixels);
+    
+    // the swidthb2 widths of the contour pixels around the pixels, each computed once
+    Vector<int> centers;
+    for ( unsigned int k= 0; k < pixels.size(); ++k )
+      for ( unsigned int i= 0; i < ses5.size(); ++i )
+      {
+	int m= pixels(k) + ses5(i);
+	if ( m >= 0 && m < int(input.n) && orientationContour(m) && widthStamp(m) != stamp )
+	{
+	  widthStamp(m)= stamp;
+	  centers.push_back(m);
+	}
+      }
+    
+    prepareOrientations(input, centers, 0);
+    
+    #pragma omp parallel for schedule(dynamic, 64)
+    for ( unsigned int k= 0; k < centers.size(); ++k )
+    {
+      int n= centers(k);
+      float ats= 0, atc= 0, sum= 0;
+      for ( unsigned int i= 0; i < ses5.size(); ++i )
+      {
+	int m= n + ses5(i);
+	if ( m >= 0 && m < int(input.n) && orientationContour(m) && m >= input.columns+1 && m < int(input.n) - input.columns-1 )
+	{
+	  ats+= orientationSin(m);
+	  atc+= orientationCos(m);
+	  sum+= orientationMagnitude(m);
+	}
+      }
+      orientationWidth(n)= widthAlongOrientation(input, n, ats, atc, sum);
+    }
+    
+    widths.resize(pixels.size());
+    #pragma omp parallel for schedule(dynamic, 64)
+    for ( unsigned int k= 0; k < pixels.size(); ++k )
+    {
+      Vector<float> w;
+      for ( unsigned int i= 0; i < ses5.size(); ++i )
+      {
+	int m= pixels(k) + ses5(i);
+	if ( m >= 0 && m < int(input.n) && orientationContour(m) )
+	{
+	  int wth= orientationWidth(m);
+	  if ( wth >= 0 )
+	    w.push_back(wth);
+	}
+      }
+      widths(k)= w.size() > 0 ? w.getMean() : 0;
+    }
+  }
+  
   template<typename INPUT>
   int EqualSlopeAtBoundaries<INPUT>::debug(Image<unsigned char>& /*input*/, int /*n*/, Image<INPUT>& /*image*/)
   {
@@ -0,0 +1,273 @@
+/**
+ * @file FastMorphology.h
+ * @author Gyorgy Kovacs <gyuriofkovacs@gmail.com>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * http://www.gnu.org/copyleft/gpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * Fast erosion and dilation for large structuring elements. The structuring
+ * element is decomposed into horizontal runs, one per row; the extremum of a
+ * run is computed by the van Herk/Gil-Werman algorithm with 3 comparisons per
+ * pixel independently of the length of the run. Rectangles (squares, lines)
+ * are separable, the extremum of the rows is computed by van Herk/Gil-Werman
+ * along the columns; other row-convex elements (disks) are evaluated as the
+ * extremum of the runs of their rows. The results are identical to the
+ * evaluation of all the pixels of the structuring element.
+ */
+
+#ifndef _FAST_MORPHOLOGY_H_
+#define _FAST_MORPHOLOGY_H_
+
+#include <stdlib.h>
+#include <limits>
+#include <algorithm>
+
+#include <openipDS/Image.h>
+#include <openipDS/Vector.h>
+#include <openipDS/StructuringElement2.h>
+
+namespace openip
+{
+    /**
+     * selector of the maximum for the running extremum computations
+     */
+    template<typename T>
+    struct MaxSelector
+    {
+        static T select(T a, T b)
+        {
+            return a > b ? a : b;
+        }
+
+        static T neutral()
+        {
+            return std::numeric_limits<T>::is_integer ? std::numeric_limits<T>::min() : -std::numeric_limits<T>::max();
+        }
+    };
+
+    /**
+     * selector of the minimum for the running extremum computations
+     */
+    template<typename T>
+    struct MinSelector
+    {
+        static T select(T a, T b)
+        {
+            return a < b ? a : b;
+        }
+
+        static T neutral()
+        {
+            return std::numeric_limits<T>::max();
+        }
+    };
+
+    /**
+     * van Herk/Gil-Werman running extremum: out[q] is the extremum of in[q], in[q + step], ...,
+     * in[q + (length-1)*step], for all q with q + (length-1)*step < n, other elements of out are not changed
+     * @param in input array of n elements
+     * @param out output array of n elements
+     * @param n number of elements
+     * @param step distance of the elements of the window, 1 for rows, the stride for columns
+     * @param length number of elements in the window
+     * @param g temporary array of n elements
+     * @param h temporary array of n elements
+     */
+    template<typename T, typename SELECTOR>
+    void runningExtremum(const T* in, T* out, int n, int step, int length, T* g, T* h)
+    {
+        int lines= (n + step - 1)/step;
+        int blocks= (lines + length - 1)/length;
+
+        #pragma omp parallel for
+        for ( int b= 0; b < blocks; ++b )
+        {
+            int m0= b*length;
+            int m1= std::min(m0 + length, lines);
+            for ( int m= m0; m < m1; ++m )
+                for ( int r= 0, q= m*step; r < step && q < n; ++r, ++q )
+                    g[q]= m == m0 ? in[q] : SELECTOR::select(g[q - step], in[q]);
+            for ( int m= m1 - 1; m >= m0; --m )
+                for ( int r= 0, q= m*step; r < step && q < n; ++r, ++q )
+                    h[q]= ( m == m1 - 1 || q + step >= n ) ? in[q] : SELECTOR::select(h[q + step], in[q]);
+        }
+
+        int last= n - (length - 1)*step;
+        #pragma omp parallel for
+        for ( int q= 0; q < last; ++q )
+            out[q]= SELECTOR::select(h[q], g[q + (length - 1)*step]);
+    }
+
+    /**
+     * decomposition of a structuring element into horizontal runs, one run per row
+     */
+    class StructuringElementRuns
+    {
+    public:
+        /**
+         * decomposes the structuring element
+         * @param se structuring element, the stride must be updated in advance
+         * @return 0 if each row of the element is one contiguous run, 1 otherwise
+         */
+        int decompose(StructuringElement2& se)
+        {
+            stride= se.stride;
+            rows.clear();
+            begins.clear();
+            lengths.clear();
+            rectangular= 0;
+            cost= 0;
+
+            if ( se.size() == 0 || stride <= 0 )
+                return 1;
+
+            Vector<std::pair<int, int> > rc;
+            for ( StructuringElement2::iterator sit= se.begin(); sit != se.end(); ++sit )
+            {
+                int r= *sit / stride;
+                if ( abs(*sit % stride) > stride/2 )
+                    r= (*sit > 0) ? r+1 : r-1;
+                rc.push_back(std::pair<int, int>(r, *sit - r*stride));
+            }
+            std::sort(rc.begin(), rc.end());
+            rc.erase(std::unique(rc.begin(), rc.end()), rc.end());
+
+            for ( unsigned int k= 0; k < rc.size(); ++k )
+            {
+                if ( k > 0 && rc(k).first == rc(k-1).first )
+                {
+                    if ( rc(k).second != rc(k-1).second + 1 )
+                        return 1;
+                    ++lengths(lengths.size() - 1);
+                }
+                else
+                {
+                    rows.push_back(rc(k).first);
+                    begins.push_back(rc(k).second);
+                    lengths.push_back(1);
+                }
+            }
+
+            rectangular= 1;
+            for ( unsigned int k= 1; k < rows.size(); ++k )
+                if ( rows(k) != rows(k-1) + 1 || begins(k) != begins(0) || lengths(k) != lengths(0) )
+                    rectangular= 0;
+
+            if ( rectangular )
+                cost= 6;
+            else
+            {
+                Vector<int> distinct(lengths);
+                std::sort(distinct.begin(), distinct.end());
+                distinct.erase(std::unique(distinct.begin(), distinct.end()), distinct.end());
+                cost= 3*distinct.size() + rows.size();
+            }
+
+            return 0;
+        }
+
+        /**
+         * computes the extremum of the input in the positions of the structuring element, for the
+         * positions in [start, end), the decomposition must be computed in advance
+         * @param input input array of n elements
+         * @param n number of elements
+         * @param start first position
+         * @param end position after the last one
+         * @param result output array of n elements, the positions outside [start, end) are undefined
+         */
+        template<typename T, typename SELECTOR>
+        void apply(const T* input, int n, int start, int end, T* result)
+        {
+            Vector<T> f(n), g(n), h(n);
+
+            if ( rectangular )
+            {
+                Vector<T> v(n);
+                std::fill(f.begin(), f.end(), SELECTOR::neutral());
+                std::fill(v.begin(), v.end(), SELECTOR::neutral());
+                runningExtremum<T, SELECTOR>(input, &(f(0)), n, 1, lengths(0), &(g(0)), &(h(0)));
+                runningExtremum<T, SELECTOR>(&(f(0)), &(v(0)), n, stride, rows.size(), &(g(0)), &(h(0)));
+                int shift= rows(0)*stride + begins(0);
+                #pragma omp parallel for
+                for ( int i= start; i < end; ++i )
+                    result[i]= v(i + shift);
+                return;
+            }
+
+            #pragma omp parallel for
+            for ( int i= start; i < end; ++i )
+                result[i]= SELECTOR::neutral();
+
+            Vector<int> done(rows.size(), 0);
+            Vector<int> shifts;
+            for ( unsigned int k= 0; k < rows.size(); ++k )
+            {
+                if ( done(k) )
+                    continue;
+
+                shifts.clear();
+                for ( unsigned int l= k; l < rows.size(); ++l )
+                    if ( lengths(l) == lengths(k) )
+                    {
+                        shifts.push_back(rows(l)*stride + begins(l));
+                        done(l)= 1;
+                    }
+
+                runningExtremum<T, SELECTOR>(input, &(f(0)), n, 1, lengths(k), &(g(0)), &(h(0)));
+
+                int ns= shifts.size();
+                #pragma omp parallel for
+                for ( int i= start; i < end; ++i )
+                {
+                    T r= result[i];
+                    for ( int s= 0; s < ns; ++s )
+                        r= SELECTOR::select(r, f(i + shifts(s)));
+                    result[i]= r;
+                }
+            }
+        }
+
+        /** stride of the structuring element */
+        int stride;
+        /** row offsets of the runs */
+        Vector<int> rows;
+        /** column offsets of the first pixels of the runs */
+        Vector<int> begins;
+        /** lengths of the runs */
+        Vector<int> lengths;
+        /** 1 if the runs form a rectangle */
+        int rectangular;
+        /** estimated number of operations per pixel */
+        int cost;
+    };
+
+    /**
+     * decides if the fast evaluation is applicable and worth for the structuring element
+     * @param se structuring element, the stride must be updated in advance
+     * @param runs output parameter, the decomposition of the structuring element
+     * @return 1 if the fast evaluation should be used, 0 otherwise
+     */
+    inline int useFastMorphology(StructuringElement2& se, StructuringElementRuns& runs)
+    {
+        if ( se.size() < 16 )
+            return 0;
+        if ( runs.decompose(se) )
+            return 0;
+        return 2*runs.cost < int(se.size());
+    }
+}
+
+#endif
@@ -0,0 +1,301 @@
+#include <openipLL/FilterResponseCache.h>
+#include <openipLL/libmd5/md5.h>
+
+#include <openipDS/minilzo/minilzo.h>
+
+#include <algorithm>
+#include <utility>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define FILTER_RESPONSE_CACHE_MAGIC "OIPFRC1"
+#define FILTER_RESPONSE_CACHE_VERSION 1
+
+namespace openip
+{
+    FilterResponseCache::FilterResponseCache()
+    {
+        hits= 0;
+        misses= 0;
+        fd= -1;
+        base= NULL;
+        mappedSize= 0;
+        header= NULL;
+        entries= NULL;
+        data= NULL;
+        compression= 1;
+        omp_init_lock(&ompLock);
+        lzo_init();
+    }
+
+    FilterResponseCache::~FilterResponseCache()
+    {
+        close();
+        omp_destroy_lock(&ompLock);
+    }
+
+    int FilterResponseCache::open(const char* filename, long long budget, int compression, int slots)
+    {
+        close();
+        this->compression= compression;
+
+        fd= ::open(filename, O_RDWR | O_CREAT, 0644);
+        if ( fd < 0 )
+            return 1;
+
+        flock(fd, LOCK_EX);
+
+        struct stat st;
+        fstat(fd, &st);
+
+        long long size= st.st_size;
+        int initialize= 0;
+        if ( size < (long long)sizeof(FilterResponseCacheHeader) )
+            initialize= 1;
+        else
+        {
+            FilterResponseCacheHeader h;
+            if ( pread(fd, &h, sizeof(h), 0) != (ssize_t)sizeof(h) || memcmp(h.magic, FILTER_RESPONSE_CACHE_MAGIC, sizeof(h.magic)) != 0 || h.version != FILTER_RESPONSE_CACHE_VERSION
+                || size != (long long)sizeof(FilterResponseCacheHeader) + h.slots*(long long)sizeof(FilterResponseCacheEntry) + h.capacity )
+                initialize= 1;
+        }
+
+        if ( initialize )
+        {
+            // the file is not a valid container, it is rebuilt with zero filled (invalid) slots
+            size= sizeof(FilterResponseCacheHeader) + slots*(long long)sizeof(FilterResponseCacheEntry) + budget;
+            if ( ftruncate(fd, 0) != 0 || ftruncate(fd, size) != 0 )
+            {
+                flock(fd, LOCK_UN);
+                ::close(fd);
+                fd= -1;
+                return 1;
+            }
+        }
+
+        void* m= mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if ( m == MAP_FAILED )
+        {
+            flock(fd, LOCK_UN);
+            ::close(fd);
+            fd= -1;
+            return 1;
+        }
+
+        base= (char*)m;
+        mappedSize= size;
+        header= (FilterResponseCacheHeader*)base;
+        if ( initialize )
+        {
+            strcpy(header->magic, FILTER_RESPONSE_CACHE_MAGIC);
+            header->version= FILTER_RESPONSE_CACHE_VERSION;
+            header->slots= slots;
+            header->capacity= budget;
+            header->clock= 0;
+        }
+        entries= (FilterResponseCacheEntry*)(base + sizeof(FilterResponseCacheHeader));
+        data= (char*)(entries + header->slots);
+
+        flock(fd, LOCK_UN);
+
+        return 0;
+    }
+
+    void FilterResponseCache::close()
+    {
+        if ( base )
+            munmap(base, mappedSize);
+        if ( fd >= 0 )
+            ::close(fd);
+        fd= -1;
+        base= NULL;
+        mappedSize= 0;
+        header= NULL;
+        entries= NULL;
+        data= NULL;
+    }
+
+    int FilterResponseCache::isOpen()
+    {
+        return base != NULL;
+    }
+
+    void FilterResponseCache::lock()
+    {
+        omp_set_lock(&ompLock);
+        flock(fd, LOCK_EX);
+    }
+
+    void FilterResponseCache::unlock()
+    {
+        flock(fd, LOCK_UN);
+        omp_unset_lock(&ompLock);
+    }
+
+    int FilterResponseCache::findEntry(const unsigned char* key)
+    {
+        for ( int i= 0; i < header->slots; ++i )
+            if ( entries[i].valid && memcmp(entries[i].key, key, 16) == 0 )
+                return i;
+        return -1;
+    }
+
+    long long FilterResponseCache::findGap(long long length)
+    {
+        Vector<std::pair<long long, long long> > used;
+        for ( int i= 0; i < header->slots; ++i )
+            if ( entries[i].valid )
+                used.push_back(std::pair<long long, long long>(entries[i].offset, entries[i].length));
+        std::sort(used.begin(), used.end());
+
+        long long offset= 0;
+        for ( unsigned int i= 0; i < used.size(); ++i )
+        {
+            if ( used(i).first - offset >= length )
+                return offset;
+            offset= used(i).first + used(i).second;
+        }
+        if ( header->capacity - offset >= length )
+            return offset;
+        return -1;
+    }
+
+    int FilterResponseCache::get(const std::string& key, Image<float>& image)
+    {
+        if ( !isOpen() || image.n == 0 )
+            return 1;
+
+        unsigned char k[16];
+        md5_buffer(key.c_str(), key.size(), k);
+
+        // the compressed entry is copied under the lock and decompressed after unlocking the container
+        int result= 1;
+        Vector<unsigned char> compressed;
+        lock();
+        int i= findEntry(k);
+        if ( i >= 0 && entries[i].bytes == (long long)(image.n*sizeof(float)) )
+        {
+            FilterResponseCacheEntry& e= entries[i];
+            if ( e.compressed )
+            {
+                compressed.resize(e.length);
+                memcpy(&(compressed(0)), data + e.offset, e.length);
+            }
+            else
+                memcpy(&(image(0)), data + e.offset, e.bytes);
+            e.lastUse= ++header->clock;
+            result= 0;
+        }
+        unlock();
+
+        if ( result == 0 && compressed.size() )
+        {
+            lzo_uint decompressed= image.n*sizeof(float);
+            if ( lzo1x_decompress_safe(&(compressed(0)), compressed.size(), (unsigned char*)&(image(0)), &decompressed, NULL) != LZO_E_OK || decompressed != image.n*sizeof(float) )
+                result= 1;
+        }
+
+        #pragma omp atomic
+        hits+= (result == 0);
+        #pragma omp atomic
+        misses+= (result != 0);
+
+        return result;
+    }
+
+    int FilterResponseCache::put(const std::string& key, Image<float>& image)
+    {
+        if ( !isOpen() || image.n == 0 )
+            return 1;
+
+        unsigned char k[16];
+        md5_buffer(key.c_str(), key.size(), k);
+
+        // the compression is done before locking the container
+        long long bytes= image.n*sizeof(float);
+        const char* src= (const char*)&(image(0));
+        long long length= bytes;
+        unsigned char* compressed= NULL;
+        if ( compression )
+        {
+            compressed= (unsigned char*)malloc(bytes + bytes/16 + 64 + 3);
+            void* wrkmem= malloc(LZO1X_1_MEM_COMPRESS);
+            lzo_uint clength;
+            if ( lzo1x_1_compress((const unsigned char*)src, bytes, compressed, &clength, wrkmem) == LZO_E_OK && (long long)clength < bytes )
+            {
+                src= (const char*)compressed;
+                length= clength;
+            }
+            free(wrkmem);
+        }
+
+        int result= 1;
+        lock();
+        if ( findEntry(k) >= 0 )
+            result= 0;
+        else if ( length <= header->capacity )
+        {
+            // the least recently used entries are evicted until a free slot and a large enough gap is found
+            while ( 1 )
+            {
+                int slot= -1;
+                int lru= -1;
+                for ( int i= 0; i < header->slots; ++i )
+                {
+                    if ( !entries[i].valid && slot < 0 )
+                        slot= i;
+                    if ( entries[i].valid && (lru < 0 || entries[i].lastUse < entries[lru].lastUse) )
+                        lru= i;
+                }
+                long long offset= slot >= 0 ? findGap(length) : -1;
+                if ( slot >= 0 && offset >= 0 )
+                {
+                    FilterResponseCacheEntry& e= entries[slot];
+                    memcpy(data + offset, src, length);
+                    memcpy(e.key, k, 16);
+                    e.offset= offset;
+                    e.length= length;
+                    e.bytes= bytes;
+                    e.compressed= (src != (const char*)&(image(0)));
+                    e.lastUse= ++header->clock;
+                    e.valid= 1;
+                    result= 0;
+                    break;
+                }
+                if ( lru < 0 )
+                    break;
+                entries[lru].valid= 0;
+            }
+        }
+        unlock();
+
+        free(compressed);
+
+        return result;
+    }
+
+    std::string FilterResponseCache::digest(Image<float>& image, Image<unsigned char>* mask)
+    {
+        md5_t md5;
+        md5_init(&md5);
+
+        int size[2]= {image.rows, image.columns};
+        md5_process(&md5, size, sizeof(size));
+        if ( image.n )
+            md5_process(&md5, &(image(0)), image.n*sizeof(float));
+        if ( mask && mask->n )
+            md5_process(&md5, &((*mask)(0)), mask->n);
+
+        char signature[16];
+        char str[33];
+        md5_finish(&md5, signature);
+        md5_sig_to_string(signature, str, 33);
+
+        return std::string(str);
+    }
+}
@@ -0,0 +1,193 @@
+/**
+ * @file FilterResponseCache.h
+ * @author Gyorgy Kovacs <gyuriofkovacs@gmail.com>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * http://www.gnu.org/copyleft/gpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * The FilterResponseCache stores filter responses in one memory-mapped
+ * container file. The entries are addressed by the MD5 digest of a key
+ * string, which is usually composed of the digest of the filtered image
+ * (FilterResponseCache::digest) and the parameters of the filter. The
+ * entries are optionally compressed by minilzo. The size of the data area is
+ * fixed when the container is created, the least recently used entries are
+ * evicted when a new entry does not fit. The container can be shared by the
+ * threads of a process and by several processes: the accesses are
+ * serialized by an OpenMP lock and by flock on the container file.
+ */
+
+#ifndef _FILTER_RESPONSE_CACHE_H_
+#define _FILTER_RESPONSE_CACHE_H_
+
+#include <string>
+
+#include <omp.h>
+
+#include <openipDS/Image.h>
+
+namespace openip
+{
+    /**
+     * header of the container file
+     */
+    struct FilterResponseCacheHeader
+    {
+        /** magic string identifying the container */
+        char magic[8];
+        /** version of the layout */
+        int version;
+        /** number of entry slots */
+        int slots;
+        /** size of the data area in bytes */
+        long long capacity;
+        /** logical clock of the accesses, used for LRU eviction */
+        long long clock;
+    };
+
+    /**
+     * entry slot of the container file
+     */
+    struct FilterResponseCacheEntry
+    {
+        /** MD5 digest of the key */
+        unsigned char key[16];
+        /** offset of the stored data in the data area */
+        long long offset;
+        /** number of stored bytes */
+        long long length;
+        /** number of bytes of the uncompressed data */
+        long long bytes;
+        /** time of the last access */
+        long long lastUse;
+        /** 1 if the data is compressed */
+        int compressed;
+        /** 1 if the slot holds a complete entry */
+        int valid;
+    };
+
+    /**
+     * memory-mapped, content-addressed cache of float images with LRU eviction
+     */
+    class FilterResponseCache
+    {
+    public:
+        /**
+         * default constructor, the cache is closed
+         */
+        FilterResponseCache();
+
+        /**
+         * destructor, closes the cache
+         */
+        ~FilterResponseCache();
+
+        /**
+         * opens the container file, it is created if it does not exist; the budget and the number of
+         * slots of an existing container are not changed
+         * @param filename name of the container file
+         * @param budget size of the data area in bytes
+         * @param compression 1 to compress the entries by minilzo, 0 otherwise
+         * @param slots maximum number of entries
+         * @return 0 on success, non-zero if the container can not be opened
+         */
+        int open(const char* filename, long long budget, int compression= 1, int slots= 4096);
+
+        /**
+         * closes the container file
+         */
+        void close();
+
+        /**
+         * tests if the cache is open
+         * @return 1 if the cache is open, 0 otherwise
+         */
+        int isOpen();
+
+        /**
+         * looks up an entry
+         * @param key key of the entry
+         * @param image output parameter, it has to be resized to the size of the stored image in advance
+         * @return 0 if the entry was found and loaded, non-zero otherwise
+         */
+        int get(const std::string& key, Image<float>& image);
+
+        /**
+         * stores an entry, least recently used entries are evicted if necessary; if the key is already
+         * present, the entry is not changed
+         * @param key key of the entry
+         * @param image the image to store
+         * @return 0 on success, non-zero if the image does not fit the container
+         */
+        int put(const std::string& key, Image<float>& image);
+
+        /**
+         * computes the hexadecimal MD5 digest of the content of an image and optionally a mask
+         * @param image input image
+         * @param mask mask image, NULL if not used
+         * @return the digest
+         */
+        static std::string digest(Image<float>& image, Image<unsigned char>* mask= NULL);
+
+        /** number of successful lookups */
+        int hits;
+        /** number of unsuccessful lookups */
+        int misses;
+
+    protected:
+        /**
+         * acquires the in-process and the inter-process locks
+         */
+        void lock();
+
+        /**
+         * releases the locks
+         */
+        void unlock();
+
+        /**
+         * finds the slot of a key
+         * @param key MD5 digest of the key
+         * @return index of the slot, -1 if the key is not present
+         */
+        int findEntry(const unsigned char* key);
+
+        /**
+         * finds the first gap of the data area where length bytes fit
+         * @param length number of bytes
+         * @return offset of the gap, -1 if there is no gap large enough
+         */
+        long long findGap(long long length);
+
+        /** file descriptor of the container */
+        int fd;
+        /** mapped container */
+        char* base;
+        /** size of the mapping */
+        long long mappedSize;
+        /** header of the container */
+        FilterResponseCacheHeader* header;
+        /** entry slots of the container */
+        FilterResponseCacheEntry* entries;
+        /** data area of the container */
+        char* data;
+        /** 1 if the new entries are compressed */
+        int compression;
+        /** lock serializing the threads of the process */
+        omp_lock_t ompLock;
+    };
+}
+
+#endif
@@ -176,6 +176,8 @@ namespace openip
 
          MatchedCCorrelationPowerGaborFilterR2<INPUT, OUTPUT>* mgf;
          NeighborhoodRegionGrowing<OUTPUT>* rg;
+         /** scale of the filters in mgf, regenerate() rebuilds them only if scale has changed */
+         float mgfScale;
 
          float th1;
          float th2;
@@ -200,6 +202,7 @@ namespace openip
      {
          mgf= new MatchedCCorrelationPowerGaborFilterR2<INPUT, OUTPUT>(sigma, theta0, step, theta1, lambda, psi, gamma, powerFactor, scale);
          rg= new NeighborhoodRegionGrowing<OUTPUT>(REGION_GROWING_HARD_THRESHOLD, th2);
+         mgfScale= scale;
 
          std::stringstream ss;
          ss << "PowerGaborRGLineSegmentTransform2 " << th1 << " " << th2 << " " << sigma << " " << theta0 << " " << step << " " << theta1 << " " << lambda << " " << psi << " " << gamma << " " << powerFactor;
@@ -209,8 +212,12 @@ namespace openip
      template<typename INPUT, typename OUTPUT>
      void PowerGaborRGLineSegmentTransform2<INPUT, OUTPUT>::regenerate()
      {
-       delete mgf;
-       mgf= new MatchedCCorrelationPowerGaborFilterR2<INPUT, OUTPUT>(sigma, theta0, step, theta1, lambda, psi, gamma, powerFactor, scale);
+       if ( scale != mgfScale )
+       {
+         delete mgf;
+         mgf= new MatchedCCorrelationPowerGaborFilterR2<INPUT, OUTPUT>(sigma, theta0, step, theta1, lambda, psi, gamma, powerFactor, scale);
+         mgfScale= scale;
+       }
        delete rg;
        rg= new NeighborhoodRegionGrowing<OUTPUT>(REGION_GROWING_HARD_THRESHOLD, th2);
      }
@@ -224,13 +231,15 @@ namespace openip
 
      template<typename INPUT, typename OUTPUT>
      PowerGaborRGLineSegmentTransform2<INPUT, OUTPUT>::PowerGaborRGLineSegmentTransform2(const PowerGaborRGLineSegmentTransform2& a)
-     : Transform2<INPUT, OUTPUT>(a)
+     : Transform2<INPUT, OUTPUT>(a), mgf(NULL), rg(NULL)
      {
      }
 
      template<typename INPUT, typename OUTPUT>
      PowerGaborRGLineSegmentTransform2<INPUT, OUTPUT>::~PowerGaborRGLineSegmentTransform2()
      {
+         delete mgf;
+         delete rg;
      }
 
      template<typename INPUT, typename OUTPUT>
@@ -498,6 +507,8 @@ namespace openip
 
          MatchedCCorrelationPowerGaborFilterSimpleR2<INPUT, OUTPUT>* mgf;
          NeighborhoodRegionGrowing<OUTPUT>* rg;
+         /** scale of the filters in mgf, regenerate() rebuilds them only if scale has changed */
+         float mgfScale;
 
          float th1;
          float th2;
@@ -522,6 +533,7 @@ namespace openip
      {
          mgf= new MatchedCCorrelationPowerGaborFilterSimpleR2<INPUT, OUTPUT>(sigma, theta0, step, theta1, lambda, psi, gamma, powerFactor, scale);
          rg= new NeighborhoodRegionGrowing<OUTPUT>(REGION_GROWING_HARD_THRESHOLD, th2);
+         mgfScale= scale;
 
          std::stringstream ss;
          ss << "PowerGaborSimpleRGLineSegmentTransform2 " << th1 << " " << th2 << " " << sigma << " " << theta0 << " " << step << " " << theta1 << " " << lambda << " " << psi << " " << gamma << " " << powerFactor;
@@ -532,8 +544,12 @@ namespace openip
      void PowerGaborSimpleRGLineSegmentTransform2<INPUT, OUTPUT>::regenerate()
      {
        //tprintf("regenerate, scale: %d %f %d\n", mgf->size(), scale, mgf->operator[](0)->size());
-       delete mgf;
-       mgf= new MatchedCCorrelationPowerGaborFilterSimpleR2<INPUT, OUTPUT>(sigma, theta0, step, theta1, lambda, psi, gamma, powerFactor, scale);
+       if ( scale != mgfScale )
+       {
+         delete mgf;
+         mgf= new MatchedCCorrelationPowerGaborFilterSimpleR2<INPUT, OUTPUT>(sigma, theta0, step, theta1, lambda, psi, gamma, powerFactor, scale);
+         mgfScale= scale;
+       }
        //tprintf("regenerate, size: %d\n", mgf->operator[](0)->size());
        delete rg;
        rg= new NeighborhoodRegionGrowing<OUTPUT>(REGION_GROWING_HARD_THRESHOLD, th2);
@@ -548,13 +564,15 @@ namespace openip
      
      template<typename INPUT, typename OUTPUT>
      PowerGaborSimpleRGLineSegmentTransform2<INPUT, OUTPUT>::PowerGaborSimpleRGLineSegmentTransform2(const PowerGaborSimpleRGLineSegmentTransform2& a)
-     : Transform2<INPUT, OUTPUT>(a)
+     : Transform2<INPUT, OUTPUT>(a), mgf(NULL), rg(NULL)
      {
      }
 
      template<typename INPUT, typename OUTPUT>
      PowerGaborSimpleRGLineSegmentTransform2<INPUT, OUTPUT>::~PowerGaborSimpleRGLineSegmentTransform2()
      {
+         delete mgf;
+         delete rg;
      }
 
      template<typename INPUT, typename OUTPUT>
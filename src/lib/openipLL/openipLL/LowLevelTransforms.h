@@ -1532,7 +1532,24 @@ namespace openip
 	
 	//writeImage("roi0.bmp", roi2);
 	
-	
+	// input2 and roioriginal do not change during the extension, the gradient field is computed once
+	tprintf("computing gradient field\n");
+	Image<float> gmagn, gorient;
+	gmagn.resizeImage(input2);
+	gorient.resizeImage(input2);
+	gmagn= 0;
+	gorient= 0;
+#pragma omp parallel for
+	for ( int n= 0; n < int(roioriginal.n); ++n )
+	{
+	  if ( roioriginal(n) )
+	  {
+	    float gx= fsx.apply(input2, n);
+	    float gy= fsy.apply(input2, n);
+	    gorient(n)= atan2(gy, gx);
+	    gmagn(n)= sqrt(gx*gx + gy*gy);
+	  }
+	}
 	
 	tprintf("extending image, iteration: ");
 	for ( int l= 0; l < input.columns/20; ++l )
@@ -1543,63 +1560,59 @@ namespace openip
 #pragma omp parallel for
 	for ( int i= 0; i < tis.rows; ++i )
 	{
-	  float gx, gy, ats, atc, sum, magn;
+	  float ats, atc, sum, magn;
 	double t;
 	int n;
-	int num;
 	Vector<float> orientations;
 	Vector<float> magnitudes;
+	Vector<float> magns;
+	Vector<float> orients;
+	Vector<float> ints;
             for ( int j= 0; j < tis.columns; ++j )
 	    {
 	      n= i*tis.columns + j;
 	      ats= 0;
 	      atc= 0;
 	      sum= 0;
-	      num= 0;
                 if ( (tis)(i,j) && !(tir)(i,j) && tir.isRealImagePixel(n) && Region2::isOuterContour4((tir), n) )
                 {
-		  Vector<float> magns;
-		  Vector<float> ints;
+		  magns.clear();
+		  orients.clear();
+		  ints.clear();
 		  
 		  for ( unsigned int k= 0; k < sed.size(); ++k )
 		  {
 		    if ( 0 <= int(n + sed(k)) && n + sed(k) < int(roioriginal.n) && (roioriginal)(n + sed(k)) )
 		    {
-		      gx= fsx.apply(input2, n + sed(k));
-		      gy= fsy.apply(input2, n + sed(k));
-		      t= atan2(gy, gx);
-		      magn= sqrt(gx*gx + gy*gy);
-		      magns.push_back(magn);
+		      magns.push_back(gmagn(n + sed(k)));
+		      orients.push_back(gorient(n + sed(k)));
 		      ints.push_back(input2(n + sed(k)));
 		    }
 		  }
 		  
-		  sort(magns.begin(), magns.end());
-		  float threshold= magns(magns.size()*0.8);
+		  if ( magns.size() == 0 )
+		    continue;
+		  
+		  // the 80th percentile of the magnitudes by selection, magns is kept in tap order for the second pass
+		  Vector<float> sorted(magns);
+		  std::nth_element(sorted.begin(), sorted.begin() + int(sorted.size()*0.8), sorted.end());
+		  float threshold= sorted(sorted.size()*0.8);
 		  
 		  orientations.clear();
 		  magnitudes.clear();
-		  for ( unsigned int k= 0; k < sed.size(); ++k )
+		  for ( unsigned int k= 0; k < magns.size(); ++k )
 		  {
-		    if ( 0 <= int(n + sed(k)) && n + sed(k) < int(roioriginal.n) && (roioriginal)(n + sed(k)) )
+		    magn= magns(k);
+		    
+		    if (  magn > threshold )
 		    {
-		      ++num;
-		      gx= fsx.apply(input2, n + sed(k));
-		      gy= fsy.apply(input2, n + sed(k));
-		      t= atan2(gy, gx);
+		      t= orients(k);
+		      orientations.push_back(t);
+		      magnitudes.push_back(magn);
 		      
-		      magn= sqrt(gx*gx + gy*gy);
-		      
-		      
-		      if (  magn > threshold )
-		      {
-			orientations.push_back(t);
-			magnitudes.push_back(magn);
-			
-			ats+= sin(t)*magn;
-			atc+= cos(t)*magn;
-			sum+= magn;
-		      }
+		      ats+= sin(t)*magn;
+		      atc+= cos(t)*magn;
+		      sum+= magn;
 		    }
 		  }
 		  if ( (ats == 0 && atc == 0) )
@@ -1607,13 +1620,11 @@ namespace openip
 		    continue;
 		  }
 		  
-		  ats/= sum;
-		  atc/= sum;
-		  
-		  t= atan2(atc, ats);
-		  
 		  t= meanOrientation(orientations, magnitudes);
 		  
+		  float intMean= ints.getMean();
+		  float intDev= ints.getStandardDeviation();
+		  
 		  t += M_PI/2;
 		  float dist= (l+1);
 		  float di= floor((dist)*sin(t)+0.5);
@@ -1621,7 +1632,7 @@ namespace openip
 		  
 		  if ( (tir)(i + di, j + dj) )
 		  {
-		    if ( output(i,j) < ints.getMean() - 1.5*ints.getStandardDeviation() || output(i,j) > ints.getMean() + 1.5*ints.getStandardDeviation() )
+		    if ( output(i,j) < intMean - 1.5*intDev || output(i,j) > intMean + 1.5*intDev )
 		    {
 		      output(i,j)= output(i + di, j + dj);
 		      {
@@ -1632,7 +1643,7 @@ namespace openip
 		  }
 		  else if ( (tir)(i - di, j - dj) )
 		  {
-		    if ( output(i,j) < ints.getMean() - 1.5*ints.getStandardDeviation() || output(i,j) > ints.getMean() + 1.5*ints.getStandardDeviation() )
+		    if ( output(i,j) < intMean - 1.5*intDev || output(i,j) > intMean + 1.5*intDev )
 		    {
 		      output(i,j)= (output)(i - di, j - dj);
 		      
@@ -1645,7 +1656,7 @@ namespace openip
 		  else
 		  {
 		    roi2(i,j)= 255;
-		    output(i,j)= ints.getMean();
+		    output(i,j)= intMean;
 		  }
                 }
 	    }
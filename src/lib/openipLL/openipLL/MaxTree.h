@@ -0,0 +1,222 @@
+/**
+ * @file MaxTree.h
+ * @author Gyorgy Kovacs <gyuriofkovacs@gmail.com>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * http://www.gnu.org/copyleft/gpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * The MaxTree represents the connected components of all the upper level sets
+ * of an image of small non-negative integer levels. The tree is built by the
+ * union-find algorithm of Berger et al.: the pixels are processed in
+ * decreasing order of levels and every node is represented by its canonical
+ * pixel. The components of the level set {level >= k} are the subtrees of
+ * the canonical pixels with level at least k whose parent has level less than k.
+ */
+
+#ifndef _MAX_TREE_H_
+#define _MAX_TREE_H_
+
+#include <openipDS/Image.h>
+#include <openipDS/Vector.h>
+
+namespace openip
+{
+    /**
+     * MaxTree of an integer valued image, pixels of level 0 do not belong to the tree
+     */
+    class MaxTree
+    {
+    public:
+        /**
+         * builds the tree
+         * @param levels levels of the pixels, pixels of level 0 are not part of the tree
+         * @param numberOfLevels levels are in [0, numberOfLevels)
+         * @param neighborhood 1 for 4-connectivity, 2 for 8-connectivity
+         */
+        template<typename T>
+        void build(Image<T>& levels, int numberOfLevels, int neighborhood= 2);
+
+        /**
+         * tests if the pixel is the canonical pixel of a node
+         * @param p pixel in row-continuous representation
+         * @return 1 if p is canonical, 0 otherwise
+         */
+        int isCanonical(int p);
+
+        /**
+         * sums up the pixel attributes in the subtrees, after the call attr(p) is the sum
+         * of the attributes in the node of the canonical pixel p and in its descendants
+         * @param attr attributes of the pixels, one element per pixel
+         */
+        template<typename A>
+        void accumulate(Vector<A>& attr);
+
+        /**
+         * collects the pixels of the subtree of a node
+         * @param p canonical pixel of the node
+         * @param pixels output parameter, the pixels of the component
+         */
+        void getPixels(int p, Vector<int>& pixels);
+
+        /** parent pixels, -1 for the pixels of level 0, roots are their own parents */
+        Vector<int> parent;
+        /** levels of the pixels */
+        Vector<int> level;
+        /** pixels of positive level in the order of processing, decreasing levels */
+        Vector<int> order;
+
+    protected:
+        /**
+         * finds the root of a pixel in the union-find structure with path compression
+         * @param p pixel
+         * @return the root
+         */
+        int findRoot(int p);
+
+        /** union-find structure used during the construction */
+        Vector<int> zpar;
+        /** children of the pixels in compressed sparse row form, built on demand */
+        Vector<int> childBegin, children;
+    };
+
+    inline int MaxTree::isCanonical(int p)
+    {
+        return parent(p) >= 0 && ( parent(p) == p || level(parent(p)) != level(p) );
+    }
+
+    inline int MaxTree::findRoot(int p)
+    {
+        int r= p;
+        while ( zpar(r) != r )
+            r= zpar(r);
+        while ( zpar(p) != r )
+        {
+            int next= zpar(p);
+            zpar(p)= r;
+            p= next;
+        }
+        return r;
+    }
+
+    template<typename T>
+    void MaxTree::build(Image<T>& levels, int numberOfLevels, int neighborhood)
+    {
+        int n= levels.n;
+        parent.resize(n);
+        level.resize(n);
+        zpar.resize(n);
+        childBegin.clear();
+        children.clear();
+
+        Vector<int> counts(numberOfLevels + 1, 0);
+        for ( int p= 0; p < n; ++p )
+        {
+            level(p)= levels(p);
+            parent(p)= -1;
+            zpar(p)= -1;
+            ++counts(level(p));
+        }
+
+        // counting sort by decreasing levels
+        Vector<int> starts(numberOfLevels + 1, 0);
+        for ( int l= numberOfLevels - 1; l > 0; --l )
+            starts(l - 1)= starts(l) + counts(l);
+        order.resize(starts(0));
+        for ( int p= 0; p < n; ++p )
+            if ( level(p) > 0 )
+                order(starts(level(p))++)= p;
+
+        int columns= levels.columns;
+        int drs[8]= {0, 0, -1, 1, -1, -1, 1, 1};
+        int dcs[8]= {-1, 1, 0, 0, -1, 1, -1, 1};
+        int nn= neighborhood == 1 ? 4 : 8;
+
+        for ( unsigned int k= 0; k < order.size(); ++k )
+        {
+            int p= order(k);
+            parent(p)= p;
+            zpar(p)= p;
+            int r= p / columns;
+            int c= p % columns;
+
+            for ( int d= 0; d < nn; ++d )
+            {
+                int rr= r + drs[d];
+                int cc= c + dcs[d];
+                if ( rr < 0 || rr >= levels.rows || cc < 0 || cc >= columns )
+                    continue;
+                int q= rr*columns + cc;
+                if ( zpar(q) < 0 )
+                    continue;
+                int root= findRoot(q);
+                if ( root != p )
+                {
+                    parent(root)= p;
+                    zpar(root)= p;
+                }
+            }
+        }
+
+        // canonization: the parents of the pixels point to the canonical pixels
+        for ( int k= int(order.size()) - 1; k >= 0; --k )
+        {
+            int p= order(k);
+            int q= parent(p);
+            if ( level(parent(q)) == level(q) )
+                parent(p)= parent(q);
+        }
+    }
+
+    template<typename A>
+    void MaxTree::accumulate(Vector<A>& attr)
+    {
+        for ( unsigned int k= 0; k < order.size(); ++k )
+        {
+            int p= order(k);
+            if ( parent(p) != p )
+                attr(parent(p))+= attr(p);
+        }
+    }
+
+    inline void MaxTree::getPixels(int p, Vector<int>& pixels)
+    {
+        #pragma omp critical (maxTreeChildren)
+        {
+            if ( childBegin.size() == 0 )
+            {
+                childBegin.resize(parent.size() + 1, 0);
+                for ( unsigned int k= 0; k < order.size(); ++k )
+                    if ( parent(order(k)) != order(k) )
+                        ++childBegin(parent(order(k)) + 1);
+                for ( unsigned int q= 0; q < parent.size(); ++q )
+                    childBegin(q + 1)+= childBegin(q);
+                children.resize(childBegin(parent.size()));
+                Vector<int> fill(childBegin);
+                for ( unsigned int k= 0; k < order.size(); ++k )
+                    if ( parent(order(k)) != order(k) )
+                        children(fill(parent(order(k)))++)= order(k);
+            }
+        }
+
+        pixels.clear();
+        pixels.push_back(p);
+        for ( unsigned int k= 0; k < pixels.size(); ++k )
+            for ( int c= childBegin(pixels(k)); c < childBegin(pixels(k) + 1); ++c )
+                pixels.push_back(children(c));
+    }
+}
+
+#endif
@@ -31,6 +31,16 @@ public:
 
     virtual void doRG(Image<INPUT>& input, Image<unsigned char>& output, Image<unsigned char>& seed, Image<unsigned char>* roi= NULL);
 
+    /**
+     * region growing for REGION_GROWING_HARD_THRESHOLD, the growth is hysteresis thresholding with a
+     * fill-in rule, evaluated by waves of frontier pixels like doRG without copying the input
+     * @param input input image
+     * @param output output image
+     * @param seed seed image
+     * @param roi the growth is continued from the foreground (non-zero) pixels of the roi
+     */
+    void doHardThresholdRG(Image<INPUT>& input, Image<unsigned char>& output, Image<unsigned char>& seed, Image<unsigned char>* roi= NULL);
+
     int growingMode;
 
     Image<float> mode;
@@ -65,9 +75,102 @@ void NeighborhoodRegionGrowing<INPUT>::init()
 
 }
 
+template<typename INPUT>
+void NeighborhoodRegionGrowing<INPUT>::doHardThresholdRG(Image<INPUT> &input, Image<unsigned char> &output, Image<unsigned char> &seed, Image<unsigned char> *roi)
+{
+    output= seed;
+
+    Vector<int> seeds;
+    for ( unsigned int i= 0; i < seed.n; ++i )
+        if ( seed(i) )
+            seeds.push_back(i);
+
+    int total= seeds.size();
+    if ( total > input.size()*0.2 )
+    {
+      output= 255;
+      return;
+    }
+
+    int n= output.n;
+    int c= seed.columns;
+    int offsets[8]= {-c-1, -c, -c+1, -1, 1, c-1, c, c+1};
+
+    // bit-packed flags of the pixels accepted and rejected in the current wave
+    Vector<unsigned int> accepted((n + 31)/32, 0), rejected((n + 31)/32, 0);
+    Vector<int> final, rejectedList;
+
+    while ( 1 )
+    {
+        final.clear();
+        rejectedList.clear();
+
+        for ( unsigned int i= 0; i < seeds.size(); ++i )
+        {
+            int s= seeds(i);
+            if ( !output(s) || (roi && !(*roi)(s)) )
+                continue;
+
+            for ( int j= 0; j < 8; ++j )
+            {
+                int actual= s + offsets[j];
+                if ( actual < 0 || actual >= n || output(actual) )
+                    continue;
+                if ( (accepted(actual >> 5) | rejected(actual >> 5)) & (1u << (actual & 31)) )
+                    continue;
+
+                // the fill-in rule counts the foreground pixels of the 3x3 neighborhood at the start of the wave
+                int accept= float(input(actual)) > threshold;
+                if ( !accept )
+                {
+                    int sum= 0;
+                    for ( int k= 0; k < 8; ++k )
+                        if ( actual + offsets[k] >= 0 && actual + offsets[k] < n && output(actual + offsets[k]) )
+                            ++sum;
+                    accept= sum >= 6;
+                }
+
+                if ( accept )
+                {
+                    accepted(actual >> 5)|= 1u << (actual & 31);
+                    final.push_back(actual);
+                }
+                else
+                {
+                    rejected(actual >> 5)|= 1u << (actual & 31);
+                    rejectedList.push_back(actual);
+                }
+            }
+        }
+
+        total+= final.size();
+
+        if ( total > input.size()*0.2 )
+        {
+          output= 255;
+          return;
+        }
+
+        if ( final.size() == 0 )
+            break;
+
+        for ( unsigned int j= 0; j < final.size(); ++j )
+            output(final(j))= 255;
+        for ( unsigned int j= 0; j < rejectedList.size(); ++j )
+            rejected(rejectedList(j) >> 5)&= ~(1u << (rejectedList(j) & 31));
+        seeds= final;
+    }
+}
+
 template<typename INPUT>
 void NeighborhoodRegionGrowing<INPUT>::doRG(Image<INPUT> &input, Image<unsigned char> &output, Image<unsigned char> &seed, Image<unsigned char> *roi)
 {
+    if ( growingMode == REGION_GROWING_HARD_THRESHOLD )
+    {
+        doHardThresholdRG(input, output, seed, roi);
+        return;
+    }
+
     Image<float> mode;
     mode.resizeImage(input);
     mode= input;
@@ -8,62 +8,67 @@ namespace openip
 {
   float circularity(Region2& region, Image<unsigned char>& input)
   {
-    float area= region.size();
+    return circularity(region.size() ? &(region(0)) : NULL, region.size(), input);
+  }
+  
+  float circularity(const int* region, int size, Image<unsigned char>& input)
+  {
+    float area= size;
     float perimeter= 0;
 
-    for ( unsigned int i= 0; i < region.size(); ++i )
+    for ( int i= 0; i < size; ++i )
     {
-      if ( region(i) - input.columns - 1 >= 0 && region(i) + input.columns + 1 < int(input.n) )
+      if ( region[i] - input.columns - 1 >= 0 && region[i] + input.columns + 1 < int(input.n) )
       {
-	if ( !input(region(i) + 1) )
-	  input(region(i)+1)= 128;
-	if ( !input(region(i) - 1) )
-	  input(region(i)-1)= 128;
-	if ( !input(region(i) + input.columns) )
-	  input(region(i)+input.columns)= 128;
-	if ( !input(region(i) - input.columns) )
-	  input(region(i)-input.columns)= 128;
-	/*if ( !input(region(i) + 1 + input.columns) )
+	if ( !input(region[i] + 1) )
+	  input(region[i]+1)= 128;
+	if ( !input(region[i] - 1) )
+	  input(region[i]-1)= 128;
+	if ( !input(region[i] + input.columns) )
+	  input(region[i]+input.columns)= 128;
+	if ( !input(region[i] - input.columns) )
+	  input(region[i]-input.columns)= 128;
+	/*if ( !input(region[i] + 1 + input.columns) )
 	  p++;
-	if ( !input(region(i) + 1 - input.columns) )
+	if ( !input(region[i] + 1 - input.columns) )
 	  p++;
-	if ( !input(region(i) - 1 + input.columns) )
+	if ( !input(region[i] - 1 + input.columns) )
 	  p++;
-	if ( !input(region(i) - 1 - input.columns) )
+	if ( !input(region[i] - 1 - input.columns) )
 	  p++;*/
       }
     }
-    for ( unsigned int i= 0; i < region.size(); ++i )
+    for ( int i= 0; i < size; ++i )
     {
-      if ( region(i) - input.columns - 1 >= 0 && region(i) + input.columns + 1 < int(input.n) )
+      if ( region[i] - input.columns - 1 >= 0 && region[i] + input.columns + 1 < int(input.n) )
       {
-	if ( input(region(i) + 1) == 128 )
+	if ( input(region[i] + 1) == 128 )
 	{
-	  input(region(i)+1)= 0;
+	  input(region[i]+1)= 0;
 	  perimeter+= 1.0;
 	}
-	if ( input(region(i) - 1) == 128 )
+	if ( input(region[i] - 1) == 128 )
 	{
-	  input(region(i)-1)= 0;
+	  input(region[i]-1)= 0;
 	  perimeter+= 1.0;
 	}
-	if ( input(region(i) + input.columns) == 128 )
+	if ( input(region[i] + input.columns) == 128 )
 	{
-	  input(region(i)+input.columns)= 0;
+	  input(region[i]+input.columns)= 0;
 	  perimeter+= 1.0;
 	}
-	if ( input(region(i) - input.columns) == 128 )
+	if ( input(region[i] - input.columns) == 128 )
 	{
-	  input(region(i)-input.columns)= 0;
+	  input(region[i]-input.columns)= 0;
 	  perimeter+= 1.0;
 	}
-	/*if ( !input(region(i) + 1 + input.columns) )
+	/*if ( !input(region[i] + 1 + input.columns) )
 	  p++;
-	if ( !input(region(i) + 1 - input.columns) )
+	if ( !input(region[i] + 1 - input.columns) )
 	  p++;
-	if ( !input(region(i) - 1 + input.columns) )
+	if ( !input(region[i] - 1 + input.columns) )
 	  p++;
-	if ( !input(region(i) - 1 - input.columns) )
+	if ( !input(region[i] - 1 - input.columns) )
 	  p++;*/
       }
     }
@@ -17,6 +17,8 @@ namespace openip
   
   float circularity(Region2& region, Image<unsigned char>& input);
   
+  float circularity(const int* region, int size, Image<unsigned char>& input);
+  
   Image<unsigned char> getImageOfRegion(Region2& region);
   
   int isConnective(Region2& region);
@@ -224,6 +224,8 @@ namespace openip
                     result= new MorphologicalContrastEnhancement<INPUT, OUTPUT>(parameters[0]);
                 if ( name.compare("ContrastLimitedAdaptiveHistogramEqualization") == 0 )
                     result= new ContrastLimitedAdaptiveHistogramEqualization<INPUT, OUTPUT>(parameters[0], parameters[1]);
+                if ( name.compare("TiledContrastLimitedAdaptiveHistogramEqualization") == 0 )
+                    result= new TiledContrastLimitedAdaptiveHistogramEqualization<INPUT, OUTPUT>(parameters[0], parameters[1]);
                 if ( name.compare("EstimationOfBackgroundLuminosityAndContrastVariability") == 0 )
                     result= new EstimationOfBackgroundLuminosityAndContrastVariability<INPUT, OUTPUT>(parameters[0]);
                 if ( name.compare("DivisionByAnOverSmoothed") == 0 )
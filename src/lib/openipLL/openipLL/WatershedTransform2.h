@@ -134,11 +134,11 @@ namespace openip
         ComponentLabeling cl;
         cl.apply(tmp2, tmp);
 
-        PriorityQueue<int, int> pq;
+        BucketPriorityQueue<int, int> pq;
         for ( unsigned int i= tmp.columns + 1; i < tmp.n - tmp.columns - 1; ++i )
         {
             if ( tmp(i) == 0 )
-                for ( sdit= sd.begin(); it != sd.end(); ++it )
+                for ( sdit= sd.begin(); sdit != sd.end(); ++sdit )
                 {
                     if ( (i + *sdit) > (input.columns + 1) && (i + *sdit) < (input.n - input.columns - 1) && tmp(i + *sdit) > 0 )
                     {
@@ -353,7 +353,7 @@ namespace openip
 
         //writeImage("minimas3.png", tmp);
         //writeImage("minimas2.png", tmp2);
-        PriorityQueue<int, int> pq;
+        BucketPriorityQueue<int, int> pq;
         for ( unsigned int i= 0; i < tmp.n; ++i )
         {
             if ( tmp(i) > 0 )
@@ -0,0 +1,364 @@
+/**
+ * @file histogramEqualization.h
+ * @author Gyorgy Kovacs <gyuriofkovacs@gmail.com>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * http://www.gnu.org/copyleft/gpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * Histogram engines of the local histogram equalizations of 8 bit level images.
+ * The sliding window histograms are maintained in constant time per pixel, like
+ * in the median filter of S. Perreault and P. Hebert (Median Filtering in Constant
+ * Time, IEEE TIP 2007, see ctmf.cc): the histograms of the columns of the window are
+ * kept and updated by one pixel leaving and one pixel entering, the histogram of
+ * the window is updated by one column histogram leaving and one entering. The
+ * contrast limited equalization is the classic tile based method of K. Zuiderveld
+ * (Contrast Limited Adaptive Histogram Equalization, Graphics Gems IV, 1994): the
+ * clipped and equalized mappings of the tiles are interpolated bilinearly. The
+ * engines process strips of rows in parallel.
+ */
+
+#ifndef _HISTOGRAM_EQUALIZATION_H_
+#define _HISTOGRAM_EQUALIZATION_H_
+
+#include <limits.h>
+#include <math.h>
+#include <omp.h>
+
+#include <openipDS/Image.h>
+#include <openipDS/Vector.h>
+
+namespace openip
+{
+    /**
+     * number of strips of rows for parallel processing: 1 for one thread, otherwise
+     * a few strips per thread, at most one strip per row
+     * @param rows number of rows
+     * @return number of strips
+     */
+    inline int histogramEqualizationStrips(int rows)
+    {
+        int strips= omp_get_max_threads();
+        if ( strips > 1 )
+            strips*= 4;
+        return strips < rows ? (strips > 0 ? strips : 1) : (rows > 0 ? rows : 1);
+    }
+
+    /**
+     * converts an image to 8 bit levels without changing the values
+     * @param input input image
+     * @param levels output levels
+     * @return 1 if all the values of the input are integers in [0, 255], 0 otherwise, then levels is not usable
+     */
+    template<typename INPUT>
+    int integerLevels(Image<INPUT>& input, Image<unsigned char>& levels)
+    {
+        levels.resizeImage(input);
+
+        int exact= 1;
+        for ( unsigned int i= 0; i < input.n; ++i )
+        {
+            double v= input(i);
+            if ( v < 0 || v > 255 || v != floor(v) )
+            {
+                exact= 0;
+                break;
+            }
+            levels(i)= (unsigned char)(input(i));
+        }
+
+        return exact;
+    }
+
+    /**
+     * quantizes an image to 256 levels between the minimum and maximum of the
+     * image, like the bins of a Histogram of 256 bins
+     * @param input input image
+     * @param levels output levels
+     * @param support the minimum and maximum are computed in the foreground (non 0) region, NULL if not used
+     */
+    template<typename INPUT>
+    void quantizedLevels(Image<INPUT>& input, Image<unsigned char>& levels, Image<unsigned char>* support= NULL)
+    {
+        levels.resizeImage(input);
+
+        INPUT min, max;
+        input.getMinMax(min, max, support);
+        double scale= max > min ? 255.0/(double(max) - double(min)) : 0;
+
+        #pragma omp parallel for
+        for ( int i= 0; i < (int)(input.n); ++i )
+        {
+            double l= (double(input(i)) - double(min))*scale;
+            levels(i)= l < 0 ? 0 : (l > 255 ? 255 : (unsigned char)(l));
+        }
+    }
+
+    /**
+     * counts the pixels darker than the center in the square windows of the positions
+     * first, ..., last - 1; the windows are square in the row-continuous representation,
+     * like the StructuringElementSquare objects, thus the windows of the pixels close to the
+     * left and right edges continue in the neighboring rows
+     * @param levels 8 bit levels
+     * @param support only the pixels of the foreground (non 0) are counted, NULL if not used
+     * @param mask the counts are computed in the foreground (non 0) positions, 0 is written elsewhere, NULL if not used
+     * @param columns number of columns
+     * @param radius radius of the window, 2*radius + 1 must not exceed columns
+     * @param first first position, the whole window must be inside the image
+     * @param last position after the last position, the whole window of last - 1 must be inside the image
+     * @param counts output counts
+     */
+    inline void slidingDarkerCounts(const unsigned char* levels, const unsigned char* support, const unsigned char* mask, int columns, int radius, int first, int last, float* counts)
+    {
+        if ( first >= last )
+            return;
+
+        // ring of the column histograms, the column of position j is stored in the slot j % columns,
+        // a column is the set of positions j + k*columns, k= -radius, ..., radius
+        Vector<unsigned short> fine(columns*256, 0);
+        Vector<unsigned short> coarse(columns*16, 0);
+        Vector<int> tag(columns, INT_MIN);
+        int window[256];
+        int windowCoarse[16];
+        int top= radius*columns;
+
+        for ( int k= 0; k < 256; ++k )
+            window[k]= 0;
+        for ( int k= 0; k < 16; ++k )
+            windowCoarse[k]= 0;
+
+        for ( int j= first - radius; j <= last - 1 + radius; ++j )
+        {
+            int slot= j % columns;
+            unsigned short* f= &(fine(slot*256));
+            unsigned short* c= &(coarse(slot*16));
+
+            // updating the column histogram of position j from that of j - columns,
+            // or computing it from scratch
+            if ( tag(slot) == j - columns )
+            {
+                int p= j - columns - top;
+                if ( !support || support[p] )
+                {
+                    --f[levels[p]];
+                    --c[levels[p] >> 4];
+                }
+                p= j + top;
+                if ( !support || support[p] )
+                {
+                    ++f[levels[p]];
+                    ++c[levels[p] >> 4];
+                }
+            }
+            else
+            {
+                for ( int k= 0; k < 256; ++k )
+                    f[k]= 0;
+                for ( int k= 0; k < 16; ++k )
+                    c[k]= 0;
+                for ( int p= j - top; p <= j + top; p+= columns )
+                    if ( !support || support[p] )
+                    {
+                        ++f[levels[p]];
+                        ++c[levels[p] >> 4];
+                    }
+            }
+            tag(slot)= j;
+
+            // the column histogram of position j enters the window
+            for ( int k= 0; k < 256; ++k )
+                window[k]+= f[k];
+            for ( int k= 0; k < 16; ++k )
+                windowCoarse[k]+= c[k];
+
+            int i= j - radius;
+            if ( i < first )
+                continue;
+
+            if ( !mask || mask[i] )
+            {
+                int l= levels[i];
+                int count= 0;
+                for ( int k= 0; k < (l >> 4); ++k )
+                    count+= windowCoarse[k];
+                for ( int k= l & ~15; k < l; ++k )
+                    count+= window[k];
+                counts[i]= count;
+            }
+            else
+                counts[i]= 0;
+
+            // the column histogram of position i - radius leaves the window
+            slot= (i - radius) % columns;
+            f= &(fine(slot*256));
+            c= &(coarse(slot*16));
+            for ( int k= 0; k < 256; ++k )
+                window[k]-= f[k];
+            for ( int k= 0; k < 16; ++k )
+                windowCoarse[k]-= c[k];
+        }
+    }
+
+    /**
+     * counts the pixels darker than the center in the (2*radius + 1)x(2*radius + 1) windows
+     * of the pixels whose windows are inside the image (in the row-continuous representation),
+     * in parallel strips of rows
+     * @param levels 8 bit levels
+     * @param counts output counts, the pixels whose windows are not inside the image are not changed
+     * @param radius radius of the window, 2*radius + 1 must not exceed the number of columns
+     * @param mask the counts are computed in the foreground (non 0) positions, 0 is written elsewhere, NULL if not used
+     * @param support only the pixels of the foreground (non 0) are counted, NULL if not used
+     */
+    inline void slidingDarkerCounts(Image<unsigned char>& levels, Image<float>& counts, int radius, Image<unsigned char>* mask= NULL, Image<unsigned char>* support= NULL)
+    {
+        int columns= levels.columns;
+        int begin= radius*columns + radius;
+        int end= levels.n - radius*columns - radius;
+        if ( end <= begin )
+            return;
+
+        int firstRow= begin/columns;
+        int rows= (end - 1)/columns - firstRow + 1;
+        int strips= histogramEqualizationStrips(rows);
+
+        #pragma omp parallel for
+        for ( int s= 0; s < strips; ++s )
+        {
+            int first= (firstRow + (long)rows*s/strips)*columns;
+            int last= (firstRow + (long)rows*(s + 1)/strips)*columns;
+            if ( first < begin )
+                first= begin;
+            if ( last > end || s == strips - 1 )
+                last= end;
+            slidingDarkerCounts(&(levels(0)), support ? &((*support)(0)) : (unsigned char*)NULL, mask ? &((*mask)(0)) : (unsigned char*)NULL,
+                                columns, radius, first, last, &(counts(0)));
+        }
+    }
+
+    /**
+     * contrast limited adaptive histogram equalization by tiles: the histograms of the tiles are
+     * clipped at the clip limit, the clipped mass is redistributed uniformly, the mapping
+     * of a tile is the cumulative histogram, the mappings of the four tiles closest to a pixel are
+     * interpolated bilinearly
+     * @param levels 8 bit levels
+     * @param output output image, the values are in [0, 1]
+     * @param tile size of the square tiles
+     * @param cliplimit the maximum count of a level as a multiple of the mean count n/256 of the levels of
+     * a tile with n pixels (the convention of Zuiderveld), values below 1 are treated as 1 (no enhancement)
+     * @param mask the output is computed in the foreground (non 0) positions, other pixels are not changed, NULL if not used
+     * @param support only the pixels of the foreground (non 0) are taken into the histograms, NULL if not used
+     */
+    template<typename OUTPUT>
+    void contrastLimitedEqualization(Image<unsigned char>& levels, Image<OUTPUT>& output, int tile, float cliplimit, Image<unsigned char>* mask= NULL, Image<unsigned char>* support= NULL)
+    {
+        int rows= levels.rows;
+        int columns= levels.columns;
+        if ( tile < 1 )
+            tile= 1;
+        int tileRows= (rows + tile - 1)/tile;
+        int tileColumns= (columns + tile - 1)/tile;
+
+        // mappings of the tiles, computed in parallel strips of tile rows
+        Vector<float> mappings(tileRows*tileColumns*256);
+
+        #pragma omp parallel for schedule(dynamic)
+        for ( int tr= 0; tr < tileRows; ++tr )
+        {
+            int h[256];
+            for ( int tc= 0; tc < tileColumns; ++tc )
+            {
+                for ( int k= 0; k < 256; ++k )
+                    h[k]= 0;
+
+                int n= 0;
+                for ( int r= tr*tile; r < (tr + 1)*tile && r < rows; ++r )
+                    for ( int c= tc*tile; c < (tc + 1)*tile && c < columns; ++c )
+                        if ( !support || (*support)(r, c) )
+                        {
+                            ++h[levels(r, c)];
+                            ++n;
+                        }
+
+                float* m= &(mappings((tr*tileColumns + tc)*256));
+                if ( n == 0 )
+                {
+                    for ( int k= 0; k < 256; ++k )
+                        m[k]= (k + 1)/256.0f;
+                    continue;
+                }
+
+                float limit= (cliplimit > 1 ? cliplimit : 1)/256.0f;
+                float excess= 0;
+                for ( int k= 0; k < 256; ++k )
+                {
+                    m[k]= h[k]/float(n);
+                    if ( m[k] > limit )
+                    {
+                        excess+= m[k] - limit;
+                        m[k]= limit;
+                    }
+                }
+                excess/= 256;
+                float sum= 0;
+                for ( int k= 0; k < 256; ++k )
+                {
+                    sum+= m[k] + excess;
+                    m[k]= sum;
+                }
+            }
+        }
+
+        // bilinear interpolation of the mappings of the closest tile centers
+        #pragma omp parallel for
+        for ( int r= 0; r < rows; ++r )
+        {
+            float y= (r + 0.5f)/tile - 0.5f;
+            int t0= (int)floor(y);
+            float wy= y - t0;
+            if ( t0 < 0 )
+            {
+                t0= 0;
+                wy= 0;
+            }
+            int t1= t0 + 1 < tileRows ? t0 + 1 : t0;
+
+            for ( int c= 0; c < columns; ++c )
+            {
+                if ( mask && !(*mask)(r, c) )
+                    continue;
+
+                float x= (c + 0.5f)/tile - 0.5f;
+                int s0= (int)floor(x);
+                float wx= x - s0;
+                if ( s0 < 0 )
+                {
+                    s0= 0;
+                    wx= 0;
+                }
+                int s1= s0 + 1 < tileColumns ? s0 + 1 : s0;
+
+                int l= levels(r, c);
+                float a= mappings((t0*tileColumns + s0)*256 + l);
+                float b= mappings((t0*tileColumns + s1)*256 + l);
+                float d= mappings((t1*tileColumns + s0)*256 + l);
+                float e= mappings((t1*tileColumns + s1)*256 + l);
+
+                output(r, c)= (1 - wy)*((1 - wx)*a + wx*b) + wy*((1 - wx)*d + wx*e);
+            }
+        }
+    }
+}
+
+#endif
@@ -32,6 +32,7 @@
 #include <openipLL/imageCorrection.h>
 #include <openipLL/imageIO.h>
 #include <openipLL/ctmf.h>
+#include <openipLL/histogramEqualization.h>
 #include <openipLL/morphology.h>
 
 #include <openipSC/RealFunction.h>
@@ -985,6 +986,58 @@ namespace openip
         float cliplimit;
     };
 
+    /**
+     * contrast limited adaptive histogram equalization of Zuiderveld by tiles of size w: the input is
+     * quantized to 256 levels, the equalized mappings of the tiles are interpolated bilinearly, the
+     * output is in [0, 1]
+     * @see K. Zuiderveld: Contrast Limited Adaptive Histogram Equalization, Graphics Gems IV, 1994
+     */
+    template<typename INPUT, typename OUTPUT>
+    class TiledContrastLimitedAdaptiveHistogramEqualization: public Transform2<INPUT, OUTPUT>
+    {
+    public:
+        using Transform2<INPUT, OUTPUT>::apply;
+        using Transform2<INPUT, OUTPUT>::descriptor;
+
+        /**
+         * constructor
+         * @param w_ size of the tiles
+         * @param c_ clip limit, the maximum count of a level as a multiple of the mean count of the levels in a tile
+         */
+        TiledContrastLimitedAdaptiveHistogramEqualization(int w_= 64, float c_= 3.0);
+
+        /**
+         * copy constructor
+         * @param b instance to copy
+         */
+        TiledContrastLimitedAdaptiveHistogramEqualization(const TiledContrastLimitedAdaptiveHistogramEqualization& b);
+
+        /**
+         * destructor
+         */
+        ~TiledContrastLimitedAdaptiveHistogramEqualization();
+
+        /**
+         * returns the proposed image border
+         * @return the proposed image border object
+         */
+        virtual Border2 getProposedBorder();
+
+        /**
+         * apply function
+         * @param input input image
+         * @param output output image
+         * @param roi the operation is performed only in the foreground (non 0) positions
+         * @param support only the foreground (non 0) pixels are considered
+         */
+        virtual void apply(Image<INPUT>& input, Image<OUTPUT>& output, Image<unsigned char>* roi= NULL, Image<unsigned char>* support= NULL);
+
+        /** size of the tiles */
+        int w;
+        /** clip limit */
+        float cliplimit;
+    };
+
     /**
      * morphological contrast enhancement
      * @see Aliaa A. A. Youssif, Atef Z. Ghalwash, Amr S. Ghoneim: Comparative Study of Contrast Enhancement and Illumination Equalization Methods for Retinal Vasculature Segmentation
@@ -1055,6 +1108,88 @@ namespace openip
     float adaptiveLocalGammaCorrection(Image<INPUT>* input, Image<OUTPUT>* output, Image<unsigned char>* mask= NULL, int w= -1);
 
 
+    /* -----------============== running mean sweeps ==============------------ */
+
+    /**
+     * RunningMeanAssignment sets the output to the mean of the running structuring element,
+     * it is applied in the positions of the sweepStrips function
+     */
+    template<typename OUTPUT>
+    class RunningMeanAssignment
+    {
+    public:
+        /**
+         * constructor
+         * @param output_ output image
+         * @param mask_ the output is set in the foreground (non 0) region of the mask, everywhere if NULL
+         */
+        RunningMeanAssignment(Image<OUTPUT>& output_, Image<unsigned char>* mask_)
+        : output(output_), mask(mask_)
+        {
+        }
+
+        /**
+         * sets the output in position i
+         * @param i position in row-continuous representation
+         * @param r running structuring element in position i
+         */
+        template<typename RUNNING_ELEMENT>
+        void operator()(int i, RUNNING_ELEMENT& r)
+        {
+            if ( !mask || (*mask)(i) > 0 )
+                output(i)= r.mean;
+        }
+
+        /** output image */
+        Image<OUTPUT>& output;
+        /** mask image */
+        Image<unsigned char>* mask;
+    };
+
+    /**
+     * RunningMeanDifference sets the output to input + offset - mean of the running structuring element,
+     * it is applied in the positions of the sweepStrips function
+     */
+    template<typename INPUT, typename OUTPUT>
+    class RunningMeanDifference
+    {
+    public:
+        /**
+         * constructor
+         * @param input_ input image
+         * @param output_ output image
+         * @param offset_ offset added to the input
+         * @param mask_ the output is set in the foreground (non 0) region of the mask, everywhere if NULL
+         */
+        RunningMeanDifference(Image<INPUT>& input_, Image<OUTPUT>& output_, int offset_, Image<unsigned char>* mask_)
+        : input(input_), output(output_), offset(offset_), mask(mask_)
+        {
+        }
+
+        /**
+         * sets the output in position i
+         * @param i position in row-continuous representation
+         * @param r running structuring element in position i
+         */
+        template<typename RUNNING_ELEMENT>
+        void operator()(int i, RUNNING_ELEMENT& r)
+        {
+            if ( !mask || (*mask)(i) > 0 )
+                output(i)= input(i) + offset - r.mean;
+        }
+
+        /** input image */
+        Image<INPUT>& input;
+        /** output image */
+        Image<OUTPUT>& output;
+        /** offset added to the input */
+        int offset;
+        /** mask image */
+        Image<unsigned char>* mask;
+    };
+
+    /* -----------============== end of running mean sweeps ==============------------ */
+
     /* -----------============== background subtraction ==============------------ */
 
     template<typename INPUT, typename OUTPUT>
@@ -1104,52 +1239,14 @@ namespace openip
         f= 0;
         output= 0;
 
-        if ( support != NULL )
-        {
-            for ( int i= rse.begin; i < rse.end; ++i )
-            {
-                if ( (*support)(i) > 0 )
-                    (output)(i)= rse.mean;
-                if ( rse.position == rse.end - 1 )
-                    break;
-                rse.next();
-            }
+        RunningMeanAssignment<OUTPUT> mean(output, support);
+        sweepStrips(rse, mean);
 
-            RunningStructuringElementMean<OUTPUT> rse2((StructuringElementSquare(w2)));
-            rse2.init(&output, support);
+        RunningStructuringElementMean<OUTPUT> rse2((StructuringElementSquare(w2)));
+        rse2.init(&output, support);
 
-            for ( int i= rse2.begin; i < rse2.end; ++i )
-            {
-                if ( (*mask)(i) > 0 )
-                        (f)(i)= (input)(i) - rse2.mean;
-                else
-                    (f)(i)= 0;
-                if ( rse2.position == rse2.end - 1 )
-                    break;
-                rse2.next();
-            }
-        }
-        else
-        {
-            for ( int i= rse.begin; i < rse.end; ++i )
-            {
-                (output)(i)= rse.mean;
-                if ( rse.position == rse.end - 1 )
-                    break;
-                rse.next();
-            }
-
-            RunningStructuringElementMean<OUTPUT> rse2((StructuringElementSquare(w2)));
-            rse2.init(&output, support);
-
-            for ( int i= rse2.begin; i < rse2.end; ++i )
-            {
-                (f)(i)= (input)(i) - rse2.mean;
-                if ( rse2.position == rse2.end - 1 )
-                    break;
-                rse2.next();
-            }
-        }
+        RunningMeanDifference<INPUT, float> difference(input, f, 0, support != NULL ? mask : NULL);
+        sweepStrips(rse2, difference);
 
         output= f;
     }
@@ -1200,52 +1297,14 @@ namespace openip
         f= 0;
         output= 0;
 
-        if ( support != NULL )
-        {
-            for ( int i= rse.begin; i < rse.end; ++i )
-            {
-                if ( (*support)(i) > 0 )
-                    (output)(i)= rse.mean;
-                if ( rse.position == rse.end - 1 )
-                    break;
-                rse.next();
-            }
-
-            RunningStructuringElementMean<OUTPUT> rse2((StructuringElementSquare(w2)));
-            rse2.init(&output, support);
-
-            for ( int i= rse2.begin; i < rse2.end; ++i )
-            {
-                if ( (*mask)(i) > 0 )
-                        (f)(i)= rse2.mean;
-                else
-                    (f)(i)= 0;
-                if ( rse2.position == rse2.end - 1 )
-                    break;
-                rse2.next();
-            }
-        }
-        else
-        {
-            for ( int i= rse.begin; i < rse.end; ++i )
-            {
-                (output)(i)= rse.mean;
-                if ( rse.position == rse.end - 1 )
-                    break;
-                rse.next();
-            }
+        RunningMeanAssignment<OUTPUT> mean(output, support);
+        sweepStrips(rse, mean);
 
-            RunningStructuringElementMean<OUTPUT> rse2((StructuringElementSquare(w2)));
-            rse2.init(&output, support);
+        RunningStructuringElementMean<OUTPUT> rse2((StructuringElementSquare(w2)));
+        rse2.init(&output, support);
 
-            for ( int i= rse2.begin; i < rse2.end; ++i )
-            {
-                (f)(i)= rse2.mean;
-                if ( rse2.position == rse2.end - 1 )
-                    break;
-                rse2.next();
-            }
-        }
+        RunningMeanAssignment<float> mean2(f, support != NULL ? mask : NULL);
+        sweepStrips(rse2, mean2);
 
         output= f;
     }
@@ -1285,23 +1344,8 @@ namespace openip
         RunningStructuringElementMean<INPUT> rse((StructuringElementSquare(w1)));
         rse.init(&input, support);
 
-        if ( support )
-            for ( int i= rse.begin; i < rse.end; ++i )
-            {
-                if ( (*mask)(i) > 0 )
-                    (output)(i)= rse.mean;
-                if ( rse.position == rse.end - 1 )
-                    break;
-                rse.next();
-            }
-        else
-            for ( int i= rse.begin; i < rse.end; ++i )
-            {
-                (output)(i)= rse.mean;
-                if ( rse.position == rse.end - 1 )
-                    break;
-                rse.next();
-            }
+        RunningMeanAssignment<OUTPUT> mean(output, support != NULL ? mask : NULL);
+        sweepStrips(rse, mean);
     }
 
     template<typename INPUT, typename OUTPUT>
@@ -1344,23 +1388,8 @@ namespace openip
         RunningStructuringElementMean<INPUT> rse((StructuringElementSquare(w1)));
         rse.init(&input, support);
 
-        if ( support )
-            for ( int i= rse.begin; i < rse.end; ++i )
-            {
-                if ( (*support)(i) > 0 )
-                    (output)(i)= rse.mean;
-                if ( rse.position == rse.end - 1 )
-                    break;
-                rse.next();
-            }
-        else
-            for ( int i= rse.begin; i < rse.end; ++i )
-            {
-                (output)(i)= rse.mean;
-                if ( rse.position == rse.end - 1 )
-                    break;
-                rse.next();
-            }
+        RunningMeanAssignment<OUTPUT> mean(output, support);
+        sweepStrips(rse, mean);
 
         //output= 0;
 
@@ -1656,6 +1685,52 @@ namespace openip
 
     float sigm(float f, float mean, float var);
 
+    /**
+     * LocalContrastEnhancement maps the input by the sigmoid of the local mean and variance,
+     * it is applied in the positions of the sweepStrips function
+     */
+    template<typename INPUT, typename OUTPUT>
+    class LocalContrastEnhancement
+    {
+    public:
+        /**
+         * constructor
+         * @param input_ input image
+         * @param output_ output image
+         * @param min_ minimum of the input
+         * @param max_ maximum of the input
+         * @param mask_ the output is set in the foreground (non 0) region of the mask, everywhere if NULL
+         */
+        LocalContrastEnhancement(Image<INPUT>& input_, Image<OUTPUT>& output_, INPUT min_, INPUT max_, Image<unsigned char>* mask_)
+        : input(input_), output(output_), min(min_), max(max_), mask(mask_)
+        {
+        }
+
+        /**
+         * sets the output in position i
+         * @param i position in row-continuous representation
+         * @param r running structuring element in position i
+         */
+        template<typename RUNNING_ELEMENT>
+        void operator()(int i, RUNNING_ELEMENT& r)
+        {
+            if ( !mask || (*mask)(i) > 0 )
+                if ( r.variance > 0 )
+                    output(i)= 255 * ((sigm(input(i), r.mean, r.variance) - sigm(min, r.mean, r.variance))/(sigm(max, r.mean, r.variance) - sigm(min, r.mean, r.variance)));
+        }
+
+        /** input image */
+        Image<INPUT>& input;
+        /** output image */
+        Image<OUTPUT>& output;
+        /** minimum of the input */
+        INPUT min;
+        /** maximum of the input */
+        INPUT max;
+        /** mask image */
+        Image<unsigned char>* mask;
+    };
+
     template<typename INPUT, typename OUTPUT>
     AdaptiveLocalContrastEnhancement<INPUT, OUTPUT>::AdaptiveLocalContrastEnhancement(int w_)
     : Transform2<INPUT, OUTPUT>(), w(w_)
@@ -1694,15 +1769,8 @@ namespace openip
 
         rse.init(&input);
 
-        for ( int i= rse.begin; i < rse.end; ++i )
-        {
-            if ( !mask || (*mask)(i) > 0 )
-                if ( rse.variance > 0 )
-                    (output)(rse.position)= 255 * ((sigm((input)(rse.position), rse.mean, rse.variance) - sigm(min, rse.mean, rse.variance))/(sigm(max, rse.mean, rse.variance) - sigm(min, rse.mean, rse.variance)));
-            if ( rse.position == rse.end - 1 )
-                break;
-            rse.next();
-        }
+        LocalContrastEnhancement<INPUT, OUTPUT> enhancement(input, output, min, max, mask);
+        sweepStrips(rse, enhancement);
     }
 
     /* -----------============== end of adaptive local contrast enhancement ==============------------ */
@@ -1743,6 +1811,30 @@ namespace openip
         StructuringElementSquare se(h);
         se.updateStride(input.columns);
 
+        // images of 8 bit levels are processed by the sliding histogram in constant time per pixel
+        Image<unsigned char> levels;
+        if ( 2*(h/2) + 1 <= (int)(input.columns) && integerLevels(input, levels) )
+        {
+            Image<float> counts;
+            counts.resizeImage(input);
+            slidingDarkerCounts(levels, counts, h/2, mask, support);
+
+            #pragma omp parallel for
+            for ( int i= -se.min; i < (int)(input.n) - se.max; ++i )
+            {
+                if ( !mask || (*mask)(i) > 0 )
+                {
+                    float ss= counts(i);
+                    ss/= h*h;
+
+                    (output)(i)= pow(ss, r);
+                }
+                else
+                    (output)(i)= 0;
+            }
+            return;
+        }
+
         #pragma omp parallel for
         for ( int i= -se.min; i < (int)(input.n) - se.max; ++i )
         {
@@ -1805,14 +1897,8 @@ namespace openip
 
         output= 0;
 
-        for ( int i= rse.begin; i < rse.end; ++i )
-        {
-            if ( !mask || (*mask)(i) > 0 )
-                (output)(i)= (input)(i) + m - rse.mean;
-            if ( rse.position == rse.end - 1 )
-                break;
-            rse.next();
-        }
+        RunningMeanDifference<INPUT, OUTPUT> difference(input, output, m, mask);
+        sweepStrips(rse, difference);
     }
 
     /* -----------============== end of desired average intensity ==============------------ */
@@ -2021,14 +2107,8 @@ namespace openip
         rse.init(&input, support);
         //ctmf(tmp1.data(), tmp2.data(), input.columns, input.rows, input.columns, input.columns, w, 1, 512);
         //mf.apply(input, output, mask);
-        for ( int i= rse.begin; i < rse.end; ++i )
-        {
-            if ( (*mask)(i) )
-                output(i)= rse.mean;
-            if ( rse.position == rse.end - 1 )
-                break;
-            rse.next();
-        }
+        RunningMeanAssignment<OUTPUT> mean(output, mask);
+        sweepStrips(rse, mean);
         //rse.apply(input, output, mask);
 
         /*for ( unsigned int i= 0; i < input.n; ++i )
@@ -2073,6 +2153,46 @@ namespace openip
 
     /* -----------============== estimation of background luminosity and contrast variability ==============------------ */
 
+    /**
+     * LuminosityAndContrastNormalization normalizes the input by the local mean and standard deviation,
+     * it is applied in the positions of the sweepStrips function
+     */
+    template<typename INPUT, typename OUTPUT>
+    class LuminosityAndContrastNormalization
+    {
+    public:
+        /**
+         * constructor
+         * @param input_ input image
+         * @param output_ output image
+         * @param mask_ the output is set in the foreground (non 0) region of the mask, everywhere if NULL
+         */
+        LuminosityAndContrastNormalization(Image<INPUT>& input_, Image<OUTPUT>& output_, Image<unsigned char>* mask_)
+        : input(input_), output(output_), mask(mask_)
+        {
+        }
+
+        /**
+         * sets the output in position i
+         * @param i position in row-continuous representation
+         * @param r running structuring element in position i
+         */
+        template<typename RUNNING_ELEMENT>
+        void operator()(int i, RUNNING_ELEMENT& r)
+        {
+            if ( !mask || (*mask)(i) > 0 )
+                if ( r.variance > FLT_EPSILON )
+                    output(i)= (input(i) - r.mean)/sqrt(r.variance);
+        }
+
+        /** input image */
+        Image<INPUT>& input;
+        /** output image */
+        Image<OUTPUT>& output;
+        /** mask image */
+        Image<unsigned char>* mask;
+    };
+
     template<typename INPUT, typename OUTPUT>
     EstimationOfBackgroundLuminosityAndContrastVariability<INPUT, OUTPUT>::EstimationOfBackgroundLuminosityAndContrastVariability( int w_)
     : Transform2<INPUT, OUTPUT>(), w(w_)
@@ -2115,18 +2235,8 @@ namespace openip
 
         rse.init(&input, support);
 
-        for ( unsigned int i= rse.begin; rse.position < rse.end; ++i )
-        {
-            if ( !mask || (*mask)(i) > 0 )
-            {
-                if ( rse.variance > FLT_EPSILON )
-                    (output)(i)= ((input)(i) - rse.mean)/sqrt(rse.variance);
-            }
-            
-            if ( rse.position == rse.end - 1 )
-                break;
-            rse.next();
-        }
+        LuminosityAndContrastNormalization<INPUT, OUTPUT> normalization(input, output, mask);
+        sweepStrips(rse, normalization);
     }
 
     /* -----------============== end of estimation of background luminosity and contrast variability ==============------------ */
@@ -2234,7 +2344,7 @@ namespace openip
                         h(j)+= a/h.size();
                     h.accumulate();
 
-                    output(i)= h(input(i));
+                    output(i)= h.get(input(i));
                     if ( rseh.position == rseh.end - 1 )
                         break;
                     rseh.next();
@@ -2282,7 +2392,7 @@ namespace openip
                         h(j)+= a/h.size();
                     h.accumulate();
 
-                    output(i)= h(input(i));
+                    output(i)= h.get(input(i));
                 }
                 if ( rseh.position == rseh.end - 1 )
                     break;
@@ -2299,6 +2409,43 @@ namespace openip
                     (output)(i)= (tmp2)(i);*/
     }
 
+    template<typename INPUT, typename OUTPUT>
+    TiledContrastLimitedAdaptiveHistogramEqualization<INPUT, OUTPUT>::TiledContrastLimitedAdaptiveHistogramEqualization( int w_, float c_ )
+    : Transform2<INPUT, OUTPUT>(), w(w_), cliplimit(c_)
+    {
+        std::stringstream ss;
+        ss << "TiledContrastLimitedAdaptiveHistogramEqualization" << " " << w << " " << cliplimit;
+        descriptor= ss.str();
+    }
+
+    template<typename INPUT, typename OUTPUT>
+    TiledContrastLimitedAdaptiveHistogramEqualization<INPUT, OUTPUT>::TiledContrastLimitedAdaptiveHistogramEqualization(const TiledContrastLimitedAdaptiveHistogramEqualization& b)
+    : Transform2<INPUT, OUTPUT>(b), w(b.w), cliplimit(b.cliplimit)
+    {
+    }
+
+    template<typename INPUT, typename OUTPUT>
+    TiledContrastLimitedAdaptiveHistogramEqualization<INPUT, OUTPUT>::~TiledContrastLimitedAdaptiveHistogramEqualization()
+    {
+    }
+
+    template<typename INPUT, typename OUTPUT>
+    Border2 TiledContrastLimitedAdaptiveHistogramEqualization<INPUT, OUTPUT>::getProposedBorder()
+    {
+        return Border2(0, 0, 0, 0);
+    }
+
+    template<typename INPUT, typename OUTPUT>
+    void TiledContrastLimitedAdaptiveHistogramEqualization<INPUT, OUTPUT>::apply(Image<INPUT>& input, Image<OUTPUT>& output, Image<unsigned char>* mask, Image<unsigned char>* support)
+    {
+        if ( w == -1 )
+            w= input.columns > input.rows ? input.rows / 8 : input.columns / 8;
+
+        Image<unsigned char> levels;
+        quantizedLevels(input, levels, support);
+        contrastLimitedEqualization(levels, output, w, cliplimit, mask, support);
+    }
+
     /* -----------============== end of contrast limited adaptive histogram equalization ==============------------ */
 
     /* -----------============== morphological contrast enhancement ==============------------ */
@@ -243,6 +243,25 @@ void binaryErode(Image<unsigned char>* input, Image<unsigned char>* output, Stru
 
     int i;
 
+    StructuringElementRuns runs;
+    if ( useFastMorphology(se, runs) )
+    {
+        Vector<unsigned char> object(input->n), result(input->n);
+        for ( unsigned int j= 0; j < input->n; ++j )
+            object(j)= (*input)(j) != BACKGROUND;
+        runs.apply<unsigned char, MinSelector<unsigned char> >(&(object(0)), input->n, start, end, &(result(0)));
+
+        #pragma omp parallel for
+        for ( i= start; i < end; ++i )
+        {
+            if ( mask == NULL )
+                (*output)(i)= ( (*input)(i) != BACKGROUND && result(i) ) ? FOREGROUND : BACKGROUND;
+            else if ( (*mask)(i) > 0 )
+                (*output)(i)= ( (*input)(i) == FOREGROUND && result(i) ) ? FOREGROUND : BACKGROUND;
+        }
+        return;
+    }
+
     if ( mask == NULL )
     {
         #pragma omp parallel for
@@ -312,6 +331,21 @@ void binaryDilate(Image<unsigned char>* input, Image<unsigned char>* output, Str
 
     int i;
 
+    StructuringElementRuns runs;
+    if ( useFastMorphology(se, runs) )
+    {
+        Vector<unsigned char> object(input->n), result(input->n);
+        for ( unsigned int j= 0; j < input->n; ++j )
+            object(j)= (*input)(j) == FOREGROUND;
+        runs.apply<unsigned char, MaxSelector<unsigned char> >(&(object(0)), input->n, start, end, &(result(0)));
+
+        #pragma omp parallel for
+        for ( i= start; i < end; ++i )
+            if ( mask == NULL || (*mask)(i) > 0 )
+                (*output)(i)= ( (*input)(i) != BACKGROUND || result(i) ) ? FOREGROUND : BACKGROUND;
+        return;
+    }
+
     if ( mask == NULL )
     {
         #pragma omp parallel for
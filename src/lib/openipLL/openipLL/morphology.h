@@ -38,6 +38,8 @@
 #include <openipDS/Volume.h>
 
 #include <openipLL/ComponentLabeling.h>
+#include <openipLL/FastMorphology.h>
+#include <openipLL/reconstruction.h>
 
 #include <limits.h>
 using namespace std;
@@ -137,6 +139,26 @@ namespace openip
 
     int i;
 
+    StructuringElementRuns runs;
+    if ( useFastMorphology(se, runs) )
+    {
+        Vector<INPUT> tmp(input->n), result(input->n);
+        if ( mask == NULL )
+            runs.apply<INPUT, MinSelector<INPUT> >(&((*input)(0)), input->n, start, end, &(result(0)));
+        else
+        {
+            for ( unsigned int j= 0; j < input->n; ++j )
+                tmp(j)= (*mask)(j) > 0 ? (*input)(j) : numeric_limits<INPUT>::max();
+            runs.apply<INPUT, MinSelector<INPUT> >(&(tmp(0)), input->n, start, end, &(result(0)));
+        }
+
+        #pragma omp parallel for
+        for ( i= start; i < end; ++i )
+            if ( mask == NULL || (*mask)(i) > 0 )
+                (*output)(i)= result(i);
+        return;
+    }
+
     if ( mask == NULL )
     {
         #pragma omp parallel for
@@ -178,6 +200,28 @@ namespace openip
 
     int i;
 
+    StructuringElementRuns runs;
+    if ( useFastMorphology(se, runs) )
+    {
+        // the lower bounds of the pixelwise evaluations below
+        INPUT lower= mask == NULL ? numeric_limits<INPUT>::min() : INPUT(0);
+        Vector<INPUT> tmp(input->n), result(input->n);
+        if ( mask == NULL )
+            runs.apply<INPUT, MaxSelector<INPUT> >(&((*input)(0)), input->n, start, end, &(result(0)));
+        else
+        {
+            for ( unsigned int j= 0; j < input->n; ++j )
+                tmp(j)= (*mask)(j) > 0 ? (*input)(j) : lower;
+            runs.apply<INPUT, MaxSelector<INPUT> >(&(tmp(0)), input->n, start, end, &(result(0)));
+        }
+
+        #pragma omp parallel for
+        for ( i= start; i < end; ++i )
+            if ( mask == NULL || (*mask)(i) > 0 )
+                (*output)(i)= result(i) > lower ? result(i) : lower;
+        return;
+    }
+
     if ( mask == NULL )
     {
         #pragma omp parallel for
@@ -271,10 +315,8 @@ namespace openip
         tmp= 0;
         flag= 0;
 
-        for ( unsigned int i= input.columns + 1; i < input.n - input.columns - 1; ++i )
-            if ( !roi || (*roi)(i) > 0 )
-                if ( input(i) <= input(i + 1) && input(i) <= input(i - 1) && input(i) <= input(i - input.columns) && input(i) <= input(i + input.columns) )
-                    tmp(i)= 255;
+        // the flooding starts from the regional minima
+        regionalExtrema(input, tmp, roi, 0, 8);
 
         ComponentLabeling cl;
         Image<int> label;
@@ -342,6 +384,9 @@ namespace openip
                         break;
                     }
 
+                    // the pixel is removed before its neighbours are queued, otherwise the pop could remove a neighbour
+                    queues(i).pop();
+
                     for ( it= ses.begin(); it != ses.end(); ++it )
                     {
                         if ( (!roi || (pos + *it >= 0 && pos + *it < int(input.size()) && (*roi)(pos + *it) > 0) ) )
@@ -353,8 +398,6 @@ namespace openip
                     }
 
                     regions(i).push_back(pos);
-                    
-                    queues(i).pop();
                 }
                 for ( unsigned int k= 0; k < regions(i).size(); ++k )
                     tmp(regions(i)(k))= 0;
@@ -423,10 +466,8 @@ namespace openip
         flag= 0;
         label= 0;
 
-        for ( unsigned int i= input.columns + 1; i < input.n - input.columns - 1; ++i )
-            if ( !roi || (*roi)(i) > 0 )
-                if ( input(i) >= input(i + 1) && input(i) >= input(i - 1) && input(i) >= input(i - input.columns) && input(i) >= input(i + input.columns) )
-                    tmp(i)= 255;
+        // the flooding starts from the regional maxima
+        regionalExtrema(input, tmp, roi, 1, 8);
 
         ComponentLabeling cl;
         cl.apply(tmp, label);
@@ -495,6 +536,8 @@ namespace openip
                         break;
                     }
 
+                    queues(i).pop();
+
                     //printf("g"); fflush(stdout);
                     for ( it= ses.begin(); it != ses.end(); ++it )
                     {
@@ -509,7 +552,6 @@ namespace openip
                     //printf("h"); fflush(stdout);
                     regions(i).push_back(pos);
                     //printf("i"); fflush(stdout);
-                    queues(i).pop();
                     //printf("j"); fflush(stdout);
                 }
                 //printf("b"); fflush(stdout);
@@ -1085,36 +1127,13 @@ namespace openip
     void GrayscaleBrightReconstruction<INPUT, OUTPUT>::apply(Image<INPUT>& input, Image<OUTPUT>& output, Image<unsigned char>* roi, Image<unsigned char>* support)
     {
         GrayscaleDilate<INPUT, OUTPUT> gd(radius);
-        GrayscaleErode<OUTPUT, OUTPUT> ge(1);
-        Image<OUTPUT> tmp;
-        Image<OUTPUT> tmp2;
-        Image<OUTPUT> tmp3;
-        tmp.resizeImage(input);
-        tmp2.resizeImage(input);
-        tmp3.resizeImage(input);
-
-        gd.apply(input, tmp, roi, support);
-
-        //writeImage("dilated.png", tmp);
-        int diff;
-
-        do
-        {
-            ge.apply(tmp, tmp2, roi, support);
-            for ( unsigned int i= 0; i < input.n; ++i )
-                if ( !roi || (*roi)(i) )
-                tmp3(i)= input(i) > tmp2(i) ? input(i) : tmp2(i);
-
-            diff= 0;
-            for ( unsigned int i= 0; i < input.n; ++i )
-                if ( tmp3(i) != output(i) )
-                    ++diff;
-            output= tmp3;
-            tmp= tmp3;
-            //printf("%d\n", diff);
-        }while ( diff > 0 );
-
+        output.resizeImage(input);
+        for ( unsigned int i= 0; i < input.n; ++i )
+            output(i)= input(i);
 
+        // the dilated image is reconstructed by erosion above the input, 4-connectivity like the erosion by a disk of radius 1
+        gd.apply(input, output, roi, support);
+        grayscaleReconstructionByErosion(input, output, roi, 4);
     }
 
     template<typename INPUT, typename OUTPUT>
@@ -1167,36 +1186,14 @@ namespace openip
     template<typename INPUT, typename OUTPUT>
     void GrayscaleDarkReconstruction<INPUT, OUTPUT>::apply(Image<INPUT>& input, Image<OUTPUT>& output, Image<unsigned char>* roi, Image<unsigned char>* support)
     {
-
-        GrayscaleDilate<OUTPUT, OUTPUT> gd(1);
         GrayscaleErode<INPUT, OUTPUT> ge(radius);
-        Image<OUTPUT> tmp;
-        Image<OUTPUT> tmp2;
-        Image<OUTPUT> tmp3;
-        tmp.resizeImage(input);
-        tmp2.resizeImage(input);
-        tmp3.resizeImage(input);
-
-        ge.apply(input, tmp, roi, support);
+        output.resizeImage(input);
+        for ( unsigned int i= 0; i < input.n; ++i )
+            output(i)= input(i);
 
-        //writeImage("dilated.png", tmp);
-        int diff;
-
-        do
-        {
-            gd.apply(tmp, tmp2, roi, support);
-            for ( unsigned int i= 0; i < input.n; ++i )
-                if ( !roi || (*roi)(i) > 0 )
-                    tmp3(i)= input(i) < tmp2(i) ? input(i) : tmp2(i);
-
-            diff= 0;
-            for ( unsigned int i= 0; i < input.n; ++i )
-                if ( tmp3(i) != output(i) )
-                    ++diff;
-            output= tmp3;
-            tmp= tmp3;
-            //printf("%d\n", diff);
-        }while ( diff > 0 );
+        // the eroded image is reconstructed by dilation under the input, 4-connectivity like the dilation by a disk of radius 1
+        ge.apply(input, output, roi, support);
+        grayscaleReconstructionByDilation(input, output, roi, 4);
     }
 
     template<typename INPUT, typename OUTPUT>
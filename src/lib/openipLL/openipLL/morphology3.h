@@ -18,6 +18,7 @@
 #include <openipDS/Transform3.h>
 
 #include <openipLL/ComponentLabeling.h>
+#include <openipLL/reconstruction.h>
 
 namespace openip
 {
@@ -363,33 +364,13 @@ namespace openip
     void GrayscaleBrightReconstruction3<INPUT, OUTPUT>::apply(Volume<INPUT>& input, Volume<OUTPUT>& output, Volume<unsigned char>* roi, Volume<unsigned char>* support)
     {
         GrayscaleDilate3<INPUT, OUTPUT> gd(radius);
-        GrayscaleErode3<INPUT, OUTPUT> ge(1);
-        Volume<OUTPUT> tmp;
-        Volume<OUTPUT> tmp2;
-        Volume<OUTPUT> tmp3;
-        tmp.resizeVolume(input);
-        tmp2.resizeVolume(input);
-        tmp3.resizeVolume(input);
-
-        gd.apply(input, tmp, roi, support);
-
-        //writeImage("dilated.png", tmp);
-        int diff;
-
-        do
-        {
-            ge.apply(tmp, tmp2, roi, support);
-            for ( unsigned int i= 0; i < input.n; ++i )
-                tmp3(i)= input(i) > tmp2(i) ? input(i) : tmp2(i);
+        output.resizeVolume(input);
+        for ( unsigned int i= 0; i < input.n; ++i )
+            output(i)= input(i);
 
-            diff= 0;
-            for ( unsigned int i= 0; i < input.n; ++i )
-                if ( tmp3(i) != output(i) )
-                    ++diff;
-            output= tmp3;
-            tmp= tmp3;
-            //printf("%d\n", diff);
-        }while ( diff > 0 );
+        // the dilated volume is reconstructed by erosion above the input, 6-connectivity like the erosion by a sphere of radius 1
+        gd.apply(input, output, roi, support);
+        grayscaleReconstructionByErosion(input, output, roi, 6);
     }
 
     template<typename INPUT, typename OUTPUT>
@@ -442,34 +423,14 @@ namespace openip
     template<typename INPUT, typename OUTPUT>
     void GrayscaleDarkReconstruction3<INPUT, OUTPUT>::apply(Volume<INPUT>& input, Volume<OUTPUT>& output, Volume<unsigned char>* roi, Volume<unsigned char>* support)
     {
-        GrayscaleDilate3<INPUT, OUTPUT> gd(1);
         GrayscaleErode3<INPUT, OUTPUT> ge(radius);
-        Volume<OUTPUT> tmp;
-        Volume<OUTPUT> tmp2;
-        Volume<OUTPUT> tmp3;
-        tmp.resizeVolume(input);
-        tmp2.resizeVolume(input);
-        tmp3.resizeVolume(input);
-
-        ge.apply(input, tmp, roi, support);
+        output.resizeVolume(input);
+        for ( unsigned int i= 0; i < input.n; ++i )
+            output(i)= input(i);
 
-        //writeImage("dilated.png", tmp);
-        int diff;
-
-        do
-        {
-            gd.apply(tmp, tmp2, roi, support);
-            for ( unsigned int i= 0; i < input.n; ++i )
-                tmp3(i)= input(i) < tmp2(i) ? input(i) : tmp2(i);
-
-            diff= 0;
-            for ( unsigned int i= 0; i < input.n; ++i )
-                if ( tmp3(i) != output(i) )
-                    ++diff;
-            output= tmp3;
-            tmp= tmp3;
-            //printf("%d\n", diff);
-        }while ( diff > 0 );
+        // the eroded volume is reconstructed by dilation under the input, 6-connectivity like the dilation by a sphere of radius 1
+        ge.apply(input, output, roi, support);
+        grayscaleReconstructionByDilation(input, output, roi, 6);
     }
     
     template<typename INPUT, typename OUTPUT>
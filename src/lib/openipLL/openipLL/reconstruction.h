@@ -0,0 +1,274 @@
+/**
+ * @file reconstruction.h
+ * @author Gyorgy Kovacs <gyuriofkovacs@gmail.com>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * http://www.gnu.org/copyleft/gpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * Grayscale morphological reconstruction by the hybrid algorithm of
+ * L. Vincent (Morphological grayscale reconstruction in image analysis:
+ * applications and efficient algorithms, IEEE TIP 1993): one raster and one
+ * anti-raster scan propagate the marker along the scanning directions, then
+ * the pixels which can still propagate are processed by a FIFO queue. The
+ * result is identical to iterating the elementary geodesic dilations (erosions)
+ * until stability, but the cost is a few passes over the image. The same
+ * engine processes images (4 or 8 connectivity) and volumes (6 or 26
+ * connectivity).
+ */
+
+#ifndef _RECONSTRUCTION_H_
+#define _RECONSTRUCTION_H_
+
+#include <deque>
+#include <limits>
+
+#include <openipDS/Image.h>
+#include <openipDS/Volume.h>
+#include <openipDS/Vector.h>
+
+namespace openip
+{
+    /**
+     * tests if a is further than b in the direction of the propagation
+     * @param a first value
+     * @param b second value
+     * @param dilation 1 for reconstruction by dilation, 0 for reconstruction by erosion
+     * @return true if a > b for dilation, a < b for erosion
+     */
+    template<typename T>
+    inline bool reconstructionBeyond(T a, T b, int dilation)
+    {
+        return dilation ? a > b : a < b;
+    }
+
+    /**
+     * reconstruction of a marker under (dilation) or above (erosion) a mask, in place, on a 3D grid;
+     * images are grids of one slice
+     * @param mask mask values
+     * @param marker marker values, the result is written here; the pixels outside the roi are not changed
+     * @param roi region of interest, the propagation is restricted to its foreground, NULL if not used
+     * @param slices number of slices
+     * @param rows number of rows
+     * @param columns number of columns
+     * @param dilation 1 for reconstruction by dilation, 0 for reconstruction by erosion
+     * @param full 0 for the face neighbors (4/6 connectivity), 1 for all the neighbors (8/26 connectivity)
+     */
+    template<typename MASK, typename MARKER>
+    void grayscaleReconstruction(const MASK* mask, MARKER* marker, const unsigned char* roi, int slices, int rows, int columns, int dilation, int full)
+    {
+        // neighbor offsets, the first half precedes the pixel in raster order, the second half is the mirror
+        Vector<int> dz, dr, dc, offset;
+        for ( int z= -1; z <= 1; ++z )
+            for ( int r= -1; r <= 1; ++r )
+                for ( int c= -1; c <= 1; ++c )
+                {
+                    int nonzero= (z != 0) + (r != 0) + (c != 0);
+                    if ( nonzero == 0 || (slices == 1 && z != 0) || (!full && nonzero > 1) )
+                        continue;
+                    if ( z < 0 || (z == 0 && r < 0) || (z == 0 && r == 0 && c < 0) )
+                    {
+                        dz.push_back(z);
+                        dr.push_back(r);
+                        dc.push_back(c);
+                    }
+                }
+        int half= dz.size();
+        for ( int k= 0; k < half; ++k )
+        {
+            dz.push_back(-dz(k));
+            dr.push_back(-dr(k));
+            dc.push_back(-dc(k));
+        }
+        for ( unsigned int k= 0; k < dz.size(); ++k )
+            offset.push_back((dz(k)*rows + dr(k))*columns + dc(k));
+
+        int sliceSize= rows*columns;
+
+        // raster scan: propagation from the preceding neighbors
+        for ( int z= 0; z < slices; ++z )
+            for ( int r= 0; r < rows; ++r )
+                for ( int c= 0; c < columns; ++c )
+                {
+                    int p= z*sliceSize + r*columns + c;
+                    if ( roi && !roi[p] )
+                        continue;
+                    MARKER m= marker[p];
+                    for ( int k= 0; k < half; ++k )
+                    {
+                        if ( z + dz(k) < 0 || z + dz(k) >= slices || r + dr(k) < 0 || r + dr(k) >= rows || c + dc(k) < 0 || c + dc(k) >= columns )
+                            continue;
+                        int q= p + offset(k);
+                        if ( (!roi || roi[q]) && reconstructionBeyond(marker[q], m, dilation) )
+                            m= marker[q];
+                    }
+                    marker[p]= reconstructionBeyond(m, MARKER(mask[p]), dilation) ? MARKER(mask[p]) : m;
+                }
+
+        // anti-raster scan: propagation from the following neighbors, the pixels which can still
+        // propagate to a following neighbor are queued
+        std::deque<int> fifo;
+        for ( int z= slices - 1; z >= 0; --z )
+            for ( int r= rows - 1; r >= 0; --r )
+                for ( int c= columns - 1; c >= 0; --c )
+                {
+                    int p= z*sliceSize + r*columns + c;
+                    if ( roi && !roi[p] )
+                        continue;
+                    MARKER m= marker[p];
+                    for ( int k= half; k < 2*half; ++k )
+                    {
+                        if ( z + dz(k) < 0 || z + dz(k) >= slices || r + dr(k) < 0 || r + dr(k) >= rows || c + dc(k) < 0 || c + dc(k) >= columns )
+                            continue;
+                        int q= p + offset(k);
+                        if ( (!roi || roi[q]) && reconstructionBeyond(marker[q], m, dilation) )
+                            m= marker[q];
+                    }
+                    marker[p]= reconstructionBeyond(m, MARKER(mask[p]), dilation) ? MARKER(mask[p]) : m;
+
+                    for ( int k= half; k < 2*half; ++k )
+                    {
+                        if ( z + dz(k) < 0 || z + dz(k) >= slices || r + dr(k) < 0 || r + dr(k) >= rows || c + dc(k) < 0 || c + dc(k) >= columns )
+                            continue;
+                        int q= p + offset(k);
+                        if ( (!roi || roi[q]) && reconstructionBeyond(marker[p], marker[q], dilation) && reconstructionBeyond(MARKER(mask[q]), marker[q], dilation) )
+                        {
+                            fifo.push_back(p);
+                            break;
+                        }
+                    }
+                }
+
+        // FIFO propagation
+        while ( !fifo.empty() )
+        {
+            int p= fifo.front();
+            fifo.pop_front();
+
+            int z= p / sliceSize;
+            int r= (p % sliceSize) / columns;
+            int c= p % columns;
+            for ( unsigned int k= 0; k < offset.size(); ++k )
+            {
+                if ( z + dz(k) < 0 || z + dz(k) >= slices || r + dr(k) < 0 || r + dr(k) >= rows || c + dc(k) < 0 || c + dc(k) >= columns )
+                    continue;
+                int q= p + offset(k);
+                if ( (roi && !roi[q]) || !reconstructionBeyond(marker[p], marker[q], dilation) || MARKER(mask[q]) == marker[q] )
+                    continue;
+                marker[q]= reconstructionBeyond(marker[p], MARKER(mask[q]), dilation) ? MARKER(mask[q]) : marker[p];
+                fifo.push_back(q);
+            }
+        }
+    }
+
+    /**
+     * reconstruction by dilation of a marker under a mask
+     * @param mask mask image
+     * @param marker marker image, the result is written here
+     * @param roi region of interest, NULL if not used
+     * @param connectivity 4 or 8
+     */
+    template<typename MASK, typename MARKER>
+    void grayscaleReconstructionByDilation(Image<MASK>& mask, Image<MARKER>& marker, Image<unsigned char>* roi= NULL, int connectivity= 4)
+    {
+        grayscaleReconstruction(&(mask(0)), &(marker(0)), roi ? &((*roi)(0)) : (unsigned char*)NULL, 1, mask.rows, mask.columns, 1, connectivity == 8);
+    }
+
+    /**
+     * reconstruction by erosion of a marker above a mask
+     * @param mask mask image
+     * @param marker marker image, the result is written here
+     * @param roi region of interest, NULL if not used
+     * @param connectivity 4 or 8
+     */
+    template<typename MASK, typename MARKER>
+    void grayscaleReconstructionByErosion(Image<MASK>& mask, Image<MARKER>& marker, Image<unsigned char>* roi= NULL, int connectivity= 4)
+    {
+        grayscaleReconstruction(&(mask(0)), &(marker(0)), roi ? &((*roi)(0)) : (unsigned char*)NULL, 1, mask.rows, mask.columns, 0, connectivity == 8);
+    }
+
+    /**
+     * reconstruction by dilation of a marker under a mask
+     * @param mask mask volume
+     * @param marker marker volume, the result is written here
+     * @param roi region of interest, NULL if not used
+     * @param connectivity 6 or 26
+     */
+    template<typename MASK, typename MARKER>
+    void grayscaleReconstructionByDilation(Volume<MASK>& mask, Volume<MARKER>& marker, Volume<unsigned char>* roi= NULL, int connectivity= 6)
+    {
+        grayscaleReconstruction(&(mask(0)), &(marker(0)), roi ? &((*roi)(0)) : (unsigned char*)NULL, mask.slices, mask.rows, mask.columns, 1, connectivity == 26);
+    }
+
+    /**
+     * reconstruction by erosion of a marker above a mask
+     * @param mask mask volume
+     * @param marker marker volume, the result is written here
+     * @param roi region of interest, NULL if not used
+     * @param connectivity 6 or 26
+     */
+    template<typename MASK, typename MARKER>
+    void grayscaleReconstructionByErosion(Volume<MASK>& mask, Volume<MARKER>& marker, Volume<unsigned char>* roi= NULL, int connectivity= 6)
+    {
+        grayscaleReconstruction(&(mask(0)), &(marker(0)), roi ? &((*roi)(0)) : (unsigned char*)NULL, mask.slices, mask.rows, mask.columns, 0, connectivity == 26);
+    }
+
+    /**
+     * regional maxima (dilation) or minima (erosion) of an image: the plateaus without a strictly higher (lower)
+     * neighbor; the pixels not neighboring a higher (lower) pixel are reset to the extreme value, the rest is
+     * reconstructed from the pixels neighboring a higher (lower) pixel, the pixels not reached are the extrema
+     * @param input input image
+     * @param extrema output image, 255 in the regional extrema, 0 otherwise
+     * @param roi region of interest, NULL if not used
+     * @param dilation 1 for maxima, 0 for minima
+     * @param connectivity 4 or 8
+     */
+    template<typename INPUT>
+    void regionalExtrema(Image<INPUT>& input, Image<unsigned char>& extrema, Image<unsigned char>* roi, int dilation, int connectivity= 8)
+    {
+        Image<INPUT> marker;
+        marker.resizeImage(input);
+        extrema.resizeImage(input);
+
+        INPUT extreme= dilation ? (std::numeric_limits<INPUT>::is_integer ? std::numeric_limits<INPUT>::min() : -std::numeric_limits<INPUT>::max()) : std::numeric_limits<INPUT>::max();
+        int full= connectivity == 8;
+        int rows= input.rows;
+        int columns= input.columns;
+        for ( int r= 0; r < rows; ++r )
+            for ( int c= 0; c < columns; ++c )
+            {
+                int p= r*columns + c;
+                marker(p)= extreme;
+                if ( roi && !(*roi)(p) )
+                    continue;
+                for ( int i= -1; i <= 1; ++i )
+                    for ( int j= -1; j <= 1; ++j )
+                    {
+                        if ( (i == 0 && j == 0) || (!full && i != 0 && j != 0) || r + i < 0 || r + i >= rows || c + j < 0 || c + j >= columns )
+                            continue;
+                        int q= p + i*columns + j;
+                        if ( (!roi || (*roi)(q)) && reconstructionBeyond(input(q), input(p), dilation) )
+                            marker(p)= input(p);
+                    }
+            }
+
+        grayscaleReconstruction(&(input(0)), &(marker(0)), roi ? &((*roi)(0)) : (unsigned char*)NULL, 1, rows, columns, dilation, full);
+
+        for ( unsigned int i= 0; i < input.n; ++i )
+            extrema(i)= (!roi || (*roi)(i)) && marker(i) != input(i) ? 255 : 0;
+    }
+}
+
+#endif